@@ -67,8 +67,11 @@ void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::constructQuadraticForm()
 
   if (fromNotFixed || toNotFixed) {
 #ifdef G2O_OPENMP
-    from->lockQuadraticForm();
-    to->lockQuadraticForm();
+    // lock in vertex id order, two edges may join the same vertices in opposite orientations
+    OptimizableGraph::Vertex* firstLocked = from->id() < to->id() ? static_cast<OptimizableGraph::Vertex*>(from) : to;
+    OptimizableGraph::Vertex* secondLocked = from->id() < to->id() ? static_cast<OptimizableGraph::Vertex*>(to) : from;
+    firstLocked->lockQuadraticForm();
+    secondLocked->lockQuadraticForm();
 #endif
     const InformationType& omega = _information;
     Matrix<double, D, 1> omega_r = - omega * _error;
@@ -113,8 +116,8 @@ void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::constructQuadraticForm()
       }
     }
 #ifdef G2O_OPENMP
-    to->unlockQuadraticForm();
-    from->unlockQuadraticForm();
+    secondLocked->unlockQuadraticForm();
+    firstLocked->unlockQuadraticForm();
 #endif
   }
 }
@@ -140,8 +143,11 @@ void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::linearizeOplus()
     return;
 
 #ifdef G2O_OPENMP
-  vi->lockQuadraticForm();
-  vj->lockQuadraticForm();
+  // lock in vertex id order, as constructQuadraticForm()
+  OptimizableGraph::Vertex* firstLocked = vi->id() < vj->id() ? static_cast<OptimizableGraph::Vertex*>(vi) : vj;
+  OptimizableGraph::Vertex* secondLocked = vi->id() < vj->id() ? static_cast<OptimizableGraph::Vertex*>(vj) : vi;
+  firstLocked->lockQuadraticForm();
+  secondLocked->lockQuadraticForm();
 #endif
 
   const double delta = 1e-9;
@@ -199,8 +205,8 @@ void BaseBinaryEdge<D, E, VertexXiType, VertexXjType>::linearizeOplus()
 
   _error = errorBeforeNumeric;
 #ifdef G2O_OPENMP
-  vj->unlockQuadraticForm();
-  vi->unlockQuadraticForm();
+  secondLocked->unlockQuadraticForm();
+  firstLocked->unlockQuadraticForm();
 #endif
 }
 
@@ -37,6 +37,15 @@
 
 namespace g2o {
 
+  /**
+   * number of threads of g2o's parallel loops (errors, Jacobians and Hessian
+   * blocks of the active edges, Schur complement, ...). Process wide, shared by
+   * all optimizers, 1 (default) evaluates serially. Has no effect without
+   * G2O_OPENMP. Set it once before the optimizers are used.
+   */
+  void setNumThreads(int numThreads);
+  int numThreads();
+
 #ifdef G2O_OPENMP
 
   /**
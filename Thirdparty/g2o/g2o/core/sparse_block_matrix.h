@@ -39,6 +39,7 @@
 #include "matrix_structure.h"
 #include "matrix_operations.h"
 #include "../../config.h"
+#include "openmp_mutex.h"
 
 namespace g2o {
   using namespace Eigen;
@@ -67,7 +67,7 @@ namespace g2o {
   template <class MatrixType>
   void SparseBlockMatrix<MatrixType>::clear(bool dealloc) {
 #   ifdef G2O_OPENMP
-#   pragma omp parallel for default (shared) if (_blockCols.size() > 100)
+#   pragma omp parallel for default (shared) num_threads(numThreads()) if (numThreads() > 1 && _blockCols.size() > 100)
 #   endif
     for (int i=0; i < static_cast<int>(_blockCols.size()); ++i) {
       for (typename SparseBlockMatrix<MatrixType>::IntBlockMap::const_iterator it=_blockCols[i].begin(); it!=_blockCols[i].end(); ++it){
@@ -295,7 +295,7 @@ namespace g2o {
     Eigen::Map<const VectorXd> srcVec(src, rows());
 
 #   ifdef G2O_OPENMP
-#   pragma omp parallel for default (shared) schedule(dynamic, 10)
+#   pragma omp parallel for default (shared) num_threads(numThreads()) if (numThreads() > 1) schedule(dynamic, 10)
 #   endif
     for (int i=0; i < static_cast<int>(_blockCols.size()); ++i){
       int destOffset = colBaseOfBlock(i);
@@ -32,6 +32,7 @@
 #include <Eigen/StdVector>
 
 #include "../../config.h"
+#include "openmp_mutex.h"
 #include "matrix_operations.h"
 
 namespace g2o {
@@ -87,7 +88,7 @@ namespace g2o {
         Eigen::Map<const Eigen::VectorXd> srcVec(src, rows());
 
 #      ifdef G2O_OPENMP
-#      pragma omp parallel for default (shared) schedule(dynamic, 10)
+#      pragma omp parallel for default (shared) num_threads(numThreads()) if (numThreads() > 1) schedule(dynamic, 10)
 #      endif
         for (int i=0; i < static_cast<int>(_diagonal.size()); ++i){
           int destOffset = baseOfBlock(i);
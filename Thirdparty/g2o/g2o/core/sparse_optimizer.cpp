@@ -68,7 +68,7 @@ namespace g2o{
     }
 
 #   ifdef G2O_OPENMP
-#   pragma omp parallel for default (shared) if (_activeEdges.size() > 50)
+#   pragma omp parallel for default (shared) num_threads(numThreads()) if (numThreads() > 1 && _activeEdges.size() > 50)
 #   endif
     for (int k = 0; k < static_cast<int>(_activeEdges.size()); ++k) {
       OptimizableGraph::Edge* e = _activeEdges[k];
@@ -26,5 +26,9 @@ mkdir build
 cd build
 cmake .. -DCMAKE_BUILD_TYPE=Release
 make -j4
+cd ..
+
+echo "Converting vocabulary to binary file ..."
+./tools/bin_vocabulary Vocabulary/ORBvoc.txt Vocabulary/ORBvoc.bin
 
 #./Examples/RGB-D/rgbd_tum Vocabulary/ORBvoc.txt Examples/RGB-D/TUM3.yaml /mnt/data/rgbd_dataset_freiburg3_walking_xyz /mnt/DynaSLAM/Examples/RGB-D/associations/fr3_walking_xyz.txt /mnt/masks /mnt/output
\ No newline at end of file
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#ifndef _COVISIBILITY_LIST_H_
+#define _COVISIBILITY_LIST_H_
+
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+namespace ORB_SLAM2 {
+
+class KeyFrame;
+
+// 关键帧在共视图中的邻接表 (KeyFrame::mMutexConnections 保护, 本身不加锁)。
+// 邻居和权重存放在按指针排序的紧凑数组中, 修改一条边是 O(log n) 查找加一次插入/删除,
+// 只把排序结果标记为失效; 按权重从大到小的邻居列表在下次读取时才重新排序 (延迟物化),
+// 这样 UpdateConnections 修改大量邻居时每个邻居最多排序一次, 且只在真正被读取时。
+class CovisibilityList {
+public:
+    typedef std::pair<KeyFrame*, int> Edge;
+
+    CovisibilityList();
+
+    // Sets the weight of the edge to pKF, false if it already had this weight
+    bool Set(KeyFrame* pKF, int weight);
+
+    // False if there was no edge to pKF
+    bool Erase(KeyFrame* pKF);
+
+    // Replaces all edges (vEdges sorted by KeyFrame pointer). Only the edges with
+    // weight >= nMinOrderedWeight are ordered, or the heaviest one if there is none,
+    // until the next Set/Erase (see KeyFrame::UpdateConnections).
+    void Assign(std::vector<Edge>& vEdges, int nMinOrderedWeight);
+
+    void Clear();
+
+    // 0 if not connected
+    int Weight(KeyFrame* pKF) const;
+
+    // All edges, sorted by KeyFrame pointer
+    const std::vector<Edge>& Edges() const { return mvEdges; }
+
+    // Neighbours by decreasing weight, and their weights
+    const std::vector<KeyFrame*>& Ordered();
+    const std::vector<int>& OrderedWeights();
+
+private:
+    std::vector<Edge>::iterator Find(KeyFrame* pKF);
+    std::vector<Edge>::const_iterator Find(KeyFrame* pKF) const;
+    void Materialize();
+
+    std::vector<Edge> mvEdges;
+    int mnMinOrderedWeight;
+
+    // cache of Ordered()/OrderedWeights(), rebuilt when mbDirty
+    bool mbDirty;
+    std::vector<KeyFrame*> mvpOrdered;
+    std::vector<int> mvOrderedWeights;
+    std::vector<std::pair<int, KeyFrame*> > mvPairs;
+};
+
+}  // namespace ORB_SLAM2
+
+#endif  // _COVISIBILITY_LIST_H_
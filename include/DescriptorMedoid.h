@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#ifndef _DESCRIPTOR_MEDOID_H_
+#define _DESCRIPTOR_MEDOID_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <random>
+#include <vector>
+
+namespace ORB_SLAM2 {
+
+class KeyFrame;
+
+// 地图点代表描述子的增量维护 (MapPoint::AddObservation / EraseObservation 调用)。
+// 用蓄水池抽样 (reservoir sampling) 从全部观测中均匀保留最多 MAX_SAMPLES 个描述子,
+// 并维护每个描述子到其余描述子的汉明距离之和 (距离矩阵的行和)。
+// 每个观测的加入或删除只需 O(MAX_SAMPLES) 次距离计算, 与观测总数无关;
+// 代表描述子为距离和最小者 (medoid)。不加锁, 由调用者保证互斥。
+class DescriptorMedoid {
+public:
+    static const int DESC_BYTES = 32;
+    static const size_t MAX_SAMPLES = 32;
+
+    DescriptorMedoid();
+
+    size_t Size() const { return mvSamples.size(); }
+
+    KeyFrame* GetKeyFrame(size_t i) const { return mvSamples[i].pKF; }
+    size_t GetIndex(size_t i) const { return mvSamples[i].idx; }
+    const uint8_t* GetDescriptor(size_t i) const { return mvSamples[i].desc; }
+    int GetDistanceSum(size_t i) const { return mvSamples[i].nDistanceSum; }
+
+    // A new observation (pKF,idx). It is kept while there is room, afterwards it replaces a
+    // random sample with probability MAX_SAMPLES / observations
+    void Offer(KeyFrame* pKF, size_t idx, const uint8_t* pDescriptor);
+
+    // The observation (pKF,idx) was erased, its sample is dropped if it has one
+    void Erase(KeyFrame* pKF, size_t idx);
+
+    void Clear();
+
+    // Sample with the least distance sum, -1 if empty
+    int Best() const;
+
+private:
+    struct Sample {
+        KeyFrame* pKF;
+        size_t idx;
+        int nDistanceSum;
+        uint8_t desc[DESC_BYTES];
+    };
+
+    void Add(const Sample& sample);
+    void Replace(size_t i, const Sample& sample);
+    void Remove(size_t i);
+
+    std::vector<Sample> mvSamples;
+
+    // Observations currently represented by the reservoir, sampled or not
+    size_t mnObservations;
+
+    // Fixed seed, the sample only depends on the order of the observations
+    std::minstd_rand mRng;
+};
+
+}  // namespace ORB_SLAM2
+
+#endif  // _DESCRIPTOR_MEDOID_H_
@@ -18,6 +18,8 @@
 #include "ORBVocabulary.h"
 #include "KeyFrame.h"
 #include "ORBextractor.h"
+#include "StereoMatcher.h"
+#include "UndistortionMap.h"
 
 #include <opencv2/opencv.hpp>
 #include "SlamConfig.h"
@@ -73,6 +75,12 @@ public:
     // and fill variables of the MapPoint to be used by the tracking
     bool isInFrustum(MapPoint* pMP, float viewingCosLimit);
 
+    // Batched isInFrustum over vpMPs, reading the MapPointStore instead of every MapPoint.
+    // Sets mbTrackInView of every point and the other tracking variables of the points in view.
+    // vBuffer is scratch space kept by the caller, a Frame does not live long enough to reuse it.
+    // Returns the number of points in view.
+    int isInFrustum(const std::vector<MapPoint*> &vpMPs, float viewingCosLimit, std::vector<float> &vBuffer);
+
     // Compute the cell of a keypoint (return false if outside the grid)
     bool PosInGrid(const cv::KeyPoint &kp, int &posX, int &posY);
 
@@ -195,6 +203,9 @@ public:
 
     static bool mbInitialComputations;
 
+    // Distorted -> undistorted lookup table, built with the image bounds
+    static UndistortionMap mUndistortionMap;
+
 
 private:
 
@@ -203,6 +214,10 @@ private:
     // (called in the constructor).
     void UndistortKeyPoints();
 
+    // Stereo matching of the left keypoints [iBegin,iEnd), one worker of ComputeStereoMatches.
+    void ComputeStereoMatchesRange(const int iBegin, const int iEnd, const StereoRowIndex &rowIndex,
+                                   std::vector<std::pair<int, int> > &vDistIdx);
+
     // Computes image bounds for the undistorted image (called in the constructor).
     void ComputeImageBounds(const cv::Mat &imLeft);
 
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#ifndef _HAMMING_MATCHER_H_
+#define _HAMMING_MATCHER_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace ORB_SLAM2 {
+
+// ORB描述子为256 bit (32 bytes)，每一行正好是一个256-bit块，因此可以直接在 mDescriptors 上
+// 做向量化的汉明距离计算，不需要为每个候选点构造 cv::Mat 行头。
+// OpenCV 2.4 的 fastMalloc 只保证16字节对齐，ROI 的行没有任何对齐保证，所以行一律按非对齐读取
+// (loadu / memcpy)。
+class HammingMatcher {
+public:
+    static const int DESC_BYTES = 32;
+
+    // best / second best of a one-vs-many search
+    struct Result {
+        int bestDist;
+        int bestIdx;
+        int bestDist2;
+        int secondIdx;  // index holding bestDist2, -1 if none
+    };
+
+    // Hamming distance between two 256-bit descriptors
+    static inline int Distance(const uint8_t* a, const uint8_t* b)
+    {
+#if defined(__POPCNT__)
+        uint64_t pa[4], pb[4];
+        memcpy(pa, a, DESC_BYTES);
+        memcpy(pb, b, DESC_BYTES);
+        return __builtin_popcountll(pa[0] ^ pb[0]) + __builtin_popcountll(pa[1] ^ pb[1]) +
+               __builtin_popcountll(pa[2] ^ pb[2]) + __builtin_popcountll(pa[3] ^ pb[3]);
+#else
+        // http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
+        uint32_t pa[8], pb[8];
+        memcpy(pa, a, DESC_BYTES);
+        memcpy(pb, b, DESC_BYTES);
+        int dist = 0;
+        for (int i = 0; i < 8; i++) {
+            uint32_t v = pa[i] ^ pb[i];
+            v = v - ((v >> 1) & 0x55555555);
+            v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+            dist += (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
+        }
+        return dist;
+#endif
+    }
+
+    static inline int Distance(const cv::Mat& a, const cv::Mat& b)
+    {
+        return Distance(a.ptr<uint8_t>(), b.ptr<uint8_t>());
+    }
+
+    // One-vs-many: dists[k] = Distance(query, descs.row(indices[k]))
+    // 使用AVX2 (vpshufb查表popcount) 一次处理一个256-bit行，否则退化为硬件POPCNT
+    static void Distances(const uint8_t* query, const cv::Mat& descs,
+                          const size_t* indices, size_t n, int* dists);
+
+    // One-vs-all rows of descs
+    static void Distances(const uint8_t* query, const cv::Mat& descs, int* dists);
+
+    // 一次遍历同时得到最小和次小距离。filter(idx) 返回 false 的候选点被跳过，
+    // 通过的候选点按 BATCH 个一组交给 Distances 批量计算，再按原顺序归约出最小和次小距离。
+    // 初始距离与原来各个匹配函数中的 bestDist 初值一致 (默认256)。
+    template <typename IndexContainer, typename Filter>
+    static Result SearchBest(const cv::Mat& query, const cv::Mat& descs,
+                             const IndexContainer& vIndices, Filter filter, int initDist = 256)
+    {
+        Result res = {initDist, -1, initDist, -1};
+        const uint8_t* q = query.ptr<uint8_t>();
+
+        size_t vBatch[BATCH];
+        int vDists[BATCH];
+        size_t n = 0;
+        for (typename IndexContainer::const_iterator vit = vIndices.begin(), vend = vIndices.end(); vit != vend; vit++) {
+            const size_t idx = *vit;
+            if (!filter(idx))
+                continue;
+
+            vBatch[n++] = idx;
+            if (n == BATCH) {
+                Distances(q, descs, vBatch, n, vDists);
+                Reduce(vBatch, vDists, n, res);
+                n = 0;
+            }
+        }
+        if (n > 0) {
+            Distances(q, descs, vBatch, n, vDists);
+            Reduce(vBatch, vDists, n, res);
+        }
+        return res;
+    }
+
+    template <typename IndexContainer>
+    static Result SearchBest(const cv::Mat& query, const cv::Mat& descs, const IndexContainer& vIndices)
+    {
+        return SearchBest(query, descs, vIndices, AcceptAll());
+    }
+
+private:
+    static const size_t BATCH = 64;
+
+    static inline void Reduce(const size_t* indices, const int* dists, size_t n, Result& res)
+    {
+        for (size_t k = 0; k < n; k++) {
+            const int dist = dists[k];
+            if (dist < res.bestDist) {
+                res.bestDist2 = res.bestDist;
+                res.secondIdx = res.bestIdx;
+                res.bestDist = dist;
+                res.bestIdx = indices[k];
+            } else if (dist < res.bestDist2) {
+                res.bestDist2 = dist;
+                res.secondIdx = indices[k];
+            }
+        }
+    }
+
+    struct AcceptAll {
+        bool operator()(size_t) const { return true; }
+    };
+};
+
+}  // namespace ORB_SLAM2
+
+#endif  // _HAMMING_MATCHER_H_
@@ -22,6 +22,7 @@
 
 #include<opencv2/opencv.hpp>
 #include "Frame.h"
+#include "Triangulation.h"
 
 
 namespace ORB_SLAM2
@@ -51,17 +52,15 @@ private:
     cv::Mat ComputeH21(const vector<cv::Point2f> &vP1, const vector<cv::Point2f> &vP2);
     cv::Mat ComputeF21(const vector<cv::Point2f> &vP1, const vector<cv::Point2f> &vP2);
 
-    float CheckHomography(const cv::Mat &H21, const cv::Mat &H12, vector<bool> &vbMatchesInliers, float sigma);
-
-    float CheckFundamental(const cv::Mat &F21, vector<bool> &vbMatchesInliers, float sigma);
-
     bool ReconstructF(vector<bool> &vbMatchesInliers, cv::Mat &F21, cv::Mat &K,
                       cv::Mat &R21, cv::Mat &t21, vector<cv::Point3f> &vP3D, vector<bool> &vbTriangulated, float minParallax, int minTriangulated);
 
     bool ReconstructH(vector<bool> &vbMatchesInliers, cv::Mat &H21, cv::Mat &K,
                       cv::Mat &R21, cv::Mat &t21, vector<cv::Point3f> &vP3D, vector<bool> &vbTriangulated, float minParallax, int minTriangulated);
 
-    void Triangulate(const cv::KeyPoint &kp1, const cv::KeyPoint &kp2, const cv::Mat &P1, const cv::Mat &P2, cv::Mat &x3D);
+    // x3D is not finite for a point at infinity
+    void Triangulate(const cv::KeyPoint &kp1, const cv::KeyPoint &kp2, const Triangulation::Matrix34f &P1,
+                     const Triangulation::Matrix34f &P2, Eigen::Vector3f &x3D);
 
     void Normalize(const vector<cv::KeyPoint> &vKeys, vector<cv::Point2f> &vNormalizedPoints, cv::Mat &T);
 
@@ -82,6 +81,9 @@ private:
     vector<Match> mvMatches12;
     vector<bool> mvbMatched1;
 
+    // Matched keypoints (SoA), 1: reference frame, 2: current frame
+    vector<float> mvU1, mvV1, mvU2, mvV2;
+
     // Calibration
     cv::Mat mK;
 
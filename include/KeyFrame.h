@@ -17,6 +17,11 @@
 #include "ORBextractor.h"
 #include "Frame.h"
 #include "KeyFrameDatabase.h"
+#include "ObjectPool.h"
+#include "SeqLock.h"
+#include "CovisibilityList.h"
+
+#include <Eigen/Core>
 
 #include <mutex>
 
@@ -34,6 +39,8 @@ class KeyFrame
 public:
     KeyFrame(Frame &F, Map* pMap, KeyFrameDatabase* pKFDB);
 
+    POOL_ALLOCATED_OBJECT(KeyFrame)
+
     // Pose functions
     void SetPose(const cv::Mat &Tcw);
     cv::Mat GetPose();
@@ -43,6 +50,14 @@ public:
     cv::Mat GetRotation();
     cv::Mat GetTranslation();
 
+    // Non-allocating versions. All pose getters are lock-free, they read a
+    // seqlocked copy of the pose written by SetPose().
+    Eigen::Matrix4f GetPoseEigen();
+    Eigen::Matrix4f GetPoseInverseEigen();
+    Eigen::Vector3f GetCameraCenterEigen();
+    Eigen::Matrix3f GetRotationEigen();
+    Eigen::Vector3f GetTranslationEigen();
+
     // Bag of Words Representation
     void ComputeBoW();
 
@@ -54,6 +69,8 @@ public:
     std::set<KeyFrame *> GetConnectedKeyFrames();
     std::vector<KeyFrame* > GetVectorCovisibleKeyFrames();
     std::vector<KeyFrame*> GetBestCovisibilityKeyFrames(const int &N);
+    // Same, into a caller-owned buffer
+    void GetBestCovisibilityKeyFrames(const int &N, std::vector<KeyFrame*> &vpBest);
     std::vector<KeyFrame*> GetCovisiblesByWeight(const int &w);
     int GetWeight(KeyFrame* pKF);
 
@@ -82,6 +99,8 @@ public:
     // KeyPoint functions
     std::vector<size_t> GetFeaturesInArea(const float &x, const float  &y, const float  &r) const;
     cv::Mat UnprojectStereo(int i);
+    // Lock-free and non-allocating, false if there is no depth
+    bool UnprojectStereo(int i, Eigen::Vector3f &x3D);
 
     // Image
     bool IsInImage(const float &x, const float &y) const;
@@ -142,6 +161,8 @@ public:
 
     static long unsigned int nNextId;
     long unsigned int mnId;
+    // ObjectPool slot, dense and reused after the keyframe is deleted (see Map)
+    size_t mnHandle;
     const long unsigned int mnFrameId;
 
     const double mTimeStamp;
@@ -165,14 +186,6 @@ public:
     long unsigned int mnBASemanticFixedForKF;
     long unsigned int mnSemanticTrackReferenceForFrame;
 
-    // Variables used by the keyframe database
-    long unsigned int mnLoopQuery;
-    int mnLoopWords;
-    float mLoopScore;
-    long unsigned int mnRelocQuery;
-    int mnRelocWords;
-    float mRelocScore;
-
     // Variables used by loop closing
     cv::Mat mTcwGBA;
     cv::Mat mTcwBefGBA;
@@ -234,6 +247,13 @@ protected:
 
     cv::Mat Cw; // Stereo middel point. Only for visualization
 
+    // Copy of the pose for the lock-free getters: Tcw rows 0-2 (row-major), Ow, Cw.
+    // Written under mMutexPose, so writers are serialized.
+    enum { POSE_TCW = 0, POSE_OW = 12, POSE_CW = 15, POSE_SIZE = 18 };
+    void LoadPose(float* pPose);
+    std::atomic<float> mPoseData[POSE_SIZE];
+    SeqLock mSeqPose;
+
     // MapPoints associated to keypoints
     //std::vector<MapPoint*> mvpMapPoints;
 
@@ -244,9 +264,7 @@ protected:
     // Grid over the image to speed up feature matching
     std::vector< std::vector <std::vector<size_t> > > mGrid;
 
-    std::map<KeyFrame*,int> mConnectedKeyFrameWeights;
-    std::vector<KeyFrame*> mvpOrderedConnectedKeyFrames;
-    std::vector<int> mvOrderedWeights;
+    CovisibilityList mConnections;
 
     // Spanning Tree and Loop Edges
     bool mbFirstConnection;
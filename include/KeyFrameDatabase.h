@@ -28,8 +28,10 @@
 #include "KeyFrame.h"
 #include "Frame.h"
 #include "ORBVocabulary.h"
+#include "Thirdparty/DBoW2/DBoW2/BowVector.h"
 
 #include<mutex>
+#include <boost/thread/shared_mutex.hpp>
 
 
 namespace ORB_SLAM2
@@ -59,14 +61,64 @@ public:
 
 protected:
 
+  // Keyframes containing a word, with the weight of the word in each of them.
+  // Erased keyframes stay as tombstones (mvpKeyFrames[id]==NULL) until
+  // more than half of the list is dead, then the list is compacted.
+  struct PostingList
+  {
+      std::vector<unsigned int> mvKFIds;
+      std::vector<DBoW2::WordValue> mvWeights;
+      unsigned int mnDead;
+
+      PostingList(): mnDead(0) {}
+  };
+
+  // Per-query scoring state, indexed by keyframe id. An entry is only valid
+  // if its stamp equals the current query stamp. Each querying thread owns
+  // one context, so relocalization and loop queries can run in parallel.
+  struct QueryContext
+  {
+      unsigned int mnStamp;
+      std::vector<unsigned int> mvnStamp;
+      std::vector<int> mvnCommonWords;
+      std::vector<double> mvL1Acc;
+      std::vector<float> mvScore;
+      // keyframes sharing at least one word with the query
+      std::vector<unsigned int> mvTouched;
+
+      QueryContext(): mnStamp(0) {}
+
+      inline bool IsTouched(const unsigned int id) const
+      {
+          return id<mvnStamp.size() && mvnStamp[id]==mnStamp;
+      }
+  };
+
+  // Context of the calling thread, ready for a new query
+  QueryContext& BeginQuery();
+
+  // Walks the posting lists of the words in bowVec and fills the context
+  void SearchSharingWords(const DBoW2::BowVector &bowVec, QueryContext &ctx) const;
+
+  // Similarity of the query to keyframe id (after SearchSharingWords)
+  float Score(const DBoW2::BowVector &bowVec, const unsigned int id, const QueryContext &ctx) const;
+
+  void CompactPostingList(PostingList &posting);
+
   // Associated vocabulary
   const ORBVocabulary* mpVoc;
 
+  // L1 scores are accumulated while walking the posting lists
+  bool mbAccumulateL1;
+
   // Inverted file
-  std::vector<list<KeyFrame*> > mvInvertedFile;
+  std::vector<PostingList> mvInvertedFile;
+
+  // Keyframes by mnId, NULL once erased
+  std::vector<KeyFrame*> mvpKeyFrames;
 
-  // Mutex
-  std::mutex mMutex;
+  // Queries take it shared, add/erase/clear exclusive
+  boost::shared_mutex mMutex;
 };
 
 } //namespace ORB_SLAM
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#ifndef _LOCAL_BA_WINDOW_H_
+#define _LOCAL_BA_WINDOW_H_
+
+#include <map>
+
+#include "Thirdparty/g2o/g2o/core/sparse_optimizer.h"
+#include "Thirdparty/g2o/g2o/types/types_six_dof_expmap.h"
+
+namespace ORB_SLAM2 {
+
+class KeyFrame;
+class MapPoint;
+
+// 局部BA的持久化g2o图 (滑动窗口)。
+// 相邻关键帧的局部窗口大部分重叠, Optimizer::LocalBundleAdjustment 每次只增删发生变化的
+// 顶点和边, 其余的顶点和边 (包括它们的雅可比存储和核函数) 留给下一次使用,
+// 初值就是地图中保存的上一次优化结果。g2o的求解器也随窗口保留。只在LocalMapping线程中使用。
+class LocalBAWindow {
+public:
+    LocalBAWindow();
+    ~LocalBAWindow();
+
+    // Drops the whole graph, e.g. on a map reset. Does not touch keyframes or map points.
+    void Clear();
+
+    bool Empty() const { return mmKeyFrames.empty() && mmPoints.empty(); }
+
+private:
+    friend class Optimizer;
+
+    struct Observation {
+        g2o::OptimizableGraph::Edge* pEdge;
+        size_t idx;  // keypoint index in the keyframe
+        bool bStereo;
+    };
+
+    struct Point {
+        g2o::VertexSBAPointXYZ* pVertex;
+        std::map<KeyFrame*, Observation> mObservations;
+    };
+
+    g2o::SparseOptimizer mOptimizer;
+
+    // Levenberg solvers for small (dense Cholesky) and large (sparse) windows, created on
+    // first use. The window owns both and mOptimizer only uses the current one, so the block
+    // solver buffers and the sparse solver's cached pattern survive between keyframes.
+    g2o::OptimizationAlgorithm* mpDenseSolver;
+    g2o::OptimizationAlgorithm* mpSparseSolver;
+
+    // Keyed by raw pointers that are dereferenced on the next call (mnBALocalForKF, ...),
+    // including entries of keyframes and points that became bad meanwhile. This is only
+    // safe because KeyFrames and MapPoints of the map are never freed while the map lives:
+    // bad ones stay allocated, and Map::clear() frees them only after the reset cleared this
+    // window (checked in LocalMapping::RequestReset). The only other deletes are Tracking's
+    // temporal VO points and unprocessed keyframes in LocalMapping::Release(), neither of
+    // which can be in the window.
+    std::map<KeyFrame*, g2o::VertexSE3Expmap*> mmKeyFrames;
+    std::map<MapPoint*, Point> mmPoints;
+};
+
+}  // namespace ORB_SLAM2
+
+#endif  // _LOCAL_BA_WINDOW_H_
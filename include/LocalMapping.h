@@ -28,6 +28,8 @@
 #include "KeyFrameDatabase.h"
 
 #include <mutex>
+#include <condition_variable>
+#include <memory>
 
 
 namespace ORB_SLAM2
@@ -36,11 +38,13 @@ namespace ORB_SLAM2
 class Tracking;
 class LoopClosing;
 class Map;
+class LocalBAWindow;
 
 class LocalMapping
 {
 public:
     LocalMapping(Map* pMap, const float bMonocular);
+    ~LocalMapping();
 
     void SetLoopCloser(LoopClosing* pLoopCloser);
 
@@ -75,9 +79,20 @@ public:
 protected:
 
     bool CheckNewKeyFrames();
+    // Sleeps until a keyframe is inserted or a thread request arrives, at most a few ms
+    void WaitForNewKeyFrames();
     void ProcessNewKeyFrame();
     void CreateNewMapPoints();
 
+    // Match of CreateNewMapPoints: keypoint idx1 of the current keyframe, idx2 of the neighbor
+    struct TriangulatedPoint {
+        size_t idx1;
+        size_t idx2;
+        Eigen::Vector3f x3D;
+    };
+    // Triangulation with one neighbor, does not modify the map (runs in parallel)
+    void TriangulateWithNeighbor(KeyFrame* pKF2, std::vector<TriangulatedPoint> &vPoints);
+
     void MapPointCulling();
     void SearchInNeighbors();
 
@@ -111,9 +126,13 @@ protected:
     std::list<MapPoint*> mlpRecentAddedMapPoints;
 
     std::mutex mMutexNewKFs;
+    std::condition_variable mCondNewKFs;
 
     bool mbAbortBA;
 
+    // g2o graph of the local BA, kept between keyframes
+    std::unique_ptr<LocalBAWindow> mpLocalBAWindow;
+
     bool mbStopped;
     bool mbStopRequested;
     bool mbNotStop;
@@ -29,6 +29,7 @@
 
 #include "KeyFrameDatabase.h"
 
+#include <atomic>
 #include <thread>
 #include <mutex>
 #include "Thirdparty/g2o/g2o/types/types_seven_dof_expmap.h"
@@ -90,6 +91,12 @@ protected:
 
     bool ComputeSim3();
 
+    // RANSAC + guided matching + Sim3 optimization of the loop candidate of rank nRank.
+    // Runs on the ThreadPool in ComputeSim3, returns early once a better ranked candidate
+    // has been accepted (nBestRank<nRank).
+    bool VerifyLoopCandidate(KeyFrame* pKF, const int nRank, const std::atomic<int>& nBestRank,
+                             g2o::Sim3& gScm, std::vector<MapPoint*>& vpMapPointMatches);
+
     void SearchAndFuse(const KeyFrameAndPose &CorrectedPosesMap);
 
     void CorrectLoop();
@@ -138,6 +145,8 @@ protected:
     bool mbStopGBA;
     std::mutex mMutexGBA;
     std::thread* mpThreadGBA;
+    // Newest keyframe included in the last global BA applied to the map (0: none yet)
+    long unsigned int mnLastGBAKFid;
 
     // Fix scale in the stereo/RGB-D case
     bool mbFixScale;
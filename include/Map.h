@@ -51,6 +51,9 @@ public:
 
     std::vector<KeyFrame*> GetAllKeyFrames();
     std::vector<MapPoint*> GetAllMapPoints();
+    // Snapshots into the caller's buffer, reusing its capacity (e.g. once per drawn frame)
+    void GetAllKeyFrames(std::vector<KeyFrame*> &vpKFs);
+    void GetAllMapPoints(std::vector<MapPoint*> &vpMPs);
     std::vector<MapPoint*> GetReferenceMapPoints();
 
     //=====================
@@ -86,8 +89,12 @@ protected:
     std::set<Map*> mspMaps;
     unsigned long int mnLastInitKFidMap;
 
-    std::set<MapPoint*> mspMapPoints;
-    std::set<KeyFrame*> mspKeyFrames;
+    // 地图中的关键帧和地图点连续存放 (顺序不固定, 删除时用最后一个元素填补空位)。
+    // mvnKeyFramePos/mvnMapPointPos 以对象的 mnHandle 为下标, 记录它在数组中的位置 (-1: 不在地图中)
+    std::vector<MapPoint*> mvpMapPoints;
+    std::vector<KeyFrame*> mvpKeyFrames;
+    std::vector<int> mvnMapPointPos;
+    std::vector<int> mvnKeyFramePos;
 
     std::vector<MapPoint*> mvpReferenceMapPoints;
 
@@ -57,6 +57,12 @@ private:
     cv::Mat mCameraPose;
 
     std::mutex mMutexCamera;
+
+    // Map snapshots reused between drawn frames (Viewer thread only)
+    std::vector<MapPoint*> mvpMapPoints;
+    std::vector<KeyFrame*> mvpKeyFrames;
+    // Reference map point flags, indexed by MapPoint::mnHandle
+    std::vector<unsigned char> mvbReferenceMP;
 };
 
 } //namespace ORB_SLAM
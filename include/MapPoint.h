@@ -24,9 +24,14 @@
 #include "KeyFrame.h"
 #include "Frame.h"
 #include "Map.h"
+#include "ObjectPool.h"
+#include "SmallVector.h"
+#include "DescriptorMedoid.h"
 
 #include <opencv2/core/core.hpp>
+#include <Eigen/Core>
 #include <mutex>
+#include <utility>
 
 namespace ORB_SLAM2
 {
@@ -47,18 +52,43 @@ public:
     MapPoint(const cv::Mat &Pos, KeyFrame* pRefKF, Map* pMap);
     MapPoint(const cv::Mat &Pos,  Map* pMap, Frame* pFrame, const int &idxF);
 
+    POOL_ALLOCATED_OBJECT(MapPoint)
+
     void SetWorldPos(const cv::Mat &Pos);
+    // The getters of position, normal and distances read MapPointStore without locking
     cv::Mat GetWorldPos();
+    Eigen::Vector3f GetWorldPosEigen();
 
     cv::Mat GetNormal();
     KeyFrame* GetReferenceKeyFrame();
 
-    std::map<KeyFrame*,size_t> GetObservations();
+    // Observing keyframe and keypoint index, in insertion order. Most points are
+    // seen by a handful of keyframes, so the list is stored inline.
+    typedef std::pair<KeyFrame*,size_t> Observation;
+    typedef SmallVector<Observation,8> ObservationList;
+
+    ObservationList GetObservations();
     int Observations();
 
+    // Calls f(pKF,idx) for each observation while holding mMutexFeatures, without
+    // copying the list. f must not call into this MapPoint nor lock the features
+    // of a KeyFrame (KeyFrame locks its features before those of its points).
+    template <class F>
+    void ForEachObservation(F f)
+    {
+        std::unique_lock<std::mutex> lock(mMutexFeatures);
+        for(ObservationList::const_iterator it=mObservations.begin(), itend=mObservations.end(); it!=itend; it++)
+            f(it->first,it->second);
+    }
+
     void AddObservation(KeyFrame* pKF,size_t idx);
     void EraseObservation(KeyFrame* pKF);
 
+    // Number of keyframes other than pKF observing the point at a scale level
+    // <= maxLevel, answered from per-level counters kept up to date by
+    // Add/EraseObservation instead of walking the observations (KeyFrameCulling).
+    int ObservationsUpToLevel(int maxLevel, KeyFrame* pKF);
+
     int GetIndexInKeyFrame(KeyFrame* pKF);
     bool IsInKeyFrame(KeyFrame* pKF);
 
@@ -99,6 +129,8 @@ public:
 
     long unsigned int mnId;
     static long unsigned int nNextId;
+    // ObjectPool slot, dense and reused after the point is deleted (see Map)
+    size_t mnHandle;
     long int mnFirstKFid;
     long int mnFirstFrame;
     int nObs;
@@ -136,7 +168,15 @@ protected:
     cv::Mat mWorldPos;
 
     // Keyframes observing the point and associated index in keyframe
-    std::map<KeyFrame*,size_t> mObservations;
+    ObservationList mObservations;
+    // Position of pKF in mObservations or end(), must hold mMutexFeatures
+    ObservationList::iterator FindObservation(KeyFrame* pKF);
+
+    // Observations per keypoint octave, must hold mMutexFeatures. ORB pyramids
+    // have far fewer levels, deeper octaves share the last counter.
+    static const int MAX_OBS_LEVELS = 32;
+    int mvnObsPerLevel[MAX_OBS_LEVELS];
+    static int ObsLevel(KeyFrame* pKF, size_t idx);
 
     // Mean viewing direction
     cv::Mat mNormalVector;
@@ -144,6 +184,10 @@ protected:
     // Best descriptor to fast matching
     cv::Mat mDescriptor;
 
+    // Sampled observation descriptors, updated with every added or erased observation.
+    // Guarded by mMutexFeatures like mObservations
+    DescriptorMedoid mMedoid;
+
     // Reference KeyFrame
     KeyFrame* mpRefKF;
 
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#ifndef _MAP_POINT_STORE_H_
+#define _MAP_POINT_STORE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+
+#include <opencv2/core/core.hpp>
+
+#include "SeqLock.h"
+
+namespace ORB_SLAM2 {
+
+// 地图点热数据的SoA存储, 以 MapPoint::mnHandle 为下标:
+// 位置, 平均观测方向, 尺度不变距离, 描述子, 运动概率。
+// MapPoint 修改这些成员时同步写入 (cv::Mat 成员保留给其余代码), 投影/匹配的循环直接从这里读,
+// 不再对每个点加锁和复制 cv::Mat。
+// 几何数据和描述子各有一个序列锁 (SeqLock): 写者已经由 MapPoint 的 mMutexPos / mMutexFeatures
+// 串行化, 读者不加锁, 读到正在写入的数据时重试。
+class MapPointStore {
+public:
+    static const int DESC_BYTES = 32;
+
+    static MapPointStore& Instance();
+
+    // Makes room for handle h and clears its entry, called by the MapPoint constructors.
+    // Throws std::bad_alloc past MAX_HANDLES, like the allocation of the MapPoint itself.
+    void Reset(size_t h);
+
+    // Writers. The writes of one point must be serialized by the caller
+    // (geometry under MapPoint::mMutexPos, descriptor under mMutexFeatures).
+    void SetWorldPos(size_t h, const cv::Mat& Pos);
+    void SetNormalAndDepth(size_t h, const cv::Mat& Normal, float fMinDistance, float fMaxDistance);
+    void SetDescriptor(size_t h, const cv::Mat& Descriptor);
+    void SetMovingProbability(size_t h, float p);
+
+    // Lock-free readers of a consistent copy. fMinDistance/fMaxDistance are the
+    // raw distances, without the 0.8/1.2 factors of Get*DistanceInvariance().
+    void GetGeometry(size_t h, float* P, float* Normal, float& fMinDistance, float& fMaxDistance) const;
+    void GetWorldPos(size_t h, float* P) const;
+    void GetDistances(size_t h, float& fMinDistance, float& fMaxDistance) const;
+    void GetDescriptor(size_t h, unsigned char* Descriptor) const;
+    float GetMovingProbability(size_t h) const;
+
+    // MapPoint::PredictScale for a given maximum distance
+    static int PredictScale(float fMaxDistance, float currentDist, float fLogScaleFactor, int nScaleLevels);
+
+private:
+    // same as the ObjectPool slabs
+    static const size_t CHUNK = 1024;
+    // Chunks are reached through directories allocated on demand, so the store grows
+    // with the MapPoint pool. Only the top level array has a fixed size.
+    static const size_t DIR_CHUNKS = 1024;
+    static const size_t MAX_DIRS = 1 << 12;
+    static const size_t MAX_HANDLES = MAX_DIRS * DIR_CHUNKS * CHUNK;
+
+    struct Chunk {
+        SeqLock vSeqGeometry[CHUNK];
+        SeqLock vSeqDescriptor[CHUNK];
+        std::atomic<float> vX[CHUNK], vY[CHUNK], vZ[CHUNK];
+        std::atomic<float> vNx[CHUNK], vNy[CHUNK], vNz[CHUNK];
+        std::atomic<float> vMinDistance[CHUNK], vMaxDistance[CHUNK];
+        std::atomic<float> vMovingProbability[CHUNK];
+        std::atomic<uint64_t> vDescriptor[CHUNK][DESC_BYTES / 8];
+    };
+
+    struct Directory {
+        Directory();
+        std::atomic<Chunk*> vpChunks[DIR_CHUNKS];
+    };
+
+    MapPointStore();
+    MapPointStore(const MapPointStore&);
+    MapPointStore& operator=(const MapPointStore&);
+
+    // h must have been Reset() before
+    Chunk& GetChunk(size_t h) const
+    {
+        const size_t c = h / CHUNK;
+        const Directory* pDir = mpDirs[c / DIR_CHUNKS].load(std::memory_order_acquire);
+        return *pDir->vpChunks[c % DIR_CHUNKS].load(std::memory_order_acquire);
+    }
+
+    std::atomic<Directory*> mpDirs[MAX_DIRS];
+    std::mutex mMutexChunks;
+};
+
+}  // namespace ORB_SLAM2
+
+#endif  // _MAP_POINT_STORE_H_
@@ -22,6 +22,10 @@
 #ifndef ORBVOCABULARY_H
 #define ORBVOCABULARY_H
 
+#include<stdint.h>
+#include<string>
+#include<vector>
+
 #include"Thirdparty/DBoW2/DBoW2/FORB.h"
 #include"Thirdparty/DBoW2/DBoW2/TemplatedVocabulary.h"
 
@@ -29,7 +33,70 @@ namespace ORB_SLAM2
 {
 
 typedef DBoW2::TemplatedVocabulary<DBoW2::FORB::TDescriptor, DBoW2::FORB>
-  ORBVocabulary;
+  ORBVocabularyBase;
+
+// ORB vocabulary with a packed copy of the tree used to descend it.
+// The children of every node are stored contiguously (level by level) as
+// raw 256-bit descriptors, so transforming a frame needs neither one cv::Mat
+// header per descriptor nor a copy of the children list at every level.
+class ORBVocabulary : public ORBVocabularyBase
+{
+public:
+    ORBVocabulary();
+    ~ORBVocabulary();
+
+    // Loads the vocabulary and builds the packed descent tree
+    bool loadFromTextFile(const std::string &filename);
+
+    // Binary vocabulary (see ORBVocabulary.cc for the layout). The file stays
+    // memory mapped and the node descriptors point into it. Returns false if
+    // the file is truncated or its tree and word counts are inconsistent.
+    bool loadFromBinaryFile(const std::string &filename);
+    bool saveToBinaryFile(const std::string &filename) const;
+
+    // Binary if the file name ends with ".bin", text otherwise
+    bool load(const std::string &filename);
+
+    // Transforms the rows of a Nx32 CV_8U descriptor matrix into a bow vector
+    // and a feature vector (nodes at levelsup levels from the leaves).
+    // Same result as the generic transform on Converter::toDescriptorVector.
+    void transform(const cv::Mat &descriptors, DBoW2::BowVector &v,
+                   DBoW2::FeatureVector &fv, int levelsup) const;
+
+    using ORBVocabularyBase::transform;
+
+    // Must be called after the tree has been modified (create, load, ...)
+    void BuildDescentCache();
+
+    // node descriptors may point into the mapped file
+    ORBVocabulary(const ORBVocabulary &) = delete;
+    ORBVocabulary& operator=(const ORBVocabulary &) = delete;
+
+protected:
+
+    // Descends the tree for one descriptor
+    void Descend(const uint8_t *feature, DBoW2::WordId &word_id, DBoW2::WordValue &weight,
+                 DBoW2::NodeId &nid, const int nid_level) const;
+
+    void ReleaseMapping();
+
+    // per node: range [mvChildBegin[id], mvChildBegin[id]+mvChildCount[id]) in the child arrays
+    std::vector<unsigned int> mvChildBegin;
+    std::vector<unsigned int> mvChildCount;
+
+    // binary vocabulary file, mapped while the nodes use it
+    void *mpMapping;
+    size_t mnMappingSize;
+    // descriptor of node id at mpNodeDescriptors+32*id, NULL unless binary
+    const uint8_t *mpNodeDescriptors;
+
+    // children, 32 bytes per descriptor: mpNodeDescriptors itself when every children
+    // list has consecutive ids (mvChildIds empty, the child index is the node id),
+    // otherwise the packed copy in mvChildDescriptors
+    const uint8_t *mpChildDescriptors;
+    std::vector<DBoW2::NodeId> mvChildIds;
+    std::vector<uint8_t> mvChildDescriptors;
+};
 
 } //namespace ORB_SLAM
 
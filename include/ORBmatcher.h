@@ -115,6 +115,15 @@ public:
     // Project MapPoints into KeyFrame and search for duplicated MapPoints.
     int Fuse(KeyFrame* pKF, const vector<MapPoint *> &vpMapPoints, const float th=3.0);
 
+    // The two phases of Fuse: the search only reads the map and can run in parallel,
+    // ApplyFuse then replaces or adds the matched MapPoints (pMP, keypoint index in pKF).
+    // Matches searched before other fusions were applied are re-validated: replaced
+    // points are followed to their replacement, and the descriptor distance is checked
+    // again against the current descriptor.
+    void SearchFuse(KeyFrame* pKF, const vector<MapPoint *> &vpMapPoints, vector<pair<MapPoint*,size_t> > &vMatches,
+                    const float th=3.0);
+    static int ApplyFuse(KeyFrame* pKF, const vector<pair<MapPoint*,size_t> > &vMatches);
+
     // Project MapPoints into KeyFrame using a given Sim3 and search for duplicated MapPoints.
     int Fuse(KeyFrame* pKF, cv::Mat Scw, const std::vector<MapPoint*> &vpPoints, float th, vector<MapPoint *> &vpReplacePoint);
 
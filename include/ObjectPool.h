@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#ifndef _OBJECT_POOL_H_
+#define _OBJECT_POOL_H_
+
+#include <assert.h>
+#include <stddef.h>
+#include <mutex>
+#include <vector>
+
+namespace ORB_SLAM2 {
+
+// 定长对象的slab内存池 (MapPoint, KeyFrame 的 operator new/delete 使用)。
+// 对象按 SlabSize 个一组连续分配, 释放的槽位放回空闲链表重用, 内存不还给系统,
+// 长时间运行也不会产生堆碎片。
+// 每个槽位有固定的整数句柄 (槽位序号): 对象存活期间句柄不变, 对象释放后句柄会被新对象重用。
+// 句柄是稠密的 (< Capacity()), 可以直接作为数组下标。
+template <class T, size_t SlabSize = 1024>
+class ObjectPool {
+public:
+    typedef size_t Handle;
+
+    // Never destroyed, objects may still be deleted during static destruction
+    static ObjectPool& Instance()
+    {
+        static ObjectPool* pPool = new ObjectPool();
+        return *pPool;
+    }
+
+    void* Allocate()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (!mpFree)
+            AddSlab();
+        Slot* pSlot = mpFree;
+        mpFree = pSlot->pNext;
+        return pSlot->storage;
+    }
+
+    void Release(void* p)
+    {
+        if (!p)
+            return;
+        std::unique_lock<std::mutex> lock(mMutex);
+        Slot* pSlot = reinterpret_cast<Slot*>(p);
+        pSlot->pNext = mpFree;
+        mpFree = pSlot;
+    }
+
+    // p must come from Allocate()
+    static Handle HandleOf(const void* p) { return reinterpret_cast<const Slot*>(p)->nHandle; }
+
+    // Number of handles handed out so far, all handles are below it
+    size_t Capacity()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        return mvpSlabs.size() * SlabSize;
+    }
+
+private:
+    struct Slot {
+        // first member: the object address is the slot address
+        alignas(T) unsigned char storage[sizeof(T)];
+        Handle nHandle;
+        Slot* pNext;
+    };
+
+    ObjectPool() : mpFree(NULL) {}
+    ObjectPool(const ObjectPool&);
+    ObjectPool& operator=(const ObjectPool&);
+
+    void AddSlab()
+    {
+        Slot* pSlab = new Slot[SlabSize];
+        const Handle nBase = mvpSlabs.size() * SlabSize;
+        mvpSlabs.push_back(pSlab);
+
+        // lower handles first
+        for (size_t i = SlabSize; i-- > 0;) {
+            pSlab[i].nHandle = nBase + i;
+            pSlab[i].pNext = mpFree;
+            mpFree = &pSlab[i];
+        }
+    }
+
+    std::mutex mMutex;
+    std::vector<Slot*> mvpSlabs;
+    Slot* mpFree;
+};
+
+// Class-level allocation through ObjectPool<Class>. Objects of this class must
+// only be created with new.
+#define POOL_ALLOCATED_OBJECT(Class)                                        \
+    static void* operator new(size_t nSize)                                 \
+    {                                                                       \
+        assert(nSize == sizeof(Class));                                     \
+        (void)nSize;                                                        \
+        return ObjectPool<Class>::Instance().Allocate();                    \
+    }                                                                       \
+    static void operator delete(void* p) { ObjectPool<Class>::Instance().Release(p); }
+
+}  // namespace ORB_SLAM2
+
+#endif  // _OBJECT_POOL_H_
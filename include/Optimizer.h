@@ -33,6 +33,7 @@ namespace ORB_SLAM2
 {
 
 class LoopClosing;
+class LocalBAWindow;
 //class DynaSLAM::Geometry;
 class Optimizer
 {
@@ -44,7 +45,16 @@ public:
                                  const bool bRobust = true);
     void static GlobalBundleAdjustemnt(Map* pMap, int nIterations=5, bool *pbStopFlag=NULL,
                                        const unsigned long nLoopKF=0, const bool bRobust = true);
-    void static LocalBundleAdjustment(KeyFrame* pKF, bool *pbStopFlag, Map *pMap);
+    // Global BA after a loop closure that only re-optimizes the keyframes added since the last
+    // global BA (nLastGBAKFid is the newest keyframe it included) and those whose observations
+    // became inconsistent, plus their covisible keyframes. Falls back to the full BA on the
+    // first call or when most of the map is affected. Results go to mTcwGBA/mPosGBA as in
+    // GlobalBundleAdjustemnt with nLoopKF>0. Returns the newest keyframe included. If the
+    // subgraph has neither keyframe 0 nor a fixed neighbour, its oldest keyframe is fixed.
+    unsigned long static IncrementalGlobalBundleAdjustment(Map* pMap, int nIterations, bool *pbStopFlag,
+                                                           const unsigned long nLoopKF, const unsigned long nLastGBAKFid);
+    // pWindow keeps the g2o graph between calls (see LocalBAWindow), NULL builds it from scratch
+    void static LocalBundleAdjustment(KeyFrame* pKF, bool *pbStopFlag, Map *pMap, LocalBAWindow* pWindow=NULL);
     int static PoseOptimization(Frame* pFrame);
 
     //========语义分割位姿优化====
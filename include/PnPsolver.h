@@ -52,8 +52,10 @@
 #define PNPSOLVER_H
 
 #include <opencv2/core/core.hpp>
+#include <Eigen/Core>
 #include "MapPoint.h"
 #include "Frame.h"
+#include "Ransac.h"
 
 namespace ORB_SLAM2
 {
@@ -67,6 +69,9 @@ class PnPsolver {
   void SetRansacParameters(double probability = 0.99, int minInliers = 8 , int maxIterations = 300, int minSet = 4, float epsilon = 0.4,
                            float th2 = 5.991);
 
+  // Seeds the minimal set sampler, task identifies this solver among the ones run in parallel
+  void SetSeed(unsigned int seed, unsigned int task) { mSampler.Seed(seed, task); }
+
   cv::Mat find(vector<bool> &vbInliers, int &nInliers);
 
   cv::Mat iterate(int nIterations, bool &bNoMore, vector<bool> &vbInliers, int &nInliers);
@@ -93,16 +98,15 @@ class PnPsolver {
 
   void choose_control_points(void);
   void compute_barycentric_coordinates(void);
-  void fill_M(CvMat * M, const int row, const double * alphas, const double u, const double v);
+  void add_M_rows(Eigen::Matrix<double, 12, 12> & MtM, const double * alphas, const double u, const double v);
   void compute_ccs(const double * betas, const double * ut);
   void compute_pcs(void);
 
   void solve_for_sign(void);
 
-  void find_betas_approx_1(const CvMat * L_6x10, const CvMat * Rho, double * betas);
-  void find_betas_approx_2(const CvMat * L_6x10, const CvMat * Rho, double * betas);
-  void find_betas_approx_3(const CvMat * L_6x10, const CvMat * Rho, double * betas);
-  void qr_solve(CvMat * A, CvMat * b, CvMat * X);
+  void find_betas_approx_1(const double * l_6x10, const double * rho, double * betas);
+  void find_betas_approx_2(const double * l_6x10, const double * rho, double * betas);
+  void find_betas_approx_3(const double * l_6x10, const double * rho, double * betas);
 
   double dot(const double * v1, const double * v2);
   double dist2(const double * p1, const double * p2);
@@ -110,9 +114,9 @@ class PnPsolver {
   void compute_rho(double * rho);
   void compute_L_6x10(const double * ut, double * l_6x10);
 
-  void gauss_newton(const CvMat * L_6x10, const CvMat * Rho, double current_betas[4]);
+  void gauss_newton(const double * l_6x10, const double * rho, double current_betas[4]);
   void compute_A_and_b_gauss_newton(const double * l_6x10, const double * rho,
-				    double cb[4], CvMat * A, CvMat * b);
+				    double cb[4], Eigen::Matrix<double, 6, 4> & A, Eigen::Matrix<double, 6, 1> & b);
 
   double compute_R_and_t(const double * ut, const double * betas,
 			 double R[3][3], double t[3]);
@@ -137,11 +141,11 @@ class PnPsolver {
   vector<MapPoint*> mvpMapPointMatches;
 
   // 2D Points
-  vector<cv::Point2f> mvP2D;
+  vector<float> mvU, mvV;
   vector<float> mvSigma2;
 
   // 3D Points
-  vector<cv::Point3f> mvP3Dw;
+  vector<float> mvX, mvY, mvZ;
 
   // Index in Frame
   vector<size_t> mvKeyPointIndices;
@@ -150,25 +154,26 @@ class PnPsolver {
   double mRi[3][3];
   double mti[3];
   cv::Mat mTcwi;
-  vector<bool> mvbInliersi;
+  vector<unsigned char> mvbInliersi;
   int mnInliersi;
 
   // Current Ransac State
   int mnIterations;
-  vector<bool> mvbBestInliers;
+  vector<unsigned char> mvbBestInliers;
   int mnBestInliers;
   cv::Mat mBestTcw;
 
   // Refined
   cv::Mat mRefinedTcw;
-  vector<bool> mvbRefinedInliers;
+  vector<unsigned char> mvbRefinedInliers;
   int mnRefinedInliers;
 
   // Number of Correspondences
   int N;
 
-  // Indices for random selection [0 .. N-1]
-  vector<size_t> mvAllIndices;
+  // Minimal set selection over [0 .. N-1]
+  Ransac::Sampler mSampler;
+  vector<size_t> mvMinSet;
 
   // RANSAC probability
   double mRansacProb;
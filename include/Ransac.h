@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#ifndef _RANSAC_H_
+#define _RANSAC_H_
+
+#include <stddef.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace ORB_SLAM2 {
+
+// Initializer, Sim3Solver, PnPsolver 共用的RANSAC部分:
+//  - 最小集采样 (不再每次迭代复制整个索引数组, 每个采样器有自己的随机数生成器)
+//  - SoA存储的对应点上的批量模型打分 (AVX, 否则标量)
+//  - 提前终止: 打分到一半时如果剩下的点全是内点也赢不了当前最优, 就放弃该假设。
+//    这是确定性的上界检验, 不会改变RANSAC的结果。
+class Ransac {
+public:
+    // Returned by the scoring functions when a hypothesis was abandoned
+    static const int ABANDONED = -1;
+
+    // Uniform minimal sets of k distinct indices out of [0,n). Every sampler
+    // has its own generator, so RANSAC tasks running on different threads do
+    // not share the global rand() state and draw the same sets in any schedule.
+    class Sampler {
+    public:
+        Sampler() { Seed(0, 0); }
+
+        // Seeds the generator from the run seed and the index of the task
+        // (candidate keyframe, ...) that owns this sampler
+        void Seed(unsigned int seed, unsigned int task);
+
+        void Reset(int n);
+        int Size() const { return mvPool.size(); }
+
+        // Partial Fisher-Yates over a persistent permutation
+        void Sample(int k, size_t* vIndices);
+
+    private:
+        std::vector<size_t> mvPool;
+        std::mt19937 mRng;
+    };
+
+    // Symmetric transfer error of H21/H12 (row major) over the matches
+    // (u1,v1)<->(u2,v2). score = sum of (th - chi2) over both images for every
+    // chi2 <= th. Gives up with ABANDONED as soon as the score cannot exceed
+    // bestScore any more.
+    static float ScoreHomography(const float* H21, const float* H12,
+                                 const float* u1, const float* v1, const float* u2, const float* v2, int n,
+                                 float th, float invSigmaSquare, float bestScore, unsigned char* vbInliers);
+
+    // Point to epipolar line distance in both images for F21 (row major).
+    // A match is an inlier if both chi2 <= th, the score adds (thScore - chi2).
+    static float ScoreFundamental(const float* F21,
+                                  const float* u1, const float* v1, const float* u2, const float* v2, int n,
+                                  float th, float thScore, float invSigmaSquare, float bestScore, unsigned char* vbInliers);
+
+    // Projects (X,Y,Z) with [R|t] (R row major) and the pinhole K, and flags the
+    // points whose squared distance to (u,v) is below maxError. If vbMask is
+    // given, points with vbMask[i]==0 are outliers. Returns the number of
+    // inliers, or ABANDONED once fewer than minInliers can be reached.
+    static int ReprojectionInliers(const float* R, const float* t, float fx, float fy, float cx, float cy,
+                                   const float* X, const float* Y, const float* Z,
+                                   const float* u, const float* v, const float* maxError, int n,
+                                   const unsigned char* vbMask, int minInliers, unsigned char* vbInliers);
+};
+
+}  // namespace ORB_SLAM2
+
+#endif  // _RANSAC_H_
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#ifndef _RELOCALIZER_H_
+#define _RELOCALIZER_H_
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM2 {
+
+class Frame;
+class KeyFrame;
+class MapPoint;
+class PnPsolver;
+
+// 重定位候选关键帧的并行PnP RANSAC, 由 Tracking 持有, 工作线程使用常驻的 ThreadPool。
+// SetCandidates() 并行地对每个候选帧做BoW匹配并建立PnPsolver;
+// NextRound() 并行地让每个仍有效的候选帧做5次RANSAC迭代, 按候选帧下标的顺序返回位姿假设,
+// 跟踪线程按这个顺序优化验证, 与原来单线程的结果相同, 不受线程调度影响。
+class Relocalizer {
+public:
+    struct Hypothesis {
+        int nCandidate;  // index in vpCandidateKFs
+        cv::Mat Tcw;
+        std::vector<bool> vbInliers;
+        int nInliers;
+    };
+
+    Relocalizer();
+    ~Relocalizer();
+
+    // Starts a relocalization of F against the candidates. F must stay alive
+    // until Clear(), the workers only read its keypoints, descriptors and BoW.
+    void SetCandidates(Frame* pF, const std::vector<KeyFrame*>& vpCandidateKFs);
+
+    // Runs one round of RANSAC iterations over the remaining candidates and
+    // returns their hypotheses in candidate order. Returns false once all the
+    // candidates are exhausted.
+    bool NextRound(std::vector<Hypothesis>& vHypotheses);
+
+    // BoW matches of candidate i, valid for the hypotheses of that candidate
+    const std::vector<MapPoint*>& GetMatches(int i) const { return mvvpMapPointMatches[i]; }
+
+    // Releases the solvers of the current relocalization
+    void Clear();
+
+private:
+    Relocalizer(const Relocalizer&);
+    Relocalizer& operator=(const Relocalizer&);
+
+    Frame* mpFrame;
+    std::vector<KeyFrame*> mvpCandidateKFs;
+
+    std::vector<std::vector<MapPoint*> > mvvpMapPointMatches;
+    std::vector<PnPsolver*> mvpPnPsolvers;
+
+    // Candidates still iterating, in increasing index order
+    std::vector<int> mvActive;
+
+    // Per active candidate results of the last round
+    std::vector<Hypothesis> mvRound;
+    std::vector<char> mvbNoMore;
+};
+
+}  // namespace ORB_SLAM2
+
+#endif  // _RELOCALIZER_H_
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#ifndef _SEQ_LOCK_H_
+#define _SEQ_LOCK_H_
+
+#include <atomic>
+
+namespace ORB_SLAM2 {
+
+// 序列锁: 写者之间必须已经互斥 (由调用者的互斥量保证), 读者不加锁,
+// 发现读取期间有写入 (序列号为奇数或发生变化) 就重读。
+// 被保护的数据用 relaxed 原子变量存放, 这样并发读写不构成数据竞争。
+//
+//   writer:  seq.BeginWrite(); ...store... seq.EndWrite();
+//   reader:  unsigned int s;
+//            do { s = seq.BeginRead(); ...load... } while (!seq.EndRead(s));
+class SeqLock {
+public:
+    SeqLock() : mnSeq(0) {}
+
+    void BeginWrite()
+    {
+        mnSeq.store(mnSeq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void EndWrite() { mnSeq.store(mnSeq.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    unsigned int BeginRead() const
+    {
+        unsigned int s;
+        while ((s = mnSeq.load(std::memory_order_acquire)) & 1u)
+            ;
+        return s;
+    }
+
+    bool EndRead(unsigned int s) const
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return mnSeq.load(std::memory_order_relaxed) == s;
+    }
+
+    // Copies n relaxed atomics, for use between BeginWrite/EndWrite or BeginRead/EndRead
+    template <class T>
+    static void Store(std::atomic<T>* dst, const T* src, int n)
+    {
+        for (int i = 0; i < n; i++)
+            dst[i].store(src[i], std::memory_order_relaxed);
+    }
+
+    template <class T>
+    static void Load(const std::atomic<T>* src, T* dst, int n)
+    {
+        for (int i = 0; i < n; i++)
+            dst[i] = src[i].load(std::memory_order_relaxed);
+    }
+
+private:
+    SeqLock(const SeqLock&);
+    SeqLock& operator=(const SeqLock&);
+
+    std::atomic<unsigned int> mnSeq;
+};
+
+}  // namespace ORB_SLAM2
+
+#endif  // _SEQ_LOCK_H_
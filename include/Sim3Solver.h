@@ -26,6 +26,7 @@
 #include <vector>
 
 #include "KeyFrame.h"
+#include "Ransac.h"
 
 
 
@@ -40,6 +41,9 @@ public:
 
     void SetRansacParameters(double probability = 0.99, int minInliers = 6 , int maxIterations = 300);
 
+    // Seeds the minimal set sampler, task identifies this solver among the ones run in parallel
+    void SetSeed(unsigned int seed, unsigned int task) { mSampler.Seed(seed, task); }
+
     cv::Mat find(std::vector<bool> &vbInliers12, int &nInliers);
 
     cv::Mat iterate(int nIterations, bool &bNoMore, std::vector<bool> &vbInliers, int &nInliers);
@@ -57,8 +61,8 @@ protected:
 
     void CheckInliers();
 
-    void Project(const std::vector<cv::Mat> &vP3Dw, std::vector<cv::Mat> &vP2D, cv::Mat Tcw, cv::Mat K);
-    void FromCameraToImage(const std::vector<cv::Mat> &vP3Dc, std::vector<cv::Mat> &vP2D, cv::Mat K);
+    void FromCameraToImage(const std::vector<float> &vX, const std::vector<float> &vY, const std::vector<float> &vZ,
+                           std::vector<float> &vU, std::vector<float> &vV, cv::Mat K);
 
 
 protected:
@@ -67,16 +71,15 @@ protected:
     KeyFrame* mpKF1;
     KeyFrame* mpKF2;
 
-    std::vector<cv::Mat> mvX3Dc1;
-    std::vector<cv::Mat> mvX3Dc2;
+    // Matched points in camera coordinates of KF1 and KF2 (SoA)
+    std::vector<float> mvX1, mvY1, mvZ1;
+    std::vector<float> mvX2, mvY2, mvZ2;
     std::vector<MapPoint*> mvpMapPoints1;
     std::vector<MapPoint*> mvpMapPoints2;
     std::vector<MapPoint*> mvpMatches12;
     std::vector<size_t> mvnIndices1;
-    std::vector<size_t> mvSigmaSquare1;
-    std::vector<size_t> mvSigmaSquare2;
-    std::vector<size_t> mvnMaxError1;
-    std::vector<size_t> mvnMaxError2;
+    std::vector<float> mvMaxError1;
+    std::vector<float> mvMaxError2;
 
     int N;
     int mN1;
@@ -87,12 +90,12 @@ protected:
     float ms12i;
     cv::Mat mT12i;
     cv::Mat mT21i;
-    std::vector<bool> mvbInliersi;
+    std::vector<unsigned char> mvbInliersi;
     int mnInliersi;
 
     // Current Ransac State
     int mnIterations;
-    std::vector<bool> mvbBestInliers;
+    std::vector<unsigned char> mvbBestInliers;
     int mnBestInliers;
     cv::Mat mBestT12;
     cv::Mat mBestRotation;
@@ -102,12 +105,12 @@ protected:
     // Scale is fixed to 1 in the stereo/RGBD case
     bool mbFixScale;
 
-    // Indices for random selection
-    std::vector<size_t> mvAllIndices;
+    // Minimal set selection
+    Ransac::Sampler mSampler;
 
-    // Projections
-    std::vector<cv::Mat> mvP1im1;
-    std::vector<cv::Mat> mvP2im2;
+    // Projections, P1 in image 1 and P2 in image 2
+    std::vector<float> mvU1, mvV1;
+    std::vector<float> mvU2, mvV2;
 
     // RANSAC probability
     double mRansacProb;
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#ifndef _SMALL_VECTOR_H_
+#define _SMALL_VECTOR_H_
+
+#include <stddef.h>
+#include <algorithm>
+
+namespace ORB_SLAM2 {
+
+// 小容量向量: 前 N 个元素存放在对象内部, 超过 N 个才在堆上分配。
+// 用于元素通常很少的列表 (如地图点的观测), 复制和插入一般不分配内存。
+// T 需要可默认构造和赋值, 元素保持插入顺序。
+template <class T, size_t N>
+class SmallVector {
+public:
+    typedef T value_type;
+    typedef T* iterator;
+    typedef const T* const_iterator;
+
+    SmallVector() : mpData(mInline), mnSize(0), mnCapacity(N) {}
+
+    SmallVector(const SmallVector& other) : mpData(mInline), mnSize(0), mnCapacity(N) { *this = other; }
+
+    ~SmallVector()
+    {
+        if (mpData != mInline)
+            delete[] mpData;
+    }
+
+    SmallVector& operator=(const SmallVector& other)
+    {
+        if (this == &other)
+            return *this;
+        reserve(other.mnSize);
+        std::copy(other.begin(), other.end(), mpData);
+        mnSize = other.mnSize;
+        return *this;
+    }
+
+    size_t size() const { return mnSize; }
+    bool empty() const { return mnSize == 0; }
+
+    iterator begin() { return mpData; }
+    iterator end() { return mpData + mnSize; }
+    const_iterator begin() const { return mpData; }
+    const_iterator end() const { return mpData + mnSize; }
+
+    T& operator[](size_t i) { return mpData[i]; }
+    const T& operator[](size_t i) const { return mpData[i]; }
+
+    void reserve(size_t n)
+    {
+        if (n <= mnCapacity)
+            return;
+        const size_t nCapacity = std::max(n, 2 * mnCapacity);
+        T* pData = new T[nCapacity];
+        std::copy(begin(), end(), pData);
+        if (mpData != mInline)
+            delete[] mpData;
+        mpData = pData;
+        mnCapacity = nCapacity;
+    }
+
+    void push_back(const T& x)
+    {
+        if (mnSize == mnCapacity) {
+            // x may be an element of this vector
+            const T y = x;
+            reserve(mnSize + 1);
+            mpData[mnSize++] = y;
+        } else
+            mpData[mnSize++] = x;
+    }
+
+    // Keeps the order of the remaining elements
+    iterator erase(iterator it)
+    {
+        std::copy(it + 1, end(), it);
+        mnSize--;
+        return it;
+    }
+
+    // Keeps the heap buffer, if any
+    void clear() { mnSize = 0; }
+
+private:
+    T mInline[N];
+    T* mpData;
+    size_t mnSize;
+    size_t mnCapacity;
+};
+
+}  // namespace ORB_SLAM2
+
+#endif  // _SMALL_VECTOR_H_
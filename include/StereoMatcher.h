@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#ifndef _STEREO_MATCHER_H_
+#define _STEREO_MATCHER_H_
+
+#include <stddef.h>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d/features2d.hpp>
+
+namespace ORB_SLAM2 {
+
+// 右图特征点按行分桶的索引 (CSR格式)。
+// 原来每帧构造 nRows 个 vector<size_t> 并 reserve(200)，这里只用两个连续数组：
+// mvRowStart[y]..mvRowStart[y+1] 为第y行的候选点在 mvItems 中的范围。
+class StereoRowIndex {
+public:
+    // 可直接传给 HammingMatcher::SearchBest 的候选点区间
+    struct Bucket {
+        typedef const size_t* const_iterator;
+        const size_t* b;
+        const size_t* e;
+        const_iterator begin() const { return b; }
+        const_iterator end() const { return e; }
+        bool empty() const { return b == e; }
+        size_t size() const { return e - b; }
+    };
+
+    // Each right keypoint is registered in rows [y-2*scale, y+2*scale]
+    void Build(const std::vector<cv::KeyPoint>& vKeysRight, const std::vector<float>& vScaleFactors, int nRows);
+
+    inline Bucket Row(int y) const
+    {
+        Bucket bucket = {NULL, NULL};
+        if (y < 0 || y >= mnRows)
+            return bucket;
+        bucket.b = mvItems.data() + mvRowStart[y];
+        bucket.e = mvItems.data() + mvRowStart[y + 1];
+        return bucket;
+    }
+
+private:
+    int mnRows = 0;
+    std::vector<int> mvRowStart;
+    std::vector<size_t> mvItems;
+};
+
+// 亚像素立体匹配中的SAD滑窗搜索
+class StereoPatchMatcher {
+public:
+    static const int W = 5;  // 11x11 patch
+    static const int L = 5;  // search range [-L, L]
+
+    // Computes vDists[L+incR] for incR in [-L,L]:
+    //   sum |(IL - IL(center)) - (IR - IR(center))| over the 11x11 patch
+    // with the left patch centered at (uL,vL) and the right one at (uR0+incR,vL).
+    // imL/imR are 8-bit pyramid images at the keypoint level. Returns false
+    // if the search strip is out of the image.
+    static bool SearchRow(const cv::Mat& imL, const cv::Mat& imR, int uL, int vL, int uR0, float* vDists);
+};
+
+}  // namespace ORB_SLAM2
+
+#endif  // _STEREO_MATCHER_H_
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ORB_SLAM2 {
+
+// 全进程共用的常驻工作线程池, 线程在第一次使用时创建, 之后一直保留,
+// 不再每次并行循环都创建和回收线程。
+// ParallelFor 把 [0,n) 分成连续的块, 调用线程自己也执行块, 所以在任务中
+// 嵌套调用 ParallelFor, 或者多个线程同时调用, 都不会死锁。
+// 每个下标由哪个线程执行是不确定的, 调用者应按下标保存结果, 再按顺序合并。
+class ThreadPool {
+public:
+    // Runs f(i) for i in [0,n), split in at most nThreads contiguous chunks.
+    // Returns once every f(i) has returned.
+    template <class Function>
+    static void ParallelFor(int n, int nThreads, Function f)
+    {
+        if (n <= 0)
+            return;
+        if (std::min(nThreads, n) <= 1) {
+            for (int i = 0; i < n; i++)
+                f(i);
+            return;
+        }
+
+        const std::function<void(int, int)> range = [&f](int iBegin, int iEnd) {
+            for (int i = iBegin; i < iEnd; i++)
+                f(i);
+        };
+        Instance().Run(n, nThreads, range);
+    }
+
+    // Worker threads plus the calling thread
+    static int NumThreads() { return Instance().mnThreads; }
+
+private:
+    // One ParallelFor call, lives on the stack of the caller. All the
+    // counters are guarded by mMutex.
+    struct Job {
+        const std::function<void(int, int)>* pRange;
+        int n;
+        int nChunk;   // indices per chunk
+        int nChunks;
+        int nNext;    // next chunk to claim
+        int nDone;    // finished chunks
+    };
+
+    static ThreadPool& Instance();
+
+    ThreadPool();
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    void Run(int n, int nThreads, const std::function<void(int, int)>& range);
+
+    // Claims the next chunk of job and runs it with the lock released
+    void RunChunk(Job& job, std::unique_lock<std::mutex>& lock);
+
+    void Worker();
+
+    int mnThreads;
+    std::vector<std::thread> mvWorkers;
+
+    // Jobs with chunks left to claim
+    std::deque<Job*> mqJobs;
+    std::mutex mMutex;
+    std::condition_variable mCondJobs;
+    std::condition_variable mCondDone;
+};
+
+}  // namespace ORB_SLAM2
+
+#endif  // _THREAD_POOL_H_
@@ -25,6 +25,7 @@
 #include "ORBextractor.h"
 #include "Initializer.h"
 #include "MapDrawer.h"
+#include "Relocalizer.h"
 #include "System.h"
 //#include "Geometry.h"
 
@@ -192,10 +193,17 @@ protected:
     // Initalization (only for monocular)
     Initializer* mpInitializer;
 
+    // Parallel PnP RANSAC over the relocalization candidates
+    Relocalizer mRelocalizer;
+
     //Local Map
     KeyFrame* mpReferenceKF;
     std::vector<KeyFrame*> mvpLocalKeyFrames;
     std::vector<MapPoint*> mvpLocalMapPoints;
+    // Local map points tested against the frustum in SearchLocalPoints (buffer reused between frames)
+    std::vector<MapPoint*> mvpFrustumCandidates;
+    // Scratch of Frame::isInFrustum for those candidates
+    std::vector<float> mvFrustumBuffer;
     
     // System
     System* mpSystem;
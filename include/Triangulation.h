@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#ifndef _TRIANGULATION_H_
+#define _TRIANGULATION_H_
+
+#include <Eigen/Core>
+#include <Eigen/SVD>
+
+namespace ORB_SLAM2 {
+
+// 两视图三角化的定长内核 (Initializer::CheckRT, LocalMapping::CreateNewMapPoints)。
+// 全部使用 Eigen 定长矩阵, 每个匹配点不在堆上分配内存, 替代原来每个匹配构造
+// 4x4 cv::Mat 再调用 cv::SVD::compute 的做法。
+class Triangulation {
+public:
+    typedef Eigen::Matrix<float, 3, 4> Matrix34f;
+
+    // Linear (DLT) triangulation of (x1,y1) seen by P1 and (x2,y2) seen by P2, as
+    // Initializer::Triangulate. The coordinates are pixels for P = K[R|t] or normalized
+    // for P = [R|t]. Returns false for a point at infinity.
+    static inline bool DLT(const Matrix34f& P1, float x1, float y1, const Matrix34f& P2, float x2, float y2,
+                           Eigen::Vector3f& x3D)
+    {
+        Eigen::Matrix4f A;
+        A.row(0) = x1 * P1.row(2) - P1.row(0);
+        A.row(1) = y1 * P1.row(2) - P1.row(1);
+        A.row(2) = x2 * P2.row(2) - P2.row(0);
+        A.row(3) = y2 * P2.row(2) - P2.row(1);
+
+        // null vector of A: right singular vector of the smallest singular value
+        const Eigen::JacobiSVD<Eigen::Matrix4f> svd(A, Eigen::ComputeFullV);
+        const Eigen::Vector4f x3Dh = svd.matrixV().col(3);
+        if (x3Dh(3) == 0)
+            return false;
+
+        x3D = x3Dh.head<3>() / x3Dh(3);
+        return true;
+    }
+
+    // Squared reprojection error of the camera point x3Dc on pixel (u,v)
+    static inline float ReprojectionError2(const Eigen::Vector3f& x3Dc, float fx, float fy, float cx, float cy,
+                                           float u, float v)
+    {
+        const float invz = 1.0f / x3Dc(2);
+        const float du = fx * x3Dc(0) * invz + cx - u;
+        const float dv = fy * x3Dc(1) * invz + cy - v;
+        return du * du + dv * dv;
+    }
+};
+
+}  // namespace ORB_SLAM2
+
+#endif  // _TRIANGULATION_H_
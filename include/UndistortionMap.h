@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#ifndef _UNDISTORTION_MAP_H_
+#define _UNDISTORTION_MAP_H_
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d/features2d.hpp>
+
+namespace ORB_SLAM2 {
+
+// 畸变 -> 去畸变 的查找表。
+// 标定参数改变后只在第一帧调用一次 cv::undistortPoints (对每个整数像素)，
+// 之后每帧的特征点去畸变只需要双线性插值，不再每帧迭代求解。
+class UndistortionMap {
+public:
+    UndistortionMap();
+
+    // Build the table for an image of cols x rows pixels. The grid covers
+    // [0,cols]x[0,rows] so that the image corners can be looked up too.
+    void Build(const cv::Mat& K, const cv::Mat& DistCoef, int cols, int rows);
+
+    bool IsValid() const { return !mvMap.empty(); }
+
+    // Undistort n points given as interleaved (x,y) pairs, in and out may alias
+    void UndistortPoints(const float* xy, int n, float* xyUn) const;
+
+    // Batch undistortion straight into vKeysUn (octave, angle, ... are copied from vKeys)
+    void UndistortKeyPoints(const std::vector<cv::KeyPoint>& vKeys, std::vector<cv::KeyPoint>& vKeysUn) const;
+
+private:
+    inline bool Lookup(float x, float y, float& xu, float& yu) const;
+
+    // slow path for points outside the table
+    void UndistortExact(float x, float y, float& xu, float& yu) const;
+
+    cv::Mat mK;
+    cv::Mat mDistCoef;
+
+    int mnCols;  // grid size is (mnCols+1) x (mnRows+1)
+    int mnRows;
+    std::vector<float> mvMap;  // interleaved undistorted (x,y), row major
+};
+
+}  // namespace ORB_SLAM2
+
+#endif  // _UNDISTORTION_MAP_H_
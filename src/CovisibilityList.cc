@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#include "CovisibilityList.h"
+
+#include <algorithm>
+
+namespace ORB_SLAM2 {
+
+static bool EdgeLess(const CovisibilityList::Edge& e, KeyFrame* pKF)
+{
+    return e.first < pKF;
+}
+
+CovisibilityList::CovisibilityList() : mnMinOrderedWeight(0), mbDirty(false)
+{
+}
+
+std::vector<CovisibilityList::Edge>::iterator CovisibilityList::Find(KeyFrame* pKF)
+{
+    return std::lower_bound(mvEdges.begin(), mvEdges.end(), pKF, EdgeLess);
+}
+
+std::vector<CovisibilityList::Edge>::const_iterator CovisibilityList::Find(KeyFrame* pKF) const
+{
+    return std::lower_bound(mvEdges.begin(), mvEdges.end(), pKF, EdgeLess);
+}
+
+bool CovisibilityList::Set(KeyFrame* pKF, int weight)
+{
+    std::vector<Edge>::iterator it = Find(pKF);
+    if (it != mvEdges.end() && it->first == pKF) {
+        if (it->second == weight)
+            return false;
+        it->second = weight;
+    } else
+        mvEdges.insert(it, Edge(pKF, weight));
+
+    mnMinOrderedWeight = 0;
+    mbDirty = true;
+    return true;
+}
+
+bool CovisibilityList::Erase(KeyFrame* pKF)
+{
+    std::vector<Edge>::iterator it = Find(pKF);
+    if (it == mvEdges.end() || it->first != pKF)
+        return false;
+
+    mvEdges.erase(it);
+    mnMinOrderedWeight = 0;
+    mbDirty = true;
+    return true;
+}
+
+void CovisibilityList::Assign(std::vector<Edge>& vEdges, int nMinOrderedWeight)
+{
+    mvEdges.swap(vEdges);
+    mnMinOrderedWeight = nMinOrderedWeight;
+    mbDirty = true;
+}
+
+void CovisibilityList::Clear()
+{
+    mvEdges.clear();
+    mnMinOrderedWeight = 0;
+    mbDirty = true;
+}
+
+int CovisibilityList::Weight(KeyFrame* pKF) const
+{
+    std::vector<Edge>::const_iterator it = Find(pKF);
+    if (it != mvEdges.end() && it->first == pKF)
+        return it->second;
+    else
+        return 0;
+}
+
+const std::vector<KeyFrame*>& CovisibilityList::Ordered()
+{
+    if (mbDirty)
+        Materialize();
+    return mvpOrdered;
+}
+
+const std::vector<int>& CovisibilityList::OrderedWeights()
+{
+    if (mbDirty)
+        Materialize();
+    return mvOrderedWeights;
+}
+
+void CovisibilityList::Materialize()
+{
+    mvPairs.clear();
+    int nmax = 0;
+    KeyFrame* pKFmax = NULL;
+    for (size_t i = 0; i < mvEdges.size(); i++) {
+        if (mvEdges[i].second > nmax) {
+            nmax = mvEdges[i].second;
+            pKFmax = mvEdges[i].first;
+        }
+        if (mvEdges[i].second >= mnMinOrderedWeight)
+            mvPairs.push_back(std::make_pair(mvEdges[i].second, mvEdges[i].first));
+    }
+    if (mvPairs.empty() && pKFmax)
+        mvPairs.push_back(std::make_pair(nmax, pKFmax));
+
+    // decreasing (weight, pointer), as the sorted lists of ORB-SLAM2
+    std::sort(mvPairs.begin(), mvPairs.end());
+    mvpOrdered.resize(mvPairs.size());
+    mvOrderedWeights.resize(mvPairs.size());
+    for (size_t i = 0, n = mvPairs.size(); i < n; i++) {
+        mvpOrdered[i] = mvPairs[n - 1 - i].second;
+        mvOrderedWeights[i] = mvPairs[n - 1 - i].first;
+    }
+
+    mbDirty = false;
+}
+
+}  // namespace ORB_SLAM2
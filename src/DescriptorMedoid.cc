@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#include "DescriptorMedoid.h"
+#include "HammingMatcher.h"
+
+#include <string.h>
+
+namespace ORB_SLAM2 {
+
+DescriptorMedoid::DescriptorMedoid() : mnObservations(0)
+{
+}
+
+void DescriptorMedoid::Offer(KeyFrame* pKF, size_t idx, const uint8_t* pDescriptor)
+{
+    mnObservations++;
+
+    Sample sample;
+    sample.pKF = pKF;
+    sample.idx = idx;
+    sample.nDistanceSum = 0;
+    memcpy(sample.desc, pDescriptor, DESC_BYTES);
+
+    if (mvSamples.size() < MAX_SAMPLES) {
+        Add(sample);
+        return;
+    }
+
+    const size_t r = mRng() % mnObservations;
+    if (r < mvSamples.size())
+        Replace(r, sample);
+}
+
+void DescriptorMedoid::Erase(KeyFrame* pKF, size_t idx)
+{
+    if (mnObservations > 0)
+        mnObservations--;
+
+    for (size_t i = 0; i < mvSamples.size(); i++) {
+        if (mvSamples[i].pKF == pKF && mvSamples[i].idx == idx) {
+            Remove(i);
+            return;
+        }
+    }
+}
+
+void DescriptorMedoid::Clear()
+{
+    mvSamples.clear();
+    mnObservations = 0;
+}
+
+int DescriptorMedoid::Best() const
+{
+    int nBestIdx = -1;
+    int nBestSum = 0;
+    for (size_t i = 0; i < mvSamples.size(); i++) {
+        if (nBestIdx < 0 || mvSamples[i].nDistanceSum < nBestSum) {
+            nBestSum = mvSamples[i].nDistanceSum;
+            nBestIdx = i;
+        }
+    }
+    return nBestIdx;
+}
+
+void DescriptorMedoid::Add(const Sample& sample)
+{
+    mvSamples.push_back(sample);
+    Sample& added = mvSamples.back();
+    for (size_t i = 0; i + 1 < mvSamples.size(); i++) {
+        const int dist = HammingMatcher::Distance(mvSamples[i].desc, added.desc);
+        mvSamples[i].nDistanceSum += dist;
+        added.nDistanceSum += dist;
+    }
+}
+
+void DescriptorMedoid::Replace(size_t i, const Sample& sample)
+{
+    Sample& replaced = mvSamples[i];
+    int nDistanceSum = 0;
+    for (size_t j = 0; j < mvSamples.size(); j++) {
+        if (j == i)
+            continue;
+        const int dist = HammingMatcher::Distance(mvSamples[j].desc, sample.desc);
+        mvSamples[j].nDistanceSum += dist - HammingMatcher::Distance(mvSamples[j].desc, replaced.desc);
+        nDistanceSum += dist;
+    }
+
+    replaced = sample;
+    replaced.nDistanceSum = nDistanceSum;
+}
+
+void DescriptorMedoid::Remove(size_t i)
+{
+    for (size_t j = 0; j < mvSamples.size(); j++)
+        if (j != i)
+            mvSamples[j].nDistanceSum -= HammingMatcher::Distance(mvSamples[i].desc, mvSamples[j].desc);
+
+    mvSamples[i] = mvSamples.back();
+    mvSamples.pop_back();
+}
+
+}  // namespace ORB_SLAM2
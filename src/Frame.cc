@@ -10,6 +10,10 @@
 #include "Frame.h"
 #include "Converter.h"
 #include "ORBmatcher.h"
+#include "HammingMatcher.h"
+#include "StereoMatcher.h"
+#include "MapPointStore.h"
+#include "ThreadPool.h"
 #include <thread>
 
 #include "Semantic.h"
@@ -22,6 +26,7 @@ bool Frame::mbInitialComputations=true;
 float Frame::cx, Frame::cy, Frame::fx, Frame::fy, Frame::invfx, Frame::invfy;
 float Frame::mnMinX, Frame::mnMinY, Frame::mnMaxX, Frame::mnMaxY;
 float Frame::mfGridElementWidthInv, Frame::mfGridElementHeightInv;
+UndistortionMap Frame::mUndistortionMap;
 
 Frame::Frame()
 {}
@@ -438,6 +443,84 @@ bool Frame::isInFrustum(MapPoint *pMP, float viewingCosLimit)
     return true;
 }
 
+int Frame::isInFrustum(const vector<MapPoint*> &vpMPs, float viewingCosLimit, vector<float> &vBuffer)
+{
+    const int n = vpMPs.size();
+    if(n==0)
+        return 0;
+
+    // Gather the point data into SoA buffers
+    if(vBuffer.size()<9*static_cast<size_t>(n))
+        vBuffer.resize(9*n);
+    float* X = &vBuffer[0];
+    float* Y = X+n;
+    float* Z = Y+n;
+    float* Nx = Z+n;
+    float* Ny = Nx+n;
+    float* Nz = Ny+n;
+    float* MinDist = Nz+n;
+    float* MaxDist = MinDist+n;
+    float* InView = MaxDist+n;
+
+    const MapPointStore& store = MapPointStore::Instance();
+    for(int i=0; i<n; i++)
+    {
+        float P[3], N[3];
+        store.GetGeometry(vpMPs[i]->mnHandle,P,N,MinDist[i],MaxDist[i]);
+        X[i] = P[0]; Y[i] = P[1]; Z[i] = P[2];
+        Nx[i] = N[0]; Ny[i] = N[1]; Nz[i] = N[2];
+    }
+
+    // Projection and culling, same tests as isInFrustum(MapPoint*,float).
+    // Results overwrite the gathered data: X:u, Y:v, Z:1/z, Nx:distance, Ny:viewing cos,
+    // InView is 1 for the points that pass all the tests
+    const float r00 = mRcw.at<float>(0,0), r01 = mRcw.at<float>(0,1), r02 = mRcw.at<float>(0,2);
+    const float r10 = mRcw.at<float>(1,0), r11 = mRcw.at<float>(1,1), r12 = mRcw.at<float>(1,2);
+    const float r20 = mRcw.at<float>(2,0), r21 = mRcw.at<float>(2,1), r22 = mRcw.at<float>(2,2);
+    const float t0 = mtcw.at<float>(0), t1 = mtcw.at<float>(1), t2 = mtcw.at<float>(2);
+    const float ox = mOw.at<float>(0), oy = mOw.at<float>(1), oz = mOw.at<float>(2);
+    for(int i=0; i<n; i++)
+    {
+        const float PcX = r00*X[i]+r01*Y[i]+r02*Z[i]+t0;
+        const float PcY = r10*X[i]+r11*Y[i]+r12*Z[i]+t1;
+        const float PcZ = r20*X[i]+r21*Y[i]+r22*Z[i]+t2;
+        const float invz = 1.0f/PcZ;
+        const float u = fx*PcX*invz+cx;
+        const float v = fy*PcY*invz+cy;
+
+        const float POx = X[i]-ox, POy = Y[i]-oy, POz = Z[i]-oz;
+        const float dist = sqrtf(POx*POx+POy*POy+POz*POz);
+        const float viewCos = (POx*Nx[i]+POy*Ny[i]+POz*Nz[i])/dist;
+
+        InView[i] = !(PcZ<0.0f) && !(u<mnMinX || u>mnMaxX) && !(v<mnMinY || v>mnMaxY) &&
+                    !(dist<0.8f*MinDist[i] || dist>1.2f*MaxDist[i]) && !(viewCos<viewingCosLimit) ? 1.0f : 0.0f;
+        X[i] = u;
+        Y[i] = v;
+        Z[i] = invz;
+        Nx[i] = dist;
+        Ny[i] = viewCos;
+    }
+
+    // Scatter the results to the points in view
+    int nInView = 0;
+    for(int i=0; i<n; i++)
+    {
+        MapPoint* pMP = vpMPs[i];
+        pMP->mbTrackInView = InView[i]!=0.0f;
+        if(!pMP->mbTrackInView)
+            continue;
+
+        pMP->mTrackProjX = X[i];
+        pMP->mTrackProjXR = X[i] - mbf*Z[i];
+        pMP->mTrackProjY = Y[i];
+        pMP->mnTrackScaleLevel = MapPointStore::PredictScale(MaxDist[i],Nx[i],mfLogScaleFactor,mnScaleLevels);
+        pMP->mTrackViewCos = Ny[i];
+        nInView++;
+    }
+
+    return nInView;
+}
+
 vector<size_t> Frame::GetFeaturesInArea(const float &x, const float  &y, const float  &r, const int minLevel, const int maxLevel) const
 {
     vector<size_t> vIndices;
@@ -510,8 +593,7 @@ void Frame::ComputeBoW()
 {
     if(mBowVec.empty())
     {
-        vector<cv::Mat> vCurrentDesc = Converter::toDescriptorVector(mDescriptors);
-        mpORBvocabulary->transform(vCurrentDesc,mBowVec,mFeatVec,4);
+        mpORBvocabulary->transform(mDescriptors,mBowVec,mFeatVec,4);
     }
 }
 
@@ -523,49 +605,36 @@ void Frame::UndistortKeyPoints()
         return;
     }
 
-    // Fill matrix with points
-    cv::Mat mat(N,2,CV_32F);
-    for(int i=0; i<N; i++)
+    // The table is rebuilt on the first frame after a change of calibration
+    // (Tracking::ChangeCalibration sets mbInitialComputations)
+    if(mbInitialComputations || !mUndistortionMap.IsValid())
     {
-        mat.at<float>(i,0)=mvKeys[i].pt.x;
-        mat.at<float>(i,1)=mvKeys[i].pt.y;
+        const cv::Mat &im = mpORBextractorLeft->mvImagePyramid[0];
+        mUndistortionMap.Build(mK,mDistCoef,im.cols,im.rows);
     }
 
-    // Undistort points
-    mat=mat.reshape(2);
-    cv::undistortPoints(mat,mat,mK,mDistCoef,cv::Mat(),mK);
-    mat=mat.reshape(1);
-
     // Fill undistorted keypoint vector
-    mvKeysUn.resize(N);
-    for(int i=0; i<N; i++)
-    {
-        cv::KeyPoint kp = mvKeys[i];
-        kp.pt.x=mat.at<float>(i,0);
-        kp.pt.y=mat.at<float>(i,1);
-        mvKeysUn[i]=kp;
-    }
+    mUndistortionMap.UndistortKeyPoints(mvKeys,mvKeysUn);
 }
 
 void Frame::ComputeImageBounds(const cv::Mat &imLeft)
 {
     if(mDistCoef.at<float>(0)!=0.0)
     {
-        cv::Mat mat(4,2,CV_32F);
-        mat.at<float>(0,0)=0.0; mat.at<float>(0,1)=0.0;
-        mat.at<float>(1,0)=imLeft.cols; mat.at<float>(1,1)=0.0;
-        mat.at<float>(2,0)=0.0; mat.at<float>(2,1)=imLeft.rows;
-        mat.at<float>(3,0)=imLeft.cols; mat.at<float>(3,1)=imLeft.rows;
+        float corners[8] = {0.0f, 0.0f,
+                            (float)imLeft.cols, 0.0f,
+                            0.0f, (float)imLeft.rows,
+                            (float)imLeft.cols, (float)imLeft.rows};
 
         // Undistort corners
-        mat=mat.reshape(2);
-        cv::undistortPoints(mat,mat,mK,mDistCoef,cv::Mat(),mK);
-        mat=mat.reshape(1);
+        if(!mUndistortionMap.IsValid())
+            mUndistortionMap.Build(mK,mDistCoef,imLeft.cols,imLeft.rows);
+        mUndistortionMap.UndistortPoints(corners,4,corners);
 
-        mnMinX = min(mat.at<float>(0,0),mat.at<float>(2,0));
-        mnMaxX = max(mat.at<float>(1,0),mat.at<float>(3,0));
-        mnMinY = min(mat.at<float>(0,1),mat.at<float>(1,1));
-        mnMaxY = max(mat.at<float>(2,1),mat.at<float>(3,1));
+        mnMinX = min(corners[0],corners[4]);
+        mnMaxX = max(corners[2],corners[6]);
+        mnMinY = min(corners[1],corners[3]);
+        mnMaxY = max(corners[5],corners[7]);
 
     }
     else
@@ -582,47 +651,73 @@ void Frame::ComputeStereoMatches()
     mvuRight = vector<float>(N,-1.0f);
     mvDepth = vector<float>(N,-1.0f);
 
-    const int thOrbDist = (ORBmatcher::TH_HIGH+ORBmatcher::TH_LOW)/2;
-
     const int nRows = mpORBextractorLeft->mvImagePyramid[0].rows;
 
     //Assign keypoints to row table
-    vector<vector<size_t> > vRowIndices(nRows,vector<size_t>());
+    StereoRowIndex rowIndex;
+    rowIndex.Build(mvKeysRight,mvScaleFactors,nRows);
+
+    // For each left keypoint search a match in the right image.
+    // 每个左图特征点的匹配相互独立，按块分配到多个线程，各线程只写自己的 mvuRight/mvDepth
+    const int nMinPerThread = 256;
+    const int nThreads = max(1,min(ThreadPool::NumThreads(),N/nMinPerThread));
+    const int nChunk = (N+nThreads-1)/nThreads;
 
-    for(int i=0; i<nRows; i++)
-        vRowIndices[i].reserve(200);
+    vector<vector<pair<int, int> > > vvDistIdx(nThreads);
+    ThreadPool::ParallelFor(nThreads,nThreads,[&](int t)
+    {
+        const int iBegin = t*nChunk;
+        const int iEnd = min(N,iBegin+nChunk);
+        ComputeStereoMatchesRange(iBegin,iEnd,rowIndex,vvDistIdx[t]);
+    });
+
+    vector<pair<int, int> > vDistIdx;
+    vDistIdx.reserve(N);
+    for(int t=0; t<nThreads; t++)
+        vDistIdx.insert(vDistIdx.end(),vvDistIdx[t].begin(),vvDistIdx[t].end());
 
-    const int Nr = mvKeysRight.size();
+    if(vDistIdx.empty())
+        return;
 
-    for(int iR=0; iR<Nr; iR++)
+    sort(vDistIdx.begin(),vDistIdx.end());
+    const float median = vDistIdx[vDistIdx.size()/2].first;
+    const float thDist = 1.5f*1.4f*median;
+
+    for(int i=vDistIdx.size()-1;i>=0;i--)
     {
-        const cv::KeyPoint &kp = mvKeysRight[iR];
-        const float &kpY = kp.pt.y;
-        const float r = 2.0f*mvScaleFactors[mvKeysRight[iR].octave];
-        const int maxr = ceil(kpY+r);
-        const int minr = floor(kpY-r);
-
-        for(int yi=minr;yi<=maxr;yi++)
-            vRowIndices[yi].push_back(iR);
+        if(vDistIdx[i].first<thDist)
+            break;
+        else
+        {
+            mvuRight[vDistIdx[i].second]=-1;
+            mvDepth[vDistIdx[i].second]=-1;
+        }
     }
+}
+
+void Frame::ComputeStereoMatchesRange(const int iBegin, const int iEnd, const StereoRowIndex &rowIndex,
+                                      vector<pair<int, int> > &vDistIdx)
+{
+    const int thOrbDist = (ORBmatcher::TH_HIGH+ORBmatcher::TH_LOW)/2;
 
     // Set limits for search
     const float minZ = mb;
     const float minD = 0;
     const float maxD = mbf/minZ;
 
-    // For each left keypoint search a match in the right image
-    vector<pair<int, int> > vDistIdx;
-    vDistIdx.reserve(N);
+    const int L = StereoPatchMatcher::L;
+    float vDists[2*StereoPatchMatcher::L+1];
+
+    vDistIdx.reserve(iEnd-iBegin);
 
-    for(int iL=0; iL<N; iL++)
+    for(int iL=iBegin; iL<iEnd; iL++)
     {
         const cv::KeyPoint &kpL = mvKeys[iL];
         const int &levelL = kpL.octave;
         const float &vL = kpL.pt.y;
         const float &uL = kpL.pt.x;
 
-        const vector<size_t> &vCandidates = vRowIndices[vL];
+        const StereoRowIndex::Bucket vCandidates = rowIndex.Row(vL);
 
         if(vCandidates.empty())
             continue;
@@ -633,76 +728,47 @@ void Frame::ComputeStereoMatches()
         if(maxU<0)
             continue;
 
-        int bestDist = ORBmatcher::TH_HIGH;
-        size_t bestIdxR = 0;
-
         const cv::Mat &dL = mDescriptors.row(iL);
 
         // Compare descriptor to right keypoints
-        for(size_t iC=0; iC<vCandidates.size(); iC++)
-        {
-            const size_t iR = vCandidates[iC];
-            const cv::KeyPoint &kpR = mvKeysRight[iR];
-
-            if(kpR.octave<levelL-1 || kpR.octave>levelL+1)
-                continue;
+        const HammingMatcher::Result best = HammingMatcher::SearchBest(dL, mDescriptorsRight, vCandidates,
+            [&](size_t iR)
+            {
+                const cv::KeyPoint &kpR = mvKeysRight[iR];
 
-            const float &uR = kpR.pt.x;
+                if(kpR.octave<levelL-1 || kpR.octave>levelL+1)
+                    return false;
 
-            if(uR>=minU && uR<=maxU)
-            {
-                const cv::Mat &dR = mDescriptorsRight.row(iR);
-                const int dist = ORBmatcher::DescriptorDistance(dL,dR);
+                const float &uR = kpR.pt.x;
 
-                if(dist<bestDist)
-                {
-                    bestDist = dist;
-                    bestIdxR = iR;
-                }
-            }
-        }
+                return uR>=minU && uR<=maxU;
+            }, ORBmatcher::TH_HIGH);
 
         // Subpixel match by correlation
-        if(bestDist<thOrbDist)
+        if(best.bestDist<thOrbDist)
         {
             // coordinates in image pyramid at keypoint scale
-            const float uR0 = mvKeysRight[bestIdxR].pt.x;
+            const float uR0 = mvKeysRight[best.bestIdx].pt.x;
             const float scaleFactor = mvInvScaleFactors[kpL.octave];
             const float scaleduL = round(kpL.pt.x*scaleFactor);
             const float scaledvL = round(kpL.pt.y*scaleFactor);
             const float scaleduR0 = round(uR0*scaleFactor);
 
-            // sliding window search
-            const int w = 5;
-            cv::Mat IL = mpORBextractorLeft->mvImagePyramid[kpL.octave].rowRange(scaledvL-w,scaledvL+w+1).colRange(scaleduL-w,scaleduL+w+1);
-            IL.convertTo(IL,CV_32F);
-            IL = IL - IL.at<float>(w,w) *cv::Mat::ones(IL.rows,IL.cols,CV_32F);
-
-            int bestDist = INT_MAX;
-            int bestincR = 0;
-            const int L = 5;
-            vector<float> vDists;
-            vDists.resize(2*L+1);
-
-            const float iniu = scaleduR0+L-w;
-            const float endu = scaleduR0+L+w+1;
-            if(iniu<0 || endu >= mpORBextractorRight->mvImagePyramid[kpL.octave].cols)
+            // sliding window search, SAD over 11x11 patches on the raw pyramid pixels
+            if(!StereoPatchMatcher::SearchRow(mpORBextractorLeft->mvImagePyramid[kpL.octave],
+                                              mpORBextractorRight->mvImagePyramid[kpL.octave],
+                                              scaleduL,scaledvL,scaleduR0,vDists))
                 continue;
 
+            float bestDist = INT_MAX;
+            int bestincR = 0;
             for(int incR=-L; incR<=+L; incR++)
             {
-                cv::Mat IR = mpORBextractorRight->mvImagePyramid[kpL.octave].rowRange(scaledvL-w,scaledvL+w+1).colRange(scaleduR0+incR-w,scaleduR0+incR+w+1);
-                IR.convertTo(IR,CV_32F);
-                IR = IR - IR.at<float>(w,w) *cv::Mat::ones(IR.rows,IR.cols,CV_32F);
-
-                float dist = cv::norm(IL,IR,cv::NORM_L1);
-                if(dist<bestDist)
+                if(vDists[L+incR]<bestDist)
                 {
-                    bestDist =  dist;
+                    bestDist = vDists[L+incR];
                     bestincR = incR;
                 }
-
-                vDists[L+incR] = dist;
             }
 
             if(bestincR==-L || bestincR==L)
@@ -736,21 +802,6 @@ void Frame::ComputeStereoMatches()
             }
         }
     }
-
-    sort(vDistIdx.begin(),vDistIdx.end());
-    const float median = vDistIdx[vDistIdx.size()/2].first;
-    const float thDist = 1.5f*1.4f*median;
-
-    for(int i=vDistIdx.size()-1;i>=0;i--)
-    {
-        if(vDistIdx[i].first<thDist)
-            break;
-        else
-        {
-            mvuRight[vDistIdx[i].second]=-1;
-            mvDepth[vDistIdx[i].second]=-1;
-        }
-    }
 }
 
 
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#include "HammingMatcher.h"
+
+namespace ORB_SLAM2 {
+
+#if defined(__AVX2__)
+// popcount of a 256-bit register: nibble lookup with vpshufb, then vpsadbw
+// sums the byte counts into four 64-bit lanes
+static inline int PopCount256(const __m256i v)
+{
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+
+    const __m256i lo = _mm256_and_si256(v, low_mask);
+    const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+    const __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+    const __m256i sad = _mm256_sad_epu8(cnt, _mm256_setzero_si256());
+
+    const __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(sad), _mm256_extracti128_si256(sad, 1));
+    return static_cast<int>(_mm_cvtsi128_si64(sum) + _mm_extract_epi64(sum, 1));
+}
+#endif
+
+void HammingMatcher::Distances(const uint8_t* query, const cv::Mat& descs,
+                               const size_t* indices, size_t n, int* dists)
+{
+    const uint8_t* base = descs.data;
+    const size_t step = descs.step[0];
+
+#if defined(__AVX2__)
+    const __m256i q = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(query));
+    for (size_t k = 0; k < n; k++) {
+        const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(base + indices[k] * step));
+        dists[k] = PopCount256(_mm256_xor_si256(q, d));
+    }
+#else
+    for (size_t k = 0; k < n; k++)
+        dists[k] = Distance(query, base + indices[k] * step);
+#endif
+}
+
+void HammingMatcher::Distances(const uint8_t* query, const cv::Mat& descs, int* dists)
+{
+    const uint8_t* base = descs.data;
+    const size_t step = descs.step[0];
+    const int n = descs.rows;
+
+#if defined(__AVX2__)
+    const __m256i q = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(query));
+    for (int k = 0; k < n; k++) {
+        const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(base + k * step));
+        dists[k] = PopCount256(_mm256_xor_si256(q, d));
+    }
+#else
+    for (int k = 0; k < n; k++)
+        dists[k] = Distance(query, base + k * step);
+#endif
+}
+
+}  // namespace ORB_SLAM2
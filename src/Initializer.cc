@@ -20,12 +20,14 @@
 
 #include "Initializer.h"
 
-#include "Thirdparty/DBoW2/DUtils/Random.h"
 
 #include "Optimizer.h"
 #include "ORBmatcher.h"
+#include "Ransac.h"
+#include "ThreadPool.h"
 
 #include<thread>
+#include<limits>
 
 namespace ORB_SLAM2
 {
@@ -64,36 +66,31 @@ bool Initializer::Initialize(const Frame &CurrentFrame, const vector<int> &vMatc
 
     const int N = mvMatches12.size();
 
-    // Indices for minimum set selection
-    vector<size_t> vAllIndices;
-    vAllIndices.reserve(N);
-    vector<size_t> vAvailableIndices;
-
+    // Matched keypoints (SoA) for the batched model scoring
+    mvU1.resize(N);
+    mvV1.resize(N);
+    mvU2.resize(N);
+    mvV2.resize(N);
     for(int i=0; i<N; i++)
     {
-        vAllIndices.push_back(i);
+        const cv::KeyPoint &kp1 = mvKeys1[mvMatches12[i].first];
+        const cv::KeyPoint &kp2 = mvKeys2[mvMatches12[i].second];
+        mvU1[i] = kp1.pt.x;
+        mvV1[i] = kp1.pt.y;
+        mvU2[i] = kp2.pt.x;
+        mvV2[i] = kp2.pt.y;
     }
 
     // Generate sets of 8 points for each RANSAC iteration
     mvSets = vector< vector<size_t> >(mMaxIterations,vector<size_t>(8,0));
 
-    DUtils::Random::SeedRandOnce(0);
-
+    Ransac::Sampler sampler;
+    sampler.Seed(0,0);
+    sampler.Reset(N);
     for(int it=0; it<mMaxIterations; it++)
     {
-        vAvailableIndices = vAllIndices;
-
         // Select a minimum set
-        for(size_t j=0; j<8; j++)
-        {
-            int randi = DUtils::Random::RandomInt(0,vAvailableIndices.size()-1);
-            int idx = vAvailableIndices[randi];
-
-            mvSets[it][j] = idx;
-
-            vAvailableIndices[randi] = vAvailableIndices.back();
-            vAvailableIndices.pop_back();
-        }
+        sampler.Sample(8,mvSets[it].data());
     }
 
     // Launch threads to compute in parallel a fundamental matrix and a homography
@@ -133,40 +130,65 @@ void Initializer::FindHomography(vector<bool> &vbMatchesInliers, float &score, c
     Normalize(mvKeys2,vPn2, T2);
     cv::Mat T2inv = T2.inv();
 
-    // Best Results variables
-    score = 0.0;
-    vbMatchesInliers = vector<bool>(N,false);
+    // Hypotheses are evaluated in contiguous batches, one per thread. The
+    // homography and the fundamental matrix run at the same time, so each
+    // takes half of the cores.
+    const int nBatches = max(1,min(mMaxIterations,ThreadPool::NumThreads()/2));
+    const int nPerBatch = (mMaxIterations+nBatches-1)/nBatches;
 
-    // Iteration variables
-    vector<cv::Point2f> vPn1i(8);
-    vector<cv::Point2f> vPn2i(8);
-    cv::Mat H21i, H12i;
-    vector<bool> vbCurrentInliers(N,false);
-    float currentScore;
+    vector<float> vBestScores(nBatches,0.0f);
+    vector<cv::Mat> vBestH21(nBatches);
+    vector<vector<unsigned char> > vvbBestInliers(nBatches,vector<unsigned char>(N,0));
 
-    // Perform all RANSAC iterations and save the solution with highest score
-    for(int it=0; it<mMaxIterations; it++)
+    ThreadPool::ParallelFor(nBatches,nBatches,[&](int b)
     {
-        // Select a minimum set
-        for(size_t j=0; j<8; j++)
-        {
-            int idx = mvSets[it][j];
+        // Iteration variables
+        vector<cv::Point2f> vPn1i(8);
+        vector<cv::Point2f> vPn2i(8);
+        cv::Mat H21i, H12i;
+        vector<unsigned char> vbCurrentInliers(N,0);
 
-            vPn1i[j] = vPn1[mvMatches12[idx].first];
-            vPn2i[j] = vPn2[mvMatches12[idx].second];
-        }
-
-        cv::Mat Hn = ComputeH21(vPn1i,vPn2i);
-        H21i = T2inv*Hn*T1;
-        H12i = H21i.inv();
+        float &bestScore = vBestScores[b];
 
-        currentScore = CheckHomography(H21i, H12i, vbCurrentInliers, mSigma);
+        // Perform the RANSAC iterations of this batch and save the solution with highest score
+        for(int it=b*nPerBatch, itend=min(mMaxIterations,(b+1)*nPerBatch); it<itend; it++)
+        {
+            // Select a minimum set
+            for(size_t j=0; j<8; j++)
+            {
+                int idx = mvSets[it][j];
+
+                vPn1i[j] = vPn1[mvMatches12[idx].first];
+                vPn2i[j] = vPn2[mvMatches12[idx].second];
+            }
+
+            cv::Mat Hn = ComputeH21(vPn1i,vPn2i);
+            H21i = T2inv*Hn*T1;
+            H12i = H21i.inv();
+
+            const float currentScore = Ransac::ScoreHomography(H21i.ptr<float>(), H12i.ptr<float>(),
+                                                               mvU1.data(), mvV1.data(), mvU2.data(), mvV2.data(), N,
+                                                               5.991, 1.0/mSigma2, bestScore, vbCurrentInliers.data());
+
+            if(currentScore>bestScore)
+            {
+                vBestH21[b] = H21i.clone();
+                vvbBestInliers[b].swap(vbCurrentInliers);
+                bestScore = currentScore;
+            }
+        }
+    });
 
-        if(currentScore>score)
+    // Best Results variables. Ties go to the earliest iteration, as in a serial run
+    score = 0.0;
+    vbMatchesInliers = vector<bool>(N,false);
+    for(int b=0; b<nBatches; b++)
+    {
+        if(vBestScores[b]>score)
         {
-            H21 = H21i.clone();
-            vbMatchesInliers = vbCurrentInliers;
-            score = currentScore;
+            score = vBestScores[b];
+            H21 = vBestH21[b];
+            vbMatchesInliers.assign(vvbBestInliers[b].begin(),vvbBestInliers[b].end());
         }
     }
 }
@@ -175,7 +197,7 @@ void Initializer::FindHomography(vector<bool> &vbMatchesInliers, float &score, c
 void Initializer::FindFundamental(vector<bool> &vbMatchesInliers, float &score, cv::Mat &F21)
 {
     // Number of putative matches
-    const int N = vbMatchesInliers.size();
+    const int N = mvMatches12.size();
 
     // Normalize coordinates
     vector<cv::Point2f> vPn1, vPn2;
@@ -184,40 +206,60 @@ void Initializer::FindFundamental(vector<bool> &vbMatchesInliers, float &score,
     Normalize(mvKeys2,vPn2, T2);
     cv::Mat T2t = T2.t();
 
-    // Best Results variables
-    score = 0.0;
-    vbMatchesInliers = vector<bool>(N,false);
+    const int nBatches = max(1,min(mMaxIterations,ThreadPool::NumThreads()/2));
+    const int nPerBatch = (mMaxIterations+nBatches-1)/nBatches;
 
-    // Iteration variables
-    vector<cv::Point2f> vPn1i(8);
-    vector<cv::Point2f> vPn2i(8);
-    cv::Mat F21i;
-    vector<bool> vbCurrentInliers(N,false);
-    float currentScore;
+    vector<float> vBestScores(nBatches,0.0f);
+    vector<cv::Mat> vBestF21(nBatches);
+    vector<vector<unsigned char> > vvbBestInliers(nBatches,vector<unsigned char>(N,0));
 
-    // Perform all RANSAC iterations and save the solution with highest score
-    for(int it=0; it<mMaxIterations; it++)
+    ThreadPool::ParallelFor(nBatches,nBatches,[&](int b)
     {
-        // Select a minimum set
-        for(int j=0; j<8; j++)
+        // Iteration variables
+        vector<cv::Point2f> vPn1i(8);
+        vector<cv::Point2f> vPn2i(8);
+        cv::Mat F21i;
+        vector<unsigned char> vbCurrentInliers(N,0);
+
+        float &bestScore = vBestScores[b];
+
+        for(int it=b*nPerBatch, itend=min(mMaxIterations,(b+1)*nPerBatch); it<itend; it++)
         {
-            int idx = mvSets[it][j];
+            // Select a minimum set
+            for(int j=0; j<8; j++)
+            {
+                int idx = mvSets[it][j];
 
-            vPn1i[j] = vPn1[mvMatches12[idx].first];
-            vPn2i[j] = vPn2[mvMatches12[idx].second];
-        }
+                vPn1i[j] = vPn1[mvMatches12[idx].first];
+                vPn2i[j] = vPn2[mvMatches12[idx].second];
+            }
+
+            cv::Mat Fn = ComputeF21(vPn1i,vPn2i);
 
-        cv::Mat Fn = ComputeF21(vPn1i,vPn2i);
+            F21i = T2t*Fn*T1;
 
-        F21i = T2t*Fn*T1;
+            const float currentScore = Ransac::ScoreFundamental(F21i.ptr<float>(),
+                                                                mvU1.data(), mvV1.data(), mvU2.data(), mvV2.data(), N,
+                                                                3.841, 5.991, 1.0/mSigma2, bestScore, vbCurrentInliers.data());
 
-        currentScore = CheckFundamental(F21i, vbCurrentInliers, mSigma);
+            if(currentScore>bestScore)
+            {
+                vBestF21[b] = F21i.clone();
+                vvbBestInliers[b].swap(vbCurrentInliers);
+                bestScore = currentScore;
+            }
+        }
+    });
 
-        if(currentScore>score)
+    score = 0.0;
+    vbMatchesInliers = vector<bool>(N,false);
+    for(int b=0; b<nBatches; b++)
+    {
+        if(vBestScores[b]>score)
         {
-            F21 = F21i.clone();
-            vbMatchesInliers = vbCurrentInliers;
-            score = currentScore;
+            score = vBestScores[b];
+            F21 = vBestF21[b];
+            vbMatchesInliers.assign(vvbBestInliers[b].begin(),vvbBestInliers[b].end());
         }
     }
 }
@@ -302,171 +344,6 @@ cv::Mat Initializer::ComputeF21(const vector<cv::Point2f> &vP1,const vector<cv::
     return  u*cv::Mat::diag(w)*vt;
 }
 
-float Initializer::CheckHomography(const cv::Mat &H21, const cv::Mat &H12, vector<bool> &vbMatchesInliers, float sigma)
-{   
-    const int N = mvMatches12.size();
-
-    const float h11 = H21.at<float>(0,0);
-    const float h12 = H21.at<float>(0,1);
-    const float h13 = H21.at<float>(0,2);
-    const float h21 = H21.at<float>(1,0);
-    const float h22 = H21.at<float>(1,1);
-    const float h23 = H21.at<float>(1,2);
-    const float h31 = H21.at<float>(2,0);
-    const float h32 = H21.at<float>(2,1);
-    const float h33 = H21.at<float>(2,2);
-
-    const float h11inv = H12.at<float>(0,0);
-    const float h12inv = H12.at<float>(0,1);
-    const float h13inv = H12.at<float>(0,2);
-    const float h21inv = H12.at<float>(1,0);
-    const float h22inv = H12.at<float>(1,1);
-    const float h23inv = H12.at<float>(1,2);
-    const float h31inv = H12.at<float>(2,0);
-    const float h32inv = H12.at<float>(2,1);
-    const float h33inv = H12.at<float>(2,2);
-
-    vbMatchesInliers.resize(N);
-
-    float score = 0;
-
-    const float th = 5.991;
-
-    const float invSigmaSquare = 1.0/(sigma*sigma);
-
-    for(int i=0; i<N; i++)
-    {
-        bool bIn = true;
-
-        const cv::KeyPoint &kp1 = mvKeys1[mvMatches12[i].first];
-        const cv::KeyPoint &kp2 = mvKeys2[mvMatches12[i].second];
-
-        const float u1 = kp1.pt.x;
-        const float v1 = kp1.pt.y;
-        const float u2 = kp2.pt.x;
-        const float v2 = kp2.pt.y;
-
-        // Reprojection error in first image
-        // x2in1 = H12*x2
-
-        const float w2in1inv = 1.0/(h31inv*u2+h32inv*v2+h33inv);
-        const float u2in1 = (h11inv*u2+h12inv*v2+h13inv)*w2in1inv;
-        const float v2in1 = (h21inv*u2+h22inv*v2+h23inv)*w2in1inv;
-
-        const float squareDist1 = (u1-u2in1)*(u1-u2in1)+(v1-v2in1)*(v1-v2in1);
-
-        const float chiSquare1 = squareDist1*invSigmaSquare;
-
-        if(chiSquare1>th)
-            bIn = false;
-        else
-            score += th - chiSquare1;
-
-        // Reprojection error in second image
-        // x1in2 = H21*x1
-
-        const float w1in2inv = 1.0/(h31*u1+h32*v1+h33);
-        const float u1in2 = (h11*u1+h12*v1+h13)*w1in2inv;
-        const float v1in2 = (h21*u1+h22*v1+h23)*w1in2inv;
-
-        const float squareDist2 = (u2-u1in2)*(u2-u1in2)+(v2-v1in2)*(v2-v1in2);
-
-        const float chiSquare2 = squareDist2*invSigmaSquare;
-
-        if(chiSquare2>th)
-            bIn = false;
-        else
-            score += th - chiSquare2;
-
-        if(bIn)
-            vbMatchesInliers[i]=true;
-        else
-            vbMatchesInliers[i]=false;
-    }
-
-    return score;
-}
-
-float Initializer::CheckFundamental(const cv::Mat &F21, vector<bool> &vbMatchesInliers, float sigma)
-{
-    const int N = mvMatches12.size();
-
-    const float f11 = F21.at<float>(0,0);
-    const float f12 = F21.at<float>(0,1);
-    const float f13 = F21.at<float>(0,2);
-    const float f21 = F21.at<float>(1,0);
-    const float f22 = F21.at<float>(1,1);
-    const float f23 = F21.at<float>(1,2);
-    const float f31 = F21.at<float>(2,0);
-    const float f32 = F21.at<float>(2,1);
-    const float f33 = F21.at<float>(2,2);
-
-    vbMatchesInliers.resize(N);
-
-    float score = 0;
-
-    const float th = 3.841;
-    const float thScore = 5.991;
-
-    const float invSigmaSquare = 1.0/(sigma*sigma);
-
-    for(int i=0; i<N; i++)
-    {
-        bool bIn = true;
-
-        const cv::KeyPoint &kp1 = mvKeys1[mvMatches12[i].first];
-        const cv::KeyPoint &kp2 = mvKeys2[mvMatches12[i].second];
-
-        const float u1 = kp1.pt.x;
-        const float v1 = kp1.pt.y;
-        const float u2 = kp2.pt.x;
-        const float v2 = kp2.pt.y;
-
-        // Reprojection error in second image
-        // l2=F21x1=(a2,b2,c2)
-
-        const float a2 = f11*u1+f12*v1+f13;
-        const float b2 = f21*u1+f22*v1+f23;
-        const float c2 = f31*u1+f32*v1+f33;
-
-        const float num2 = a2*u2+b2*v2+c2;
-
-        const float squareDist1 = num2*num2/(a2*a2+b2*b2);
-
-        const float chiSquare1 = squareDist1*invSigmaSquare;
-
-        if(chiSquare1>th)
-            bIn = false;
-        else
-            score += thScore - chiSquare1;
-
-        // Reprojection error in second image
-        // l1 =x2tF21=(a1,b1,c1)
-
-        const float a1 = f11*u2+f21*v2+f31;
-        const float b1 = f12*u2+f22*v2+f32;
-        const float c1 = f13*u2+f23*v2+f33;
-
-        const float num1 = a1*u1+b1*v1+c1;
-
-        const float squareDist2 = num1*num1/(a1*a1+b1*b1);
-
-        const float chiSquare2 = squareDist2*invSigmaSquare;
-
-        if(chiSquare2>th)
-            bIn = false;
-        else
-            score += thScore - chiSquare2;
-
-        if(bIn)
-            vbMatchesInliers[i]=true;
-        else
-            vbMatchesInliers[i]=false;
-    }
-
-    return score;
-}
-
 bool Initializer::ReconstructF(vector<bool> &vbMatchesInliers, cv::Mat &F21, cv::Mat &K,
                             cv::Mat &R21, cv::Mat &t21, vector<cv::Point3f> &vP3D, vector<bool> &vbTriangulated, float minParallax, int minTriangulated)
 {
@@ -731,19 +608,11 @@ bool Initializer::ReconstructH(vector<bool> &vbMatchesInliers, cv::Mat &H21, cv:
     return false;
 }
 
-void Initializer::Triangulate(const cv::KeyPoint &kp1, const cv::KeyPoint &kp2, const cv::Mat &P1, const cv::Mat &P2, cv::Mat &x3D)
+void Initializer::Triangulate(const cv::KeyPoint &kp1, const cv::KeyPoint &kp2, const Triangulation::Matrix34f &P1,
+                              const Triangulation::Matrix34f &P2, Eigen::Vector3f &x3D)
 {
-    cv::Mat A(4,4,CV_32F);
-
-    A.row(0) = kp1.pt.x*P1.row(2)-P1.row(0);
-    A.row(1) = kp1.pt.y*P1.row(2)-P1.row(1);
-    A.row(2) = kp2.pt.x*P2.row(2)-P2.row(0);
-    A.row(3) = kp2.pt.y*P2.row(2)-P2.row(1);
-
-    cv::Mat u,w,vt;
-    cv::SVD::compute(A,w,u,vt,cv::SVD::MODIFY_A| cv::SVD::FULL_UV);
-    x3D = vt.row(3).t();
-    x3D = x3D.rowRange(0,3)/x3D.at<float>(3);
+    if(!Triangulation::DLT(P1,kp1.pt.x,kp1.pt.y,P2,kp2.pt.x,kp2.pt.y,x3D))
+        x3D.setConstant(std::numeric_limits<float>::infinity());
 }
 
 void Initializer::Normalize(const vector<cv::KeyPoint> &vKeys, vector<cv::Point2f> &vNormalizedPoints, cv::Mat &T)
@@ -811,19 +680,30 @@ int Initializer::CheckRT(const cv::Mat &R, const cv::Mat &t, const vector<cv::Ke
     vector<float> vCosParallax;
     vCosParallax.reserve(vKeys1.size());
 
+    Eigen::Matrix3f Ke, Re;
+    Eigen::Vector3f te;
+    for(int r=0; r<3; r++)
+    {
+        for(int c=0; c<3; c++)
+        {
+            Ke(r,c) = K.at<float>(r,c);
+            Re(r,c) = R.at<float>(r,c);
+        }
+        te(r) = t.at<float>(r);
+    }
+
     // Camera 1 Projection Matrix K[I|0]
-    cv::Mat P1(3,4,CV_32F,cv::Scalar(0));
-    K.copyTo(P1.rowRange(0,3).colRange(0,3));
+    Triangulation::Matrix34f P1 = Triangulation::Matrix34f::Zero();
+    P1.leftCols<3>() = Ke;
 
-    cv::Mat O1 = cv::Mat::zeros(3,1,CV_32F);
+    const Eigen::Vector3f O1 = Eigen::Vector3f::Zero();
 
     // Camera 2 Projection Matrix K[R|t]
-    cv::Mat P2(3,4,CV_32F);
-    R.copyTo(P2.rowRange(0,3).colRange(0,3));
-    t.copyTo(P2.rowRange(0,3).col(3));
-    P2 = K*P2;
+    Triangulation::Matrix34f P2;
+    P2.leftCols<3>() = Ke*Re;
+    P2.col(3) = Ke*te;
 
-    cv::Mat O2 = -R.t()*t;
+    const Eigen::Vector3f O2 = -Re.transpose()*te;
 
     int nGood=0;
 
@@ -834,59 +714,49 @@ int Initializer::CheckRT(const cv::Mat &R, const cv::Mat &t, const vector<cv::Ke
 
         const cv::KeyPoint &kp1 = vKeys1[vMatches12[i].first];
         const cv::KeyPoint &kp2 = vKeys2[vMatches12[i].second];
-        cv::Mat p3dC1;
+        Eigen::Vector3f p3dC1;
 
         Triangulate(kp1,kp2,P1,P2,p3dC1);
 
-        if(!isfinite(p3dC1.at<float>(0)) || !isfinite(p3dC1.at<float>(1)) || !isfinite(p3dC1.at<float>(2)))
+        if(!isfinite(p3dC1(0)) || !isfinite(p3dC1(1)) || !isfinite(p3dC1(2)))
         {
             vbGood[vMatches12[i].first]=false;
             continue;
         }
 
         // Check parallax
-        cv::Mat normal1 = p3dC1 - O1;
-        float dist1 = cv::norm(normal1);
+        const Eigen::Vector3f normal1 = p3dC1 - O1;
+        const float dist1 = normal1.norm();
 
-        cv::Mat normal2 = p3dC1 - O2;
-        float dist2 = cv::norm(normal2);
+        const Eigen::Vector3f normal2 = p3dC1 - O2;
+        const float dist2 = normal2.norm();
 
-        float cosParallax = normal1.dot(normal2)/(dist1*dist2);
+        const float cosParallax = normal1.dot(normal2)/(dist1*dist2);
 
         // Check depth in front of first camera (only if enough parallax, as "infinite" points can easily go to negative depth)
-        if(p3dC1.at<float>(2)<=0 && cosParallax<0.99998)
+        if(p3dC1(2)<=0 && cosParallax<0.99998)
             continue;
 
         // Check depth in front of second camera (only if enough parallax, as "infinite" points can easily go to negative depth)
-        cv::Mat p3dC2 = R*p3dC1+t;
+        const Eigen::Vector3f p3dC2 = Re*p3dC1+te;
 
-        if(p3dC2.at<float>(2)<=0 && cosParallax<0.99998)
+        if(p3dC2(2)<=0 && cosParallax<0.99998)
             continue;
 
         // Check reprojection error in first image
-        float im1x, im1y;
-        float invZ1 = 1.0/p3dC1.at<float>(2);
-        im1x = fx*p3dC1.at<float>(0)*invZ1+cx;
-        im1y = fy*p3dC1.at<float>(1)*invZ1+cy;
-
-        float squareError1 = (im1x-kp1.pt.x)*(im1x-kp1.pt.x)+(im1y-kp1.pt.y)*(im1y-kp1.pt.y);
+        const float squareError1 = Triangulation::ReprojectionError2(p3dC1,fx,fy,cx,cy,kp1.pt.x,kp1.pt.y);
 
         if(squareError1>th2)
             continue;
 
         // Check reprojection error in second image
-        float im2x, im2y;
-        float invZ2 = 1.0/p3dC2.at<float>(2);
-        im2x = fx*p3dC2.at<float>(0)*invZ2+cx;
-        im2y = fy*p3dC2.at<float>(1)*invZ2+cy;
-
-        float squareError2 = (im2x-kp2.pt.x)*(im2x-kp2.pt.x)+(im2y-kp2.pt.y)*(im2y-kp2.pt.y);
+        const float squareError2 = Triangulation::ReprojectionError2(p3dC2,fx,fy,cx,cy,kp2.pt.x,kp2.pt.y);
 
         if(squareError2>th2)
             continue;
 
         vCosParallax.push_back(cosParallax);
-        vP3D[vMatches12[i].first] = cv::Point3f(p3dC1.at<float>(0),p3dC1.at<float>(1),p3dC1.at<float>(2));
+        vP3D[vMatches12[i].first] = cv::Point3f(p3dC1(0),p3dC1(1),p3dC1(2));
         nGood++;
 
         if(cosParallax<0.99998)
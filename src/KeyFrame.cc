@@ -29,10 +29,6 @@ KeyFrame::KeyFrame(Frame &F, Map *pMap, KeyFrameDatabase *pKFDB)
     , mnFuseTargetForKF(0)
     , mnBALocalForKF(0)
     , mnBAFixedForKF(0)
-    , mnLoopQuery(0)
-    , mnLoopWords(0)
-    , mnRelocQuery(0)
-    , mnRelocWords(0)
     , mnBAGlobalForKF(0)
     , fx(F.fx)
     , fy(F.fy)
@@ -98,6 +94,7 @@ KeyFrame::KeyFrame(Frame &F, Map *pMap, KeyFrameDatabase *pKFDB)
 
 
     mnId = nNextId++;
+    mnHandle = ObjectPool<KeyFrame>::HandleOf(this);
 
     F.mbIsKeyFrame = true;   //是关键帧
 
@@ -116,10 +113,9 @@ void KeyFrame::ComputeBoW()
 {
     if(mBowVec.empty() || mFeatVec.empty())
     {
-        vector<cv::Mat> vCurrentDesc = Converter::toDescriptorVector(mDescriptors);
         // Feature vector associate features with nodes in the 4th level (from leaves up)
         // We assume the vocabulary tree has 6 levels, change the 4 otherwise
-        mpORBvocabulary->transform(vCurrentDesc,mBowVec,mFeatVec,4);
+        mpORBvocabulary->transform(mDescriptors,mBowVec,mFeatVec,4);
     }
 }
 
@@ -137,130 +133,185 @@ void KeyFrame::SetPose(const cv::Mat &Tcw_)
     Ow.copyTo(Twc.rowRange(0,3).col(3));
     cv::Mat center = (cv::Mat_<float>(4,1) << mHalfBaseline, 0 , 0, 1);
     Cw = Twc*center;
+
+    float pose[POSE_SIZE];
+    for(int i=0; i<3; i++)
+        for(int j=0; j<4; j++)
+            pose[POSE_TCW+4*i+j] = Tcw.at<float>(i,j);
+    for(int i=0; i<3; i++)
+    {
+        pose[POSE_OW+i] = Ow.at<float>(i);
+        pose[POSE_CW+i] = Cw.at<float>(i);
+    }
+    mSeqPose.BeginWrite();
+    SeqLock::Store(mPoseData,pose,POSE_SIZE);
+    mSeqPose.EndWrite();
+}
+
+void KeyFrame::LoadPose(float* pPose)
+{
+    unsigned int s;
+    do {
+        s = mSeqPose.BeginRead();
+        SeqLock::Load(mPoseData,pPose,POSE_SIZE);
+    } while(!mSeqPose.EndRead(s));
+}
+
+Eigen::Matrix4f KeyFrame::GetPoseEigen()
+{
+    float pose[POSE_SIZE];
+    LoadPose(pose);
+    Eigen::Matrix4f T = Eigen::Matrix4f::Identity();
+    T.topRows<3>() = Eigen::Map<const Eigen::Matrix<float,3,4,Eigen::RowMajor> >(pose+POSE_TCW);
+    return T;
+}
+
+Eigen::Matrix4f KeyFrame::GetPoseInverseEigen()
+{
+    float pose[POSE_SIZE];
+    LoadPose(pose);
+    Eigen::Matrix4f T = Eigen::Matrix4f::Identity();
+    T.topLeftCorner<3,3>() = Eigen::Map<const Eigen::Matrix<float,3,4,Eigen::RowMajor> >(pose+POSE_TCW).leftCols<3>().transpose();
+    T.topRightCorner<3,1>() = Eigen::Map<const Eigen::Vector3f>(pose+POSE_OW);
+    return T;
+}
+
+Eigen::Vector3f KeyFrame::GetCameraCenterEigen()
+{
+    float pose[POSE_SIZE];
+    LoadPose(pose);
+    return Eigen::Map<const Eigen::Vector3f>(pose+POSE_OW);
+}
+
+Eigen::Matrix3f KeyFrame::GetRotationEigen()
+{
+    float pose[POSE_SIZE];
+    LoadPose(pose);
+    return Eigen::Map<const Eigen::Matrix<float,3,4,Eigen::RowMajor> >(pose+POSE_TCW).leftCols<3>();
+}
+
+Eigen::Vector3f KeyFrame::GetTranslationEigen()
+{
+    float pose[POSE_SIZE];
+    LoadPose(pose);
+    return Eigen::Map<const Eigen::Matrix<float,3,4,Eigen::RowMajor> >(pose+POSE_TCW).col(3);
 }
 
 cv::Mat KeyFrame::GetPose()
 {
-    unique_lock<mutex> lock(mMutexPose);
-    return Tcw.clone();
+    const Eigen::Matrix4f T = GetPoseEigen();
+    cv::Mat Tcw_(4,4,CV_32F);
+    Eigen::Map<Eigen::Matrix<float,4,4,Eigen::RowMajor> >(Tcw_.ptr<float>(0)) = T;
+    return Tcw_;
 }
 
 cv::Mat KeyFrame::GetPoseInverse()
 {
-    unique_lock<mutex> lock(mMutexPose);
-    return Twc.clone();
+    const Eigen::Matrix4f T = GetPoseInverseEigen();
+    cv::Mat Twc_(4,4,CV_32F);
+    Eigen::Map<Eigen::Matrix<float,4,4,Eigen::RowMajor> >(Twc_.ptr<float>(0)) = T;
+    return Twc_;
 }
 
 cv::Mat KeyFrame::GetCameraCenter()
 {
-    unique_lock<mutex> lock(mMutexPose);
-    return Ow.clone();
+    float pose[POSE_SIZE];
+    LoadPose(pose);
+    return (cv::Mat_<float>(3,1) << pose[POSE_OW], pose[POSE_OW+1], pose[POSE_OW+2]);
 }
 
 cv::Mat KeyFrame::GetStereoCenter()
 {
-    unique_lock<mutex> lock(mMutexPose);
-    return Cw.clone();
+    float pose[POSE_SIZE];
+    LoadPose(pose);
+    return (cv::Mat_<float>(4,1) << pose[POSE_CW], pose[POSE_CW+1], pose[POSE_CW+2], 1);
 }
 
 
 cv::Mat KeyFrame::GetRotation()
 {
-    unique_lock<mutex> lock(mMutexPose);
-    return Tcw.rowRange(0,3).colRange(0,3).clone();
+    const Eigen::Matrix3f R = GetRotationEigen();
+    cv::Mat Rcw(3,3,CV_32F);
+    Eigen::Map<Eigen::Matrix<float,3,3,Eigen::RowMajor> >(Rcw.ptr<float>(0)) = R;
+    return Rcw;
 }
 
 cv::Mat KeyFrame::GetTranslation()
 {
-    unique_lock<mutex> lock(mMutexPose);
-    return Tcw.rowRange(0,3).col(3).clone();
+    float pose[POSE_SIZE];
+    LoadPose(pose);
+    return (cv::Mat_<float>(3,1) << pose[POSE_TCW+3], pose[POSE_TCW+7], pose[POSE_TCW+11]);
 }
 
 void KeyFrame::AddConnection(KeyFrame *pKF, const int &weight)
 {
-    {
-        unique_lock<mutex> lock(mMutexConnections);
-        if(!mConnectedKeyFrameWeights.count(pKF))
-            mConnectedKeyFrameWeights[pKF]=weight;
-        else if(mConnectedKeyFrameWeights[pKF]!=weight)
-            mConnectedKeyFrameWeights[pKF]=weight;
-        else
-            return;
-    }
-
-    UpdateBestCovisibles();
+    // the ordered neighbours are rebuilt on the next read
+    unique_lock<mutex> lock(mMutexConnections);
+    mConnections.Set(pKF,weight);
 }
 
 void KeyFrame::UpdateBestCovisibles()
 {
     unique_lock<mutex> lock(mMutexConnections);
-    vector<pair<int,KeyFrame*> > vPairs;
-    vPairs.reserve(mConnectedKeyFrameWeights.size());
-    for(map<KeyFrame*,int>::iterator mit=mConnectedKeyFrameWeights.begin(), mend=mConnectedKeyFrameWeights.end(); mit!=mend; mit++)
-       vPairs.push_back(make_pair(mit->second,mit->first));
-
-    sort(vPairs.begin(),vPairs.end());
-    list<KeyFrame*> lKFs;
-    list<int> lWs;
-    for(size_t i=0, iend=vPairs.size(); i<iend;i++)
-    {
-        lKFs.push_front(vPairs[i].second);
-        lWs.push_front(vPairs[i].first);
-    }
-
-    mvpOrderedConnectedKeyFrames = vector<KeyFrame*>(lKFs.begin(),lKFs.end());
-    mvOrderedWeights = vector<int>(lWs.begin(), lWs.end());    
+    mConnections.Ordered();
 }
 
 set<KeyFrame*> KeyFrame::GetConnectedKeyFrames()
 {
     unique_lock<mutex> lock(mMutexConnections);
     set<KeyFrame*> s;
-    for(map<KeyFrame*,int>::iterator mit=mConnectedKeyFrameWeights.begin();mit!=mConnectedKeyFrameWeights.end();mit++)
-        s.insert(mit->first);
+    const vector<CovisibilityList::Edge> &vEdges = mConnections.Edges();
+    for(size_t i=0; i<vEdges.size(); i++)
+        s.insert(s.end(),vEdges[i].first);
     return s;
 }
 
 vector<KeyFrame*> KeyFrame::GetVectorCovisibleKeyFrames()
 {
     unique_lock<mutex> lock(mMutexConnections);
-    return mvpOrderedConnectedKeyFrames;
+    return mConnections.Ordered();
 }
 
 vector<KeyFrame*> KeyFrame::GetBestCovisibilityKeyFrames(const int &N)
+{
+    vector<KeyFrame*> vpBest;
+    GetBestCovisibilityKeyFrames(N,vpBest);
+    return vpBest;
+}
+
+void KeyFrame::GetBestCovisibilityKeyFrames(const int &N, vector<KeyFrame*> &vpBest)
 {
     unique_lock<mutex> lock(mMutexConnections);
-    if((int)mvpOrderedConnectedKeyFrames.size()<N)
-        return mvpOrderedConnectedKeyFrames;
+    const vector<KeyFrame*> &vpOrdered = mConnections.Ordered();
+    if((int)vpOrdered.size()<N)
+        vpBest.assign(vpOrdered.begin(),vpOrdered.end());
     else
-        return vector<KeyFrame*>(mvpOrderedConnectedKeyFrames.begin(),mvpOrderedConnectedKeyFrames.begin()+N);
-
+        vpBest.assign(vpOrdered.begin(),vpOrdered.begin()+N);
 }
 
 vector<KeyFrame*> KeyFrame::GetCovisiblesByWeight(const int &w)
 {
     unique_lock<mutex> lock(mMutexConnections);
 
-    if(mvpOrderedConnectedKeyFrames.empty())
+    const vector<KeyFrame*> &vpOrdered = mConnections.Ordered();
+    const vector<int> &vWeights = mConnections.OrderedWeights();
+    if(vpOrdered.empty())
         return vector<KeyFrame*>();
 
-    vector<int>::iterator it = upper_bound(mvOrderedWeights.begin(),mvOrderedWeights.end(),w,KeyFrame::weightComp);
-    if(it==mvOrderedWeights.end())
+    vector<int>::const_iterator it = upper_bound(vWeights.begin(),vWeights.end(),w,KeyFrame::weightComp);
+    if(it==vWeights.end())
         return vector<KeyFrame*>();
     else
     {
-        int n = it-mvOrderedWeights.begin();
-        return vector<KeyFrame*>(mvpOrderedConnectedKeyFrames.begin(), mvpOrderedConnectedKeyFrames.begin()+n);
+        int n = it-vWeights.begin();
+        return vector<KeyFrame*>(vpOrdered.begin(), vpOrdered.begin()+n);
     }
 }
 
 int KeyFrame::GetWeight(KeyFrame *pKF)
 {
     unique_lock<mutex> lock(mMutexConnections);
-    if(mConnectedKeyFrameWeights.count(pKF))
-        return mConnectedKeyFrameWeights[pKF];
-    else
-        return 0;
+    return mConnections.Weight(pKF);
 }
 
 void KeyFrame::AddMapPoint(MapPoint *pMP, const size_t &idx)
@@ -355,8 +406,6 @@ MapPoint* KeyFrame::GetMapPoint(const size_t &idx)
 
 void KeyFrame::UpdateConnections()
 {
-    map<KeyFrame*, int> KFcounter;
-
     vector<MapPoint*> vpMP;
 
     {
@@ -366,6 +415,8 @@ void KeyFrame::UpdateConnections()
 
     //For all map points in keyframe check in which other keyframes are they seen
     //Increase counter for those keyframes
+    vector<KeyFrame*> vpObservers;
+    vpObservers.reserve(4*vpMP.size());
     for(vector<MapPoint*>::iterator vit=vpMP.begin(), vend=vpMP.end(); vit!=vend; vit++)
     {
         MapPoint* pMP = *vit;
@@ -376,68 +427,61 @@ void KeyFrame::UpdateConnections()
         if(pMP->isBad())
             continue;
 
-        map<KeyFrame*,size_t> observations = pMP->GetObservations();
-
-        for(map<KeyFrame*,size_t>::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+        pMP->ForEachObservation([&](KeyFrame* pKFi, size_t)
         {
-            if(mit->first->mnId==mnId)
-                continue;
-            KFcounter[mit->first]++;
-        }
+            if(pKFi->mnId!=mnId)
+                vpObservers.push_back(pKFi);
+        });
     }
 
     // This should not happen
-    if(KFcounter.empty())
+    if(vpObservers.empty())
         return;
 
+    // Counters as an adjacency array sorted by KeyFrame pointer
+    sort(vpObservers.begin(),vpObservers.end());
+    vector<CovisibilityList::Edge> vEdges;
+    for(size_t i=0; i<vpObservers.size();)
+    {
+        size_t j=i+1;
+        while(j<vpObservers.size() && vpObservers[j]==vpObservers[i])
+            j++;
+        vEdges.push_back(CovisibilityList::Edge(vpObservers[i],static_cast<int>(j-i)));
+        i=j;
+    }
+
     //If the counter is greater than threshold add connection
     //In case no keyframe counter is over threshold add the one with maximum counter
     int nmax=0;
     KeyFrame* pKFmax=NULL;
     int th = 15;
+    bool bConnected = false;
 
-    vector<pair<int,KeyFrame*> > vPairs;
-    vPairs.reserve(KFcounter.size());
-    for(map<KeyFrame*,int>::iterator mit=KFcounter.begin(), mend=KFcounter.end(); mit!=mend; mit++)
+    for(size_t i=0; i<vEdges.size(); i++)
     {
-        if(mit->second>nmax)
+        if(vEdges[i].second>nmax)
         {
-            nmax=mit->second;
-            pKFmax=mit->first;
+            nmax=vEdges[i].second;
+            pKFmax=vEdges[i].first;
         }
-        if(mit->second>=th)
+        if(vEdges[i].second>=th)
         {
-            vPairs.push_back(make_pair(mit->second,mit->first));
-            (mit->first)->AddConnection(this,mit->second);
+            vEdges[i].first->AddConnection(this,vEdges[i].second);
+            bConnected = true;
         }
     }
 
-    if(vPairs.empty())
-    {
-        vPairs.push_back(make_pair(nmax,pKFmax));
+    if(!bConnected)
         pKFmax->AddConnection(this,nmax);
-    }
-
-    sort(vPairs.begin(),vPairs.end());
-    list<KeyFrame*> lKFs;
-    list<int> lWs;
-    for(size_t i=0; i<vPairs.size();i++)
-    {
-        lKFs.push_front(vPairs[i].second);
-        lWs.push_front(vPairs[i].first);
-    }
 
     {
         unique_lock<mutex> lockCon(mMutexConnections);
 
-        // mspConnectedKeyFrames = spConnectedKeyFrames;
-        mConnectedKeyFrameWeights = KFcounter;
-        mvpOrderedConnectedKeyFrames = vector<KeyFrame*>(lKFs.begin(),lKFs.end());
-        mvOrderedWeights = vector<int>(lWs.begin(), lWs.end());
+        mConnections.Assign(vEdges,th);
 
         if(mbFirstConnection && mnId!=0)
         {
-            mpParent = mvpOrderedConnectedKeyFrames.front();
+            mpParent = mConnections.Ordered().front();
             mpParent->AddChild(this);
             mbFirstConnection = false;
         }
@@ -530,8 +574,13 @@ void KeyFrame::SetBadFlag()
         }
     }
 
-    for(map<KeyFrame*,int>::iterator mit = mConnectedKeyFrameWeights.begin(), mend=mConnectedKeyFrameWeights.end(); mit!=mend; mit++)
-        mit->first->EraseConnection(this);
+    vector<CovisibilityList::Edge> vEdges;
+    {
+        unique_lock<mutex> lock(mMutexConnections);
+        vEdges = mConnections.Edges();
+    }
+    for(size_t i=0; i<vEdges.size(); i++)
+        vEdges[i].first->EraseConnection(this);
 
     for(size_t i=0; i<mvpMapPoints.size(); i++)
         if(mvpMapPoints[i])
@@ -540,8 +589,7 @@ void KeyFrame::SetBadFlag()
         unique_lock<mutex> lock(mMutexConnections);
         unique_lock<mutex> lock1(mMutexFeatures);
 
-        mConnectedKeyFrameWeights.clear();
-        mvpOrderedConnectedKeyFrames.clear();
+        mConnections.Clear();
 
         // Update Spanning Tree
         set<KeyFrame*> sParentCandidates;
@@ -619,18 +667,8 @@ bool KeyFrame::isBad()
 
 void KeyFrame::EraseConnection(KeyFrame* pKF)
 {
-    bool bUpdate = false;
-    {
-        unique_lock<mutex> lock(mMutexConnections);
-        if(mConnectedKeyFrameWeights.count(pKF))
-        {
-            mConnectedKeyFrameWeights.erase(pKF);
-            bUpdate=true;
-        }
-    }
-
-    if(bUpdate)
-        UpdateBestCovisibles();
+    unique_lock<mutex> lock(mMutexConnections);
+    mConnections.Erase(pKF);
 }
 
 vector<size_t> KeyFrame::GetFeaturesInArea(const float &x, const float &y, const float &r) const
@@ -703,6 +741,21 @@ cv::Mat KeyFrame::UnprojectStereo(int i)
         return cv::Mat();
 }
 
+bool KeyFrame::UnprojectStereo(int i, Eigen::Vector3f &x3D)
+{
+    const float z = mvDepth[i];
+    if(z<=0)
+        return false;
+
+    const float u = mvKeys[i].pt.x;
+    const float v = mvKeys[i].pt.y;
+    const Eigen::Vector3f x3Dc((u-cx)*z*invfx, (v-cy)*z*invfy, z);
+
+    const Eigen::Matrix4f Twc_ = GetPoseInverseEigen();
+    x3D = Twc_.topLeftCorner<3,3>()*x3Dc+Twc_.topRightCorner<3,1>();
+    return true;
+}
+
 float KeyFrame::ComputeSceneMedianDepth(const int q)
 {
     vector<MapPoint*> vpMapPoints;
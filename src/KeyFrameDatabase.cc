@@ -24,6 +24,8 @@
 #include "Thirdparty/DBoW2/DBoW2/BowVector.h"
 
 #include<mutex>
+#include<math.h>
+#include<algorithm>
 
 using namespace std;
 
@@ -33,119 +35,211 @@ namespace ORB_SLAM2
 KeyFrameDatabase::KeyFrameDatabase (const ORBVocabulary &voc):
     mpVoc(&voc)
 {
+    mbAccumulateL1 = (voc.getScoringType()==DBoW2::L1_NORM);
     mvInvertedFile.resize(voc.size());
 }
 
 
 void KeyFrameDatabase::add(KeyFrame *pKF)
 {
-    unique_lock<mutex> lock(mMutex);
+    boost::unique_lock<boost::shared_mutex> lock(mMutex);
+
+    const unsigned int id = pKF->mnId;
+    if(id>=mvpKeyFrames.size())
+        mvpKeyFrames.resize(max<size_t>(id+1, 2*mvpKeyFrames.size()),static_cast<KeyFrame*>(NULL));
+    mvpKeyFrames[id] = pKF;
 
     for(DBoW2::BowVector::const_iterator vit= pKF->mBowVec.begin(), vend=pKF->mBowVec.end(); vit!=vend; vit++)
-        mvInvertedFile[vit->first].push_back(pKF);
+    {
+        PostingList &posting = mvInvertedFile[vit->first];
+        posting.mvKFIds.push_back(id);
+        posting.mvWeights.push_back(vit->second);
+    }
 }
 
 void KeyFrameDatabase::erase(KeyFrame* pKF)
 {
-    unique_lock<mutex> lock(mMutex);
+    boost::unique_lock<boost::shared_mutex> lock(mMutex);
+
+    const unsigned int id = pKF->mnId;
+    if(id>=mvpKeyFrames.size() || mvpKeyFrames[id]!=pKF)
+        return;
+
+    // Tombstone: the entries stay in the posting lists until they are compacted
+    mvpKeyFrames[id] = NULL;
 
-    // Erase elements in the Inverse File for the entry
     for(DBoW2::BowVector::const_iterator vit=pKF->mBowVec.begin(), vend=pKF->mBowVec.end(); vit!=vend; vit++)
     {
-        // List of keyframes that share the word
-        list<KeyFrame*> &lKFs =   mvInvertedFile[vit->first];
+        PostingList &posting = mvInvertedFile[vit->first];
+        posting.mnDead++;
+        if(2*posting.mnDead>posting.mvKFIds.size())
+            CompactPostingList(posting);
+    }
+}
 
-        for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
-        {
-            if(pKF==*lit)
-            {
-                lKFs.erase(lit);
-                break;
-            }
-        }
+void KeyFrameDatabase::CompactPostingList(PostingList &posting)
+{
+    size_t j=0;
+    for(size_t i=0, iend=posting.mvKFIds.size(); i<iend; i++)
+    {
+        if(!mvpKeyFrames[posting.mvKFIds[i]])
+            continue;
+        posting.mvKFIds[j] = posting.mvKFIds[i];
+        posting.mvWeights[j] = posting.mvWeights[i];
+        j++;
+    }
+    posting.mvKFIds.resize(j);
+    posting.mvWeights.resize(j);
+    posting.mnDead = 0;
+
+    if(j==0)
+    {
+        vector<unsigned int>().swap(posting.mvKFIds);
+        vector<DBoW2::WordValue>().swap(posting.mvWeights);
     }
 }
 
 void KeyFrameDatabase::clear()
 {
+    boost::unique_lock<boost::shared_mutex> lock(mMutex);
+
     mvInvertedFile.clear();
     mvInvertedFile.resize(mpVoc->size());
+    mvpKeyFrames.clear();
 }
 
+KeyFrameDatabase::QueryContext& KeyFrameDatabase::BeginQuery()
+{
+    // One context per thread (tracking, loop closing), reused across queries
+    static thread_local QueryContext ctx;
+
+    // Must be called with mMutex held, so the number of keyframes is stable
+    const size_t N = mvpKeyFrames.size();
+    if(ctx.mvnStamp.size()<N)
+    {
+        ctx.mvnStamp.resize(N,0);
+        ctx.mvnCommonWords.resize(N,0);
+        ctx.mvL1Acc.resize(N,0.0);
+        ctx.mvScore.resize(N,0.f);
+    }
 
-vector<KeyFrame*> KeyFrameDatabase::DetectLoopCandidates(KeyFrame* pKF, float minScore)
+    // New query: entries with an older stamp are treated as zero
+    ctx.mnStamp++;
+    if(ctx.mnStamp==0)
+    {
+        fill(ctx.mvnStamp.begin(),ctx.mvnStamp.end(),0);
+        ctx.mnStamp = 1;
+    }
+    ctx.mvTouched.clear();
+
+    return ctx;
+}
+
+void KeyFrameDatabase::SearchSharingWords(const DBoW2::BowVector &bowVec, QueryContext &ctx) const
 {
-    set<KeyFrame*> spConnectedKeyFrames = pKF->GetConnectedKeyFrames();
-    list<KeyFrame*> lKFsSharingWords;
+    const unsigned int stamp = ctx.mnStamp;
 
-    // Search all keyframes that share a word with current keyframes
-    // Discard keyframes connected to the query keyframe
+    // Words are visited in ascending id order, the same order DBoW2's L1
+    // scoring merges the two vectors in, so the accumulated score is exact.
+    for(DBoW2::BowVector::const_iterator vit=bowVec.begin(), vend=bowVec.end(); vit != vend; vit++)
     {
-        unique_lock<mutex> lock(mMutex);
+        const PostingList &posting = mvInvertedFile[vit->first];
+        const unsigned int* pIds = posting.mvKFIds.data();
+        const DBoW2::WordValue* pWeights = posting.mvWeights.data();
+        const DBoW2::WordValue vi = vit->second;
 
-        for(DBoW2::BowVector::const_iterator vit=pKF->mBowVec.begin(), vend=pKF->mBowVec.end(); vit != vend; vit++)
+        for(size_t i=0, iend=posting.mvKFIds.size(); i<iend; i++)
         {
-            list<KeyFrame*> &lKFs =   mvInvertedFile[vit->first];
+            const unsigned int id = pIds[i];
+            if(!mvpKeyFrames[id])
+                continue;
 
-            for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
+            if(ctx.mvnStamp[id]!=stamp)
             {
-                KeyFrame* pKFi=*lit;
-                if(pKFi->mnLoopQuery!=pKF->mnId)
-                {
-                    pKFi->mnLoopWords=0;
-                    if(!spConnectedKeyFrames.count(pKFi))
-                    {
-                        pKFi->mnLoopQuery=pKF->mnId;
-                        lKFsSharingWords.push_back(pKFi);
-                    }
-                }
-                pKFi->mnLoopWords++;
+                ctx.mvnStamp[id] = stamp;
+                ctx.mvnCommonWords[id] = 0;
+                ctx.mvL1Acc[id] = 0.0;
+                ctx.mvScore[id] = 0.f;
+                ctx.mvTouched.push_back(id);
+            }
+            ctx.mvnCommonWords[id]++;
+
+            if(mbAccumulateL1)
+            {
+                const DBoW2::WordValue wi = pWeights[i];
+                ctx.mvL1Acc[id] += fabs(vi - wi) - fabs(vi) - fabs(wi);
             }
         }
     }
+}
 
-    if(lKFsSharingWords.empty())
-        return vector<KeyFrame*>();
+float KeyFrameDatabase::Score(const DBoW2::BowVector &bowVec, const unsigned int id, const QueryContext &ctx) const
+{
+    if(mbAccumulateL1)
+        return -ctx.mvL1Acc[id]/2.0;
+
+    return mpVoc->score(bowVec,mvpKeyFrames[id]->mBowVec);
+}
+
+
+vector<KeyFrame*> KeyFrameDatabase::DetectLoopCandidates(KeyFrame* pKF, float minScore)
+{
+    set<KeyFrame*> spConnectedKeyFrames = pKF->GetConnectedKeyFrames();
+
+    // Shared lock: keyframes cannot be added or erased while we score them
+    boost::shared_lock<boost::shared_mutex> lock(mMutex);
 
-    list<pair<float,KeyFrame*> > lScoreAndMatch;
+    // Search all keyframes that share a word with current keyframes
+    QueryContext &ctx = BeginQuery();
+    SearchSharingWords(pKF->mBowVec, ctx);
+    const vector<unsigned int> &vTouched = ctx.mvTouched;
+
+    // Discard keyframes connected to the query keyframe
+    for(set<KeyFrame*>::const_iterator sit=spConnectedKeyFrames.begin(), send=spConnectedKeyFrames.end(); sit!=send; sit++)
+    {
+        const unsigned int id = (*sit)->mnId;
+        if(ctx.IsTouched(id))
+            ctx.mvnStamp[id] = 0;
+    }
 
     // Only compare against those keyframes that share enough words
     int maxCommonWords=0;
-    for(list<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
+    for(size_t i=0, iend=vTouched.size(); i<iend; i++)
     {
-        if((*lit)->mnLoopWords>maxCommonWords)
-            maxCommonWords=(*lit)->mnLoopWords;
+        const unsigned int id = vTouched[i];
+        if(ctx.IsTouched(id) && ctx.mvnCommonWords[id]>maxCommonWords)
+            maxCommonWords=ctx.mvnCommonWords[id];
     }
 
+    if(maxCommonWords==0)
+        return vector<KeyFrame*>();
+
     int minCommonWords = maxCommonWords*0.8f;
 
-    int nscores=0;
+    vector<pair<float,KeyFrame*> > vScoreAndMatch;
 
     // Compute similarity score. Retain the matches whose score is higher than minScore
-    for(list<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
+    for(size_t i=0, iend=vTouched.size(); i<iend; i++)
     {
-        KeyFrame* pKFi = *lit;
-
-        if(pKFi->mnLoopWords>minCommonWords)
-        {
-            nscores++;
-
-            float si = mpVoc->score(pKF->mBowVec,pKFi->mBowVec);
-
-            pKFi->mLoopScore = si;
-            if(si>=minScore)
-                lScoreAndMatch.push_back(make_pair(si,pKFi));
-        }
+        const unsigned int id = vTouched[i];
+        if(!ctx.IsTouched(id) || ctx.mvnCommonWords[id]<=minCommonWords)
+            continue;
+
+        const float si = Score(pKF->mBowVec,id,ctx);
+        ctx.mvScore[id] = si;
+        if(si>=minScore)
+            vScoreAndMatch.push_back(make_pair(si,mvpKeyFrames[id]));
     }
 
-    if(lScoreAndMatch.empty())
+    if(vScoreAndMatch.empty())
         return vector<KeyFrame*>();
 
-    list<pair<float,KeyFrame*> > lAccScoreAndMatch;
+    vector<pair<float,KeyFrame*> > vAccScoreAndMatch;
+    vAccScoreAndMatch.reserve(vScoreAndMatch.size());
     float bestAccScore = minScore;
 
     // Lets now accumulate score by covisibility
-    for(list<pair<float,KeyFrame*> >::iterator it=lScoreAndMatch.begin(), itend=lScoreAndMatch.end(); it!=itend; it++)
+    for(vector<pair<float,KeyFrame*> >::iterator it=vScoreAndMatch.begin(), itend=vScoreAndMatch.end(); it!=itend; it++)
     {
         KeyFrame* pKFi = it->second;
         vector<KeyFrame*> vpNeighs = pKFi->GetBestCovisibilityKeyFrames(10);
@@ -156,30 +250,33 @@ vector<KeyFrame*> KeyFrameDatabase::DetectLoopCandidates(KeyFrame* pKF, float mi
         for(vector<KeyFrame*>::iterator vit=vpNeighs.begin(), vend=vpNeighs.end(); vit!=vend; vit++)
         {
             KeyFrame* pKF2 = *vit;
-            if(pKF2->mnLoopQuery==pKF->mnId && pKF2->mnLoopWords>minCommonWords)
+            const unsigned int id2 = pKF2->mnId;
+            if(ctx.IsTouched(id2) && ctx.mvnCommonWords[id2]>minCommonWords)
             {
-                accScore+=pKF2->mLoopScore;
-                if(pKF2->mLoopScore>bestScore)
+                accScore+=ctx.mvScore[id2];
+                if(ctx.mvScore[id2]>bestScore)
                 {
                     pBestKF=pKF2;
-                    bestScore = pKF2->mLoopScore;
+                    bestScore = ctx.mvScore[id2];
                 }
             }
         }
 
-        lAccScoreAndMatch.push_back(make_pair(accScore,pBestKF));
+        vAccScoreAndMatch.push_back(make_pair(accScore,pBestKF));
         if(accScore>bestAccScore)
             bestAccScore=accScore;
     }
 
+    lock.unlock();
+
     // Return all those keyframes with a score higher than 0.75*bestScore
     float minScoreToRetain = 0.75f*bestAccScore;
 
     set<KeyFrame*> spAlreadyAddedKF;
     vector<KeyFrame*> vpLoopCandidates;
-    vpLoopCandidates.reserve(lAccScoreAndMatch.size());
+    vpLoopCandidates.reserve(vAccScoreAndMatch.size());
 
-    for(list<pair<float,KeyFrame*> >::iterator it=lAccScoreAndMatch.begin(), itend=lAccScoreAndMatch.end(); it!=itend; it++)
+    for(vector<pair<float,KeyFrame*> >::iterator it=vAccScoreAndMatch.begin(), itend=vAccScoreAndMatch.end(); it!=itend; it++)
     {
         if(it->first>minScoreToRetain)
         {
@@ -198,68 +295,50 @@ vector<KeyFrame*> KeyFrameDatabase::DetectLoopCandidates(KeyFrame* pKF, float mi
 
 vector<KeyFrame*> KeyFrameDatabase::DetectRelocalizationCandidates(Frame *F)
 {
-    list<KeyFrame*> lKFsSharingWords;
+    boost::shared_lock<boost::shared_mutex> lock(mMutex);
 
     // Search all keyframes that share a word with current frame
-    {
-        unique_lock<mutex> lock(mMutex);
-
-        for(DBoW2::BowVector::const_iterator vit=F->mBowVec.begin(), vend=F->mBowVec.end(); vit != vend; vit++)
-        {
-            list<KeyFrame*> &lKFs =   mvInvertedFile[vit->first];
+    QueryContext &ctx = BeginQuery();
+    SearchSharingWords(F->mBowVec, ctx);
+    const vector<unsigned int> &vTouched = ctx.mvTouched;
 
-            for(list<KeyFrame*>::iterator lit=lKFs.begin(), lend= lKFs.end(); lit!=lend; lit++)
-            {
-                KeyFrame* pKFi=*lit;
-                if(pKFi->mnRelocQuery!=F->mnId)
-                {
-                    pKFi->mnRelocWords=0;
-                    pKFi->mnRelocQuery=F->mnId;
-                    lKFsSharingWords.push_back(pKFi);
-                }
-                pKFi->mnRelocWords++;
-            }
-        }
-    }
-    if(lKFsSharingWords.empty())
+    if(vTouched.empty())
         return vector<KeyFrame*>();
 
     // Only compare against those keyframes that share enough words
     int maxCommonWords=0;
-    for(list<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
+    for(size_t i=0, iend=vTouched.size(); i<iend; i++)
     {
-        if((*lit)->mnRelocWords>maxCommonWords)
-            maxCommonWords=(*lit)->mnRelocWords;
+        if(ctx.mvnCommonWords[vTouched[i]]>maxCommonWords)
+            maxCommonWords=ctx.mvnCommonWords[vTouched[i]];
     }
 
     int minCommonWords = maxCommonWords*0.8f;
 
-    list<pair<float,KeyFrame*> > lScoreAndMatch;
-
-    int nscores=0;
+    vector<pair<float,KeyFrame*> > vScoreAndMatch;
 
     // Compute similarity score.
-    for(list<KeyFrame*>::iterator lit=lKFsSharingWords.begin(), lend= lKFsSharingWords.end(); lit!=lend; lit++)
+    for(size_t i=0, iend=vTouched.size(); i<iend; i++)
     {
-        KeyFrame* pKFi = *lit;
-
-        if(pKFi->mnRelocWords>minCommonWords)
+        const unsigned int id = vTouched[i];
+        if(ctx.mvnCommonWords[id]>minCommonWords)
         {
-            nscores++;
-            float si = mpVoc->score(F->mBowVec,pKFi->mBowVec);
-            pKFi->mRelocScore=si;
-            lScoreAndMatch.push_back(make_pair(si,pKFi));
+            const float si = Score(F->mBowVec,id,ctx);
+            ctx.mvScore[id]=si;
+            vScoreAndMatch.push_back(make_pair(si,mvpKeyFrames[id]));
         }
     }
 
-    if(lScoreAndMatch.empty())
+    if(vScoreAndMatch.empty())
         return vector<KeyFrame*>();
 
-    list<pair<float,KeyFrame*> > lAccScoreAndMatch;
+    vector<pair<float,KeyFrame*> > vAccScoreAndMatch;
+    vAccScoreAndMatch.reserve(vScoreAndMatch.size());
     float bestAccScore = 0;
 
     // Lets now accumulate score by covisibility
-    for(list<pair<float,KeyFrame*> >::iterator it=lScoreAndMatch.begin(), itend=lScoreAndMatch.end(); it!=itend; it++)
+    // Neighbours sharing words but not scored in this query count as 0
+    for(vector<pair<float,KeyFrame*> >::iterator it=vScoreAndMatch.begin(), itend=vScoreAndMatch.end(); it!=itend; it++)
     {
         KeyFrame* pKFi = it->second;
         vector<KeyFrame*> vpNeighs = pKFi->GetBestCovisibilityKeyFrames(10);
@@ -270,28 +349,31 @@ vector<KeyFrame*> KeyFrameDatabase::DetectRelocalizationCandidates(Frame *F)
         for(vector<KeyFrame*>::iterator vit=vpNeighs.begin(), vend=vpNeighs.end(); vit!=vend; vit++)
         {
             KeyFrame* pKF2 = *vit;
-            if(pKF2->mnRelocQuery!=F->mnId)
+            const unsigned int id2 = pKF2->mnId;
+            if(!ctx.IsTouched(id2))
                 continue;
 
-            accScore+=pKF2->mRelocScore;
-            if(pKF2->mRelocScore>bestScore)
+            accScore+=ctx.mvScore[id2];
+            if(ctx.mvScore[id2]>bestScore)
             {
                 pBestKF=pKF2;
-                bestScore = pKF2->mRelocScore;
+                bestScore = ctx.mvScore[id2];
             }
 
         }
-        lAccScoreAndMatch.push_back(make_pair(accScore,pBestKF));
+        vAccScoreAndMatch.push_back(make_pair(accScore,pBestKF));
         if(accScore>bestAccScore)
             bestAccScore=accScore;
     }
 
+    lock.unlock();
+
     // Return all those keyframes with a score higher than 0.75*bestScore
     float minScoreToRetain = 0.75f*bestAccScore;
     set<KeyFrame*> spAlreadyAddedKF;
     vector<KeyFrame*> vpRelocCandidates;
-    vpRelocCandidates.reserve(lAccScoreAndMatch.size());
-    for(list<pair<float,KeyFrame*> >::iterator it=lAccScoreAndMatch.begin(), itend=lAccScoreAndMatch.end(); it!=itend; it++)
+    vpRelocCandidates.reserve(vAccScoreAndMatch.size());
+    for(vector<pair<float,KeyFrame*> >::iterator it=vAccScoreAndMatch.begin(), itend=vAccScoreAndMatch.end(); it!=itend; it++)
     {
         const float &si = it->first;
         if(si>minScoreToRetain)
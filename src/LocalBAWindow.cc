@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#include "LocalBAWindow.h"
+
+#include "Thirdparty/g2o/g2o/core/optimization_algorithm.h"
+
+namespace ORB_SLAM2 {
+
+LocalBAWindow::LocalBAWindow() : mpDenseSolver(NULL), mpSparseSolver(NULL)
+{
+}
+
+LocalBAWindow::~LocalBAWindow()
+{
+    // the optimizer would delete the current solver, both are owned here
+    mOptimizer.setAlgorithm(NULL);
+    delete mpDenseSolver;
+    delete mpSparseSolver;
+}
+
+void LocalBAWindow::Clear()
+{
+    // deletes all vertices and edges, the solver is kept
+    mOptimizer.clear();
+    mmKeyFrames.clear();
+    mmPoints.clear();
+}
+
+}  // namespace ORB_SLAM2
@@ -22,7 +22,11 @@
 #include "LoopClosing.h"
 #include "ORBmatcher.h"
 #include "Optimizer.h"
+#include "LocalBAWindow.h"
+#include "ThreadPool.h"
+#include "Triangulation.h"
 #include <unistd.h>
+#include <cassert>
 #include<mutex>
 
 namespace ORB_SLAM2
@@ -30,7 +34,12 @@ namespace ORB_SLAM2
 
 LocalMapping::LocalMapping(Map *pMap, const float bMonocular):
     mbMonocular(bMonocular), mbResetRequested(false), mbFinishRequested(false), mbFinished(true), mpMap(pMap),
-    mbAbortBA(false), mbStopped(false), mbStopRequested(false), mbNotStop(false), mbAcceptKeyFrames(true)
+    mbAbortBA(false), mpLocalBAWindow(new LocalBAWindow()), mbStopped(false), mbStopRequested(false), mbNotStop(false), mbAcceptKeyFrames(true)
+{
+}
+
+// LocalBAWindow is only complete here
+LocalMapping::~LocalMapping()
 {
 }
 
@@ -78,7 +87,7 @@ void LocalMapping::Run()
             {
                 // Local BA
                 if(mpMap->KeyFramesInMap()>2)
-                    Optimizer::LocalBundleAdjustment(mpCurrentKeyFrame,&mbAbortBA, mpMap);
+                    Optimizer::LocalBundleAdjustment(mpCurrentKeyFrame,&mbAbortBA, mpMap, mpLocalBAWindow.get());
 
                 // Check redundant local Keyframes
                 KeyFrameCulling();
@@ -105,7 +114,7 @@ void LocalMapping::Run()
         if(CheckFinish())
             break;
 
-        usleep(3000);
+        WaitForNewKeyFrames();
     }
 
     SetFinish();
@@ -116,6 +125,7 @@ void LocalMapping::InsertKeyFrame(KeyFrame *pKF)
     unique_lock<mutex> lock(mMutexNewKFs);
     mlNewKeyFrames.push_back(pKF);
     mbAbortBA=true;
+    mCondNewKFs.notify_one();
 }
 
 
@@ -125,6 +135,15 @@ bool LocalMapping::CheckNewKeyFrames()
     return(!mlNewKeyFrames.empty());
 }
 
+void LocalMapping::WaitForNewKeyFrames()
+{
+    // The timeout bounds the delay of the requests that do not notify (stop/reset flags
+    // are set under other mutexes), as the former fixed sleep did
+    unique_lock<mutex> lock(mMutexNewKFs);
+    if(mlNewKeyFrames.empty())
+        mCondNewKFs.wait_for(lock,std::chrono::milliseconds(3));
+}
+
 void LocalMapping::ProcessNewKeyFrame()
 {
     {
@@ -212,242 +231,237 @@ void LocalMapping::CreateNewMapPoints()
         nn=20;
     const vector<KeyFrame*> vpNeighKFs = mpCurrentKeyFrame->GetBestCovisibilityKeyFrames(nn);
 
-    ORBmatcher matcher(0.6,false);
-
-    cv::Mat Rcw1 = mpCurrentKeyFrame->GetRotation();
-    cv::Mat Rwc1 = Rcw1.t();
-    cv::Mat tcw1 = mpCurrentKeyFrame->GetTranslation();
-    cv::Mat Tcw1(3,4,CV_32F);
-    Rcw1.copyTo(Tcw1.colRange(0,3));
-    tcw1.copyTo(Tcw1.col(3));
-    cv::Mat Ow1 = mpCurrentKeyFrame->GetCameraCenter();
-
-    const float &fx1 = mpCurrentKeyFrame->fx;
-    const float &fy1 = mpCurrentKeyFrame->fy;
-    const float &cx1 = mpCurrentKeyFrame->cx;
-    const float &cy1 = mpCurrentKeyFrame->cy;
-    const float &invfx1 = mpCurrentKeyFrame->invfx;
-    const float &invfy1 = mpCurrentKeyFrame->invfy;
-
-    const float ratioFactor = 1.5f*mpCurrentKeyFrame->mfScaleFactor;
+    // Search matches with epipolar restriction and triangulate, one neighbor per task.
+    // The candidates are kept per neighbor and merged below in neighbor order, so the
+    // result does not depend on the scheduling.
+    const int nNeighs = vpNeighKFs.size();
+    vector<vector<TriangulatedPoint> > vvPoints(nNeighs);
+    vector<char> vbAborted(nNeighs,false);
+    ThreadPool::ParallelFor(nNeighs,ThreadPool::NumThreads(),[&](int i)
+    {
+        if(i>0 && CheckNewKeyFrames())
+        {
+            vbAborted[i] = true;
+            return;
+        }
+        TriangulateWithNeighbor(vpNeighKFs[i],vvPoints[i]);
+    });
 
     int nnew=0;
 
-    // Search matches with epipolar restriction and triangulate
-    for(size_t i=0; i<vpNeighKFs.size(); i++)
+    for(int i=0; i<nNeighs; i++)
     {
-        if(i>0 && CheckNewKeyFrames())
+        if(vbAborted[i])
             return;
 
         KeyFrame* pKF2 = vpNeighKFs[i];
-
-        // Check first that baseline is not too short
-        cv::Mat Ow2 = pKF2->GetCameraCenter();
-        cv::Mat vBaseline = Ow2-Ow1;
-        const float baseline = cv::norm(vBaseline);
-
-        if(!mbMonocular)
-        {
-            if(baseline<pKF2->mb)
-            continue;
-        }
-        else
+        const vector<TriangulatedPoint> &vPoints = vvPoints[i];
+        for(size_t ip=0; ip<vPoints.size(); ip++)
         {
-            const float medianDepthKF2 = pKF2->ComputeSceneMedianDepth(2);
-            const float ratioBaselineDepth = baseline/medianDepthKF2;
+            const size_t idx1 = vPoints[ip].idx1;
+            const size_t idx2 = vPoints[ip].idx2;
 
-            if(ratioBaselineDepth<0.01)
+            // Already triangulated with a previous neighbor
+            if(mpCurrentKeyFrame->GetMapPoint(idx1))
                 continue;
-        }
 
-        // Compute Fundamental Matrix
-        cv::Mat F12 = ComputeF12(mpCurrentKeyFrame,pKF2);
-
-        // Search matches that fullfil epipolar constraint
-        vector<pair<size_t,size_t> > vMatchedIndices;
-        matcher.SearchForTriangulation(mpCurrentKeyFrame,pKF2,F12,vMatchedIndices,false);
-
-        cv::Mat Rcw2 = pKF2->GetRotation();
-        cv::Mat Rwc2 = Rcw2.t();
-        cv::Mat tcw2 = pKF2->GetTranslation();
-        cv::Mat Tcw2(3,4,CV_32F);
-        Rcw2.copyTo(Tcw2.colRange(0,3));
-        tcw2.copyTo(Tcw2.col(3));
-
-        const float &fx2 = pKF2->fx;
-        const float &fy2 = pKF2->fy;
-        const float &cx2 = pKF2->cx;
-        const float &cy2 = pKF2->cy;
-        const float &invfx2 = pKF2->invfx;
-        const float &invfy2 = pKF2->invfy;
-
-        // Triangulate each match
-        const int nmatches = vMatchedIndices.size();
-        for(int ikp=0; ikp<nmatches; ikp++)
-        {
-            const int &idx1 = vMatchedIndices[ikp].first;
-            const int &idx2 = vMatchedIndices[ikp].second;
+            // Triangulation is succesfull
+            const Eigen::Vector3f &x3D = vPoints[ip].x3D;
+            const cv::Mat Pos = (cv::Mat_<float>(3,1) << x3D(0), x3D(1), x3D(2));
+            MapPoint* pMP = new MapPoint(Pos,mpCurrentKeyFrame,mpMap);
 
-            const cv::KeyPoint &kp1 = mpCurrentKeyFrame->mvKeysUn[idx1];
-            const float kp1_ur=mpCurrentKeyFrame->mvuRight[idx1];
-            bool bStereo1 = kp1_ur>=0;
+            pMP->AddObservation(mpCurrentKeyFrame,idx1);            
+            pMP->AddObservation(pKF2,idx2);
 
-            const cv::KeyPoint &kp2 = pKF2->mvKeysUn[idx2];
-            const float kp2_ur = pKF2->mvuRight[idx2];
-            bool bStereo2 = kp2_ur>=0;
+            mpCurrentKeyFrame->AddMapPoint(pMP,idx1);
+            pKF2->AddMapPoint(pMP,idx2);
 
-            // Check parallax between rays
-            cv::Mat xn1 = (cv::Mat_<float>(3,1) << (kp1.pt.x-cx1)*invfx1, (kp1.pt.y-cy1)*invfy1, 1.0);
-            cv::Mat xn2 = (cv::Mat_<float>(3,1) << (kp2.pt.x-cx2)*invfx2, (kp2.pt.y-cy2)*invfy2, 1.0);
+            pMP->ComputeDistinctiveDescriptors();
 
-            cv::Mat ray1 = Rwc1*xn1;
-            cv::Mat ray2 = Rwc2*xn2;
-            const float cosParallaxRays = ray1.dot(ray2)/(cv::norm(ray1)*cv::norm(ray2));
+            pMP->UpdateNormalAndDepth();
 
-            float cosParallaxStereo = cosParallaxRays+1;
-            float cosParallaxStereo1 = cosParallaxStereo;
-            float cosParallaxStereo2 = cosParallaxStereo;
+            mpMap->AddMapPoint(pMP);
+            mlpRecentAddedMapPoints.push_back(pMP);
 
-            if(bStereo1)
-                cosParallaxStereo1 = cos(2*atan2(mpCurrentKeyFrame->mb/2,mpCurrentKeyFrame->mvDepth[idx1]));
-            else if(bStereo2)
-                cosParallaxStereo2 = cos(2*atan2(pKF2->mb/2,pKF2->mvDepth[idx2]));
+            nnew++;
+        }
+    }
+}
 
-            cosParallaxStereo = min(cosParallaxStereo1,cosParallaxStereo2);
+void LocalMapping::TriangulateWithNeighbor(KeyFrame* pKF2, vector<TriangulatedPoint> &vPoints)
+{
+    ORBmatcher matcher(0.6,false);
 
-            cv::Mat x3D;
-            if(cosParallaxRays<cosParallaxStereo && cosParallaxRays>0 && (bStereo1 || bStereo2 || cosParallaxRays<0.9998))
-            {
-                // Linear Triangulation Method
-                cv::Mat A(4,4,CV_32F);
-                A.row(0) = xn1.at<float>(0)*Tcw1.row(2)-Tcw1.row(0);
-                A.row(1) = xn1.at<float>(1)*Tcw1.row(2)-Tcw1.row(1);
-                A.row(2) = xn2.at<float>(0)*Tcw2.row(2)-Tcw2.row(0);
-                A.row(3) = xn2.at<float>(1)*Tcw2.row(2)-Tcw2.row(1);
+    const Triangulation::Matrix34f Tcw1 = mpCurrentKeyFrame->GetPoseEigen().topRows<3>();
+    const Eigen::Matrix3f Rcw1 = Tcw1.leftCols<3>();
+    const Eigen::Matrix3f Rwc1 = Rcw1.transpose();
+    const Eigen::Vector3f tcw1 = Tcw1.col(3);
+    const Eigen::Vector3f Ow1 = mpCurrentKeyFrame->GetCameraCenterEigen();
 
-                cv::Mat w,u,vt;
-                cv::SVD::compute(A,w,u,vt,cv::SVD::MODIFY_A| cv::SVD::FULL_UV);
+    const float &fx1 = mpCurrentKeyFrame->fx;
+    const float &fy1 = mpCurrentKeyFrame->fy;
+    const float &cx1 = mpCurrentKeyFrame->cx;
+    const float &cy1 = mpCurrentKeyFrame->cy;
+    const float &invfx1 = mpCurrentKeyFrame->invfx;
+    const float &invfy1 = mpCurrentKeyFrame->invfy;
 
-                x3D = vt.row(3).t();
+    const float ratioFactor = 1.5f*mpCurrentKeyFrame->mfScaleFactor;
 
-                if(x3D.at<float>(3)==0)
-                    continue;
+    // Check first that baseline is not too short
+    const Eigen::Vector3f Ow2 = pKF2->GetCameraCenterEigen();
+    const float baseline = (Ow2-Ow1).norm();
 
-                // Euclidean coordinates
-                x3D = x3D.rowRange(0,3)/x3D.at<float>(3);
+    if(!mbMonocular)
+    {
+        if(baseline<pKF2->mb)
+            return;
+    }
+    else
+    {
+        const float medianDepthKF2 = pKF2->ComputeSceneMedianDepth(2);
+        const float ratioBaselineDepth = baseline/medianDepthKF2;
 
-            }
-            else if(bStereo1 && cosParallaxStereo1<cosParallaxStereo2)
-            {
-                x3D = mpCurrentKeyFrame->UnprojectStereo(idx1);                
-            }
-            else if(bStereo2 && cosParallaxStereo2<cosParallaxStereo1)
-            {
-                x3D = pKF2->UnprojectStereo(idx2);
-            }
-            else
-                continue; //No stereo and very low parallax
+        if(ratioBaselineDepth<0.01)
+            return;
+    }
 
-            cv::Mat x3Dt = x3D.t();
+    // Compute Fundamental Matrix
+    cv::Mat F12 = ComputeF12(mpCurrentKeyFrame,pKF2);
 
-            //Check triangulation in front of cameras
-            float z1 = Rcw1.row(2).dot(x3Dt)+tcw1.at<float>(2);
-            if(z1<=0)
-                continue;
+    // Search matches that fullfil epipolar constraint
+    vector<pair<size_t,size_t> > vMatchedIndices;
+    matcher.SearchForTriangulation(mpCurrentKeyFrame,pKF2,F12,vMatchedIndices,false);
 
-            float z2 = Rcw2.row(2).dot(x3Dt)+tcw2.at<float>(2);
-            if(z2<=0)
-                continue;
+    const Triangulation::Matrix34f Tcw2 = pKF2->GetPoseEigen().topRows<3>();
+    const Eigen::Matrix3f Rcw2 = Tcw2.leftCols<3>();
+    const Eigen::Matrix3f Rwc2 = Rcw2.transpose();
+    const Eigen::Vector3f tcw2 = Tcw2.col(3);
 
-            //Check reprojection error in first keyframe
-            const float &sigmaSquare1 = mpCurrentKeyFrame->mvLevelSigma2[kp1.octave];
-            const float x1 = Rcw1.row(0).dot(x3Dt)+tcw1.at<float>(0);
-            const float y1 = Rcw1.row(1).dot(x3Dt)+tcw1.at<float>(1);
-            const float invz1 = 1.0/z1;
+    const float &fx2 = pKF2->fx;
+    const float &fy2 = pKF2->fy;
+    const float &cx2 = pKF2->cx;
+    const float &cy2 = pKF2->cy;
+    const float &invfx2 = pKF2->invfx;
+    const float &invfy2 = pKF2->invfy;
 
-            if(!bStereo1)
-            {
-                float u1 = fx1*x1*invz1+cx1;
-                float v1 = fy1*y1*invz1+cy1;
-                float errX1 = u1 - kp1.pt.x;
-                float errY1 = v1 - kp1.pt.y;
-                if((errX1*errX1+errY1*errY1)>5.991*sigmaSquare1)
-                    continue;
-            }
-            else
-            {
-                float u1 = fx1*x1*invz1+cx1;
-                float u1_r = u1 - mpCurrentKeyFrame->mbf*invz1;
-                float v1 = fy1*y1*invz1+cy1;
-                float errX1 = u1 - kp1.pt.x;
-                float errY1 = v1 - kp1.pt.y;
-                float errX1_r = u1_r - kp1_ur;
-                if((errX1*errX1+errY1*errY1+errX1_r*errX1_r)>7.8*sigmaSquare1)
-                    continue;
-            }
+    // Triangulate each match, with fixed-size Eigen types only
+    const int nmatches = vMatchedIndices.size();
+    for(int ikp=0; ikp<nmatches; ikp++)
+    {
+        const int &idx1 = vMatchedIndices[ikp].first;
+        const int &idx2 = vMatchedIndices[ikp].second;
 
-            //Check reprojection error in second keyframe
-            const float sigmaSquare2 = pKF2->mvLevelSigma2[kp2.octave];
-            const float x2 = Rcw2.row(0).dot(x3Dt)+tcw2.at<float>(0);
-            const float y2 = Rcw2.row(1).dot(x3Dt)+tcw2.at<float>(1);
-            const float invz2 = 1.0/z2;
-            if(!bStereo2)
-            {
-                float u2 = fx2*x2*invz2+cx2;
-                float v2 = fy2*y2*invz2+cy2;
-                float errX2 = u2 - kp2.pt.x;
-                float errY2 = v2 - kp2.pt.y;
-                if((errX2*errX2+errY2*errY2)>5.991*sigmaSquare2)
-                    continue;
-            }
-            else
-            {
-                float u2 = fx2*x2*invz2+cx2;
-                float u2_r = u2 - mpCurrentKeyFrame->mbf*invz2;
-                float v2 = fy2*y2*invz2+cy2;
-                float errX2 = u2 - kp2.pt.x;
-                float errY2 = v2 - kp2.pt.y;
-                float errX2_r = u2_r - kp2_ur;
-                if((errX2*errX2+errY2*errY2+errX2_r*errX2_r)>7.8*sigmaSquare2)
-                    continue;
-            }
+        const cv::KeyPoint &kp1 = mpCurrentKeyFrame->mvKeysUn[idx1];
+        const float kp1_ur=mpCurrentKeyFrame->mvuRight[idx1];
+        bool bStereo1 = kp1_ur>=0;
 
-            //Check scale consistency
-            cv::Mat normal1 = x3D-Ow1;
-            float dist1 = cv::norm(normal1);
+        const cv::KeyPoint &kp2 = pKF2->mvKeysUn[idx2];
+        const float kp2_ur = pKF2->mvuRight[idx2];
+        bool bStereo2 = kp2_ur>=0;
 
-            cv::Mat normal2 = x3D-Ow2;
-            float dist2 = cv::norm(normal2);
+        // Check parallax between rays
+        const Eigen::Vector3f xn1((kp1.pt.x-cx1)*invfx1, (kp1.pt.y-cy1)*invfy1, 1.0f);
+        const Eigen::Vector3f xn2((kp2.pt.x-cx2)*invfx2, (kp2.pt.y-cy2)*invfy2, 1.0f);
 
-            if(dist1==0 || dist2==0)
-                continue;
+        const Eigen::Vector3f ray1 = Rwc1*xn1;
+        const Eigen::Vector3f ray2 = Rwc2*xn2;
+        const float cosParallaxRays = ray1.dot(ray2)/(ray1.norm()*ray2.norm());
 
-            const float ratioDist = dist2/dist1;
-            const float ratioOctave = mpCurrentKeyFrame->mvScaleFactors[kp1.octave]/pKF2->mvScaleFactors[kp2.octave];
+        float cosParallaxStereo = cosParallaxRays+1;
+        float cosParallaxStereo1 = cosParallaxStereo;
+        float cosParallaxStereo2 = cosParallaxStereo;
 
-            /*if(fabs(ratioDist-ratioOctave)>ratioFactor)
-                continue;*/
-            if(ratioDist*ratioFactor<ratioOctave || ratioDist>ratioOctave*ratioFactor)
-                continue;
+        if(bStereo1)
+            cosParallaxStereo1 = cos(2*atan2(mpCurrentKeyFrame->mb/2,mpCurrentKeyFrame->mvDepth[idx1]));
+        else if(bStereo2)
+            cosParallaxStereo2 = cos(2*atan2(pKF2->mb/2,pKF2->mvDepth[idx2]));
 
-            // Triangulation is succesfull
-            MapPoint* pMP = new MapPoint(x3D,mpCurrentKeyFrame,mpMap);
+        cosParallaxStereo = min(cosParallaxStereo1,cosParallaxStereo2);
 
-            pMP->AddObservation(mpCurrentKeyFrame,idx1);            
-            pMP->AddObservation(pKF2,idx2);
+        Eigen::Vector3f x3D;
+        if(cosParallaxRays<cosParallaxStereo && cosParallaxRays>0 && (bStereo1 || bStereo2 || cosParallaxRays<0.9998))
+        {
+            // Linear Triangulation Method
+            if(!Triangulation::DLT(Tcw1,xn1(0),xn1(1),Tcw2,xn2(0),xn2(1),x3D))
+                continue;
+        }
+        else if(bStereo1 && cosParallaxStereo1<cosParallaxStereo2)
+        {
+            if(!mpCurrentKeyFrame->UnprojectStereo(idx1,x3D))
+                continue;
+        }
+        else if(bStereo2 && cosParallaxStereo2<cosParallaxStereo1)
+        {
+            if(!pKF2->UnprojectStereo(idx2,x3D))
+                continue;
+        }
+        else
+            continue; //No stereo and very low parallax
 
-            mpCurrentKeyFrame->AddMapPoint(pMP,idx1);
-            pKF2->AddMapPoint(pMP,idx2);
+        //Check triangulation in front of cameras
+        const Eigen::Vector3f x3Dc1 = Rcw1*x3D+tcw1;
+        const float z1 = x3Dc1(2);
+        if(z1<=0)
+            continue;
 
-            pMP->ComputeDistinctiveDescriptors();
+        const Eigen::Vector3f x3Dc2 = Rcw2*x3D+tcw2;
+        const float z2 = x3Dc2(2);
+        if(z2<=0)
+            continue;
 
-            pMP->UpdateNormalAndDepth();
+        //Check reprojection error in first keyframe
+        const float &sigmaSquare1 = mpCurrentKeyFrame->mvLevelSigma2[kp1.octave];
+        const float err1 = Triangulation::ReprojectionError2(x3Dc1,fx1,fy1,cx1,cy1,kp1.pt.x,kp1.pt.y);
 
-            mpMap->AddMapPoint(pMP);
-            mlpRecentAddedMapPoints.push_back(pMP);
+        if(!bStereo1)
+        {
+            if(err1>5.991*sigmaSquare1)
+                continue;
+        }
+        else
+        {
+            const float u1_r = fx1*x3Dc1(0)/z1+cx1 - mpCurrentKeyFrame->mbf/z1;
+            const float errX1_r = u1_r - kp1_ur;
+            if((err1+errX1_r*errX1_r)>7.8*sigmaSquare1)
+                continue;
+        }
 
-            nnew++;
+        //Check reprojection error in second keyframe
+        const float sigmaSquare2 = pKF2->mvLevelSigma2[kp2.octave];
+        const float err2 = Triangulation::ReprojectionError2(x3Dc2,fx2,fy2,cx2,cy2,kp2.pt.x,kp2.pt.y);
+        if(!bStereo2)
+        {
+            if(err2>5.991*sigmaSquare2)
+                continue;
+        }
+        else
+        {
+            const float u2_r = fx2*x3Dc2(0)/z2+cx2 - mpCurrentKeyFrame->mbf/z2;
+            const float errX2_r = u2_r - kp2_ur;
+            if((err2+errX2_r*errX2_r)>7.8*sigmaSquare2)
+                continue;
         }
+
+        //Check scale consistency
+        const float dist1 = (x3D-Ow1).norm();
+        const float dist2 = (x3D-Ow2).norm();
+
+        if(dist1==0 || dist2==0)
+            continue;
+
+        const float ratioDist = dist2/dist1;
+        const float ratioOctave = mpCurrentKeyFrame->mvScaleFactors[kp1.octave]/pKF2->mvScaleFactors[kp2.octave];
+
+        /*if(fabs(ratioDist-ratioOctave)>ratioFactor)
+            continue;*/
+        if(ratioDist*ratioFactor<ratioOctave || ratioDist>ratioOctave*ratioFactor)
+            continue;
+
+        TriangulatedPoint point;
+        point.idx1 = idx1;
+        point.idx2 = idx2;
+        point.x3D = x3D;
+        vPoints.push_back(point);
     }
 }
 
@@ -479,15 +493,19 @@ void LocalMapping::SearchInNeighbors()
     }
 
 
-    // Search matches by projection from current KF in target KFs
+    // Search matches by projection from current KF in target KFs. The searches only read
+    // the map and run in parallel, the matches are then applied serially in target order.
     ORBmatcher matcher;
     vector<MapPoint*> vpMapPointMatches = mpCurrentKeyFrame->GetMapPointMatches();
-    for(vector<KeyFrame*>::iterator vit=vpTargetKFs.begin(), vend=vpTargetKFs.end(); vit!=vend; vit++)
+    const int nTargets = vpTargetKFs.size();
+    vector<vector<pair<MapPoint*,size_t> > > vvFuseMatches(nTargets);
+    ThreadPool::ParallelFor(nTargets,ThreadPool::NumThreads(),[&](int i)
     {
-        KeyFrame* pKFi = *vit;
+        matcher.SearchFuse(vpTargetKFs[i],vpMapPointMatches,vvFuseMatches[i]);
+    });
 
-        matcher.Fuse(pKFi,vpMapPointMatches);
-    }
+    for(int i=0; i<nTargets; i++)
+        ORBmatcher::ApplyFuse(vpTargetKFs[i],vvFuseMatches[i]);
 
     // Search matches by projection from target KFs in current KF
     vector<MapPoint*> vpFuseCandidates;
@@ -511,12 +529,25 @@ void LocalMapping::SearchInNeighbors()
         }
     }
 
-    matcher.Fuse(mpCurrentKeyFrame,vpFuseCandidates);
+    // Same for the candidates in the current KF, split in contiguous chunks
+    const int nThreads = ThreadPool::NumThreads();
+    const int nChunk = (vpFuseCandidates.size()+nThreads-1)/nThreads;
+    vector<vector<pair<MapPoint*,size_t> > > vvCandidateMatches(nThreads);
+    ThreadPool::ParallelFor(nThreads,nThreads,[&](int t)
+    {
+        const size_t iBegin = min(vpFuseCandidates.size(),static_cast<size_t>(t*nChunk));
+        const size_t iEnd = min(vpFuseCandidates.size(),iBegin+nChunk);
+        const vector<MapPoint*> vpChunk(vpFuseCandidates.begin()+iBegin,vpFuseCandidates.begin()+iEnd);
+        matcher.SearchFuse(mpCurrentKeyFrame,vpChunk,vvCandidateMatches[t]);
+    });
+
+    for(int t=0; t<nThreads; t++)
+        ORBmatcher::ApplyFuse(mpCurrentKeyFrame,vvCandidateMatches[t]);
 
 
-    // Update points
+    // Update points, each point only locks itself
     vpMapPointMatches = mpCurrentKeyFrame->GetMapPointMatches();
-    for(size_t i=0, iend=vpMapPointMatches.size(); i<iend; i++)
+    ThreadPool::ParallelFor(vpMapPointMatches.size(),nThreads,[&](int i)
     {
         MapPoint* pMP=vpMapPointMatches[i];
         if(pMP)
@@ -527,7 +558,7 @@ void LocalMapping::SearchInNeighbors()
                 pMP->UpdateNormalAndDepth();
             }
         }
-    }
+    });
 
     // Update connections in covisibility graph
     mpCurrentKeyFrame->UpdateConnections();
@@ -558,6 +589,7 @@ void LocalMapping::RequestStop()
     mbStopRequested = true;
     unique_lock<mutex> lock2(mMutexNewKFs);
     mbAbortBA = true;
+    mCondNewKFs.notify_one();
 }
 
 bool LocalMapping::Stop()
@@ -664,24 +696,9 @@ void LocalMapping::KeyFrameCulling()
                     nMPs++;
                     if(pMP->Observations()>thObs)
                     {
+                        // other keyframes seeing the point in the same or finer scale
                         const int &scaleLevel = pKF->mvKeysUn[i].octave;
-                        const map<KeyFrame*, size_t> observations = pMP->GetObservations();
-                        int nObs=0;
-                        for(map<KeyFrame*, size_t>::const_iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
-                        {
-                            KeyFrame* pKFi = mit->first;
-                            if(pKFi==pKF)
-                                continue;
-                            const int &scaleLeveli = pKFi->mvKeysUn[mit->second].octave;
-
-                            if(scaleLeveli<=scaleLevel+1)
-                            {
-                                nObs++;
-                                if(nObs>=thObs)
-                                    break;
-                            }
-                        }
-                        if(nObs>=thObs)
+                        if(pMP->ObservationsUpToLevel(scaleLevel+1,pKF)>=thObs)
                         {
                             nRedundantObservations++;
                         }
@@ -708,6 +725,7 @@ void LocalMapping::RequestReset()
         unique_lock<mutex> lock(mMutexReset);
         mbResetRequested = true;
     }
+    mCondNewKFs.notify_one();
 
     while(1)
     {
@@ -718,6 +736,9 @@ void LocalMapping::RequestReset()
         }
         usleep(3000);
     }
+
+    // The map is cleared next, which frees the KeyFrames and MapPoints the window points to
+    assert(mpLocalBAWindow->Empty());
 }
 
 void LocalMapping::ResetIfRequested()
@@ -727,14 +748,18 @@ void LocalMapping::ResetIfRequested()
     {
         mlNewKeyFrames.clear();
         mlpRecentAddedMapPoints.clear();
+        mpLocalBAWindow->Clear();
         mbResetRequested=false;
     }
 }
 
 void LocalMapping::RequestFinish()
 {
-    unique_lock<mutex> lock(mMutexFinish);
-    mbFinishRequested = true;
+    {
+        unique_lock<mutex> lock(mMutexFinish);
+        mbFinishRequested = true;
+    }
+    mCondNewKFs.notify_one();
 }
 
 bool LocalMapping::CheckFinish()
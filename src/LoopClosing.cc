@@ -27,7 +27,10 @@
 #include "Optimizer.h"
 
 #include "ORBmatcher.h"
+
+#include "ThreadPool.h"
 #include <unistd.h>
+#include<algorithm>
 #include<mutex>
 #include<thread>
 
@@ -38,7 +41,7 @@ namespace ORB_SLAM2
 LoopClosing::LoopClosing(Map *pMap, KeyFrameDatabase *pDB, ORBVocabulary *pVoc, const bool bFixScale):
     mbResetRequested(false), mbFinishRequested(false), mbFinished(true), mpMap(pMap),
     mpKeyFrameDB(pDB), mpORBVocabulary(pVoc), mpMatchedKF(NULL), mLastLoopKFid(0), mbRunningGBA(false), mbFinishedGBA(true),
-    mbStopGBA(false), mpThreadGBA(NULL), mbFixScale(bFixScale), mnFullBAIdx(0)
+    mbStopGBA(false), mpThreadGBA(NULL), mnLastGBAKFid(0), mbFixScale(bFixScale), mnFullBAIdx(0)
 {
     mnCovisibilityConsistencyTh = 3;
 }
@@ -234,21 +237,9 @@ bool LoopClosing::ComputeSim3()
 
     const int nInitialCandidates = mvpEnoughConsistentCandidates.size();
 
-    // We compute first ORB matches for each candidate
-    // If enough matches are found, we setup a Sim3Solver
-    ORBmatcher matcher(0.75,true);
-
-    vector<Sim3Solver*> vpSim3Solvers;
-    vpSim3Solvers.resize(nInitialCandidates);
-
-    vector<vector<MapPoint*> > vvpMapPointMatches;
-    vvpMapPointMatches.resize(nInitialCandidates);
-
-    vector<bool> vbDiscarded;
-    vbDiscarded.resize(nInitialCandidates);
-
-    int nCandidates=0; //candidates with enough matches
-
+    // Rank candidates by BoW similarity, the most similar ones are verified first
+    vector<pair<float,KeyFrame*> > vScoreAndCandidate;
+    vScoreAndCandidate.reserve(nInitialCandidates);
     for(int i=0; i<nInitialCandidates; i++)
     {
         KeyFrame* pKF = mvpEnoughConsistentCandidates[i];
@@ -257,91 +248,46 @@ bool LoopClosing::ComputeSim3()
         pKF->SetNotErase();
 
         if(pKF->isBad())
-        {
-            vbDiscarded[i] = true;
             continue;
-        }
-
-        int nmatches = matcher.SearchByBoW(mpCurrentKF,pKF,vvpMapPointMatches[i]);
 
-        if(nmatches<20)
-        {
-            vbDiscarded[i] = true;
-            continue;
-        }
-        else
-        {
-            Sim3Solver* pSolver = new Sim3Solver(mpCurrentKF,pKF,vvpMapPointMatches[i],mbFixScale);
-            pSolver->SetRansacParameters(0.99,20,300);
-            vpSim3Solvers[i] = pSolver;
-        }
-
-        nCandidates++;
+        vScoreAndCandidate.push_back(make_pair(mpORBVocabulary->score(mpCurrentKF->mBowVec,pKF->mBowVec),pKF));
     }
-
-    bool bMatch = false;
-
-    // Perform alternatively RANSAC iterations for each candidate
-    // until one is succesful or all fail
-    while(nCandidates>0 && !bMatch)
+    stable_sort(vScoreAndCandidate.begin(),vScoreAndCandidate.end(),
+                [](const pair<float,KeyFrame*> &a, const pair<float,KeyFrame*> &b){ return a.first>b.first; });
+
+    // The candidates are verified in parallel, each result is kept by rank and the best
+    // ranked accepted candidate wins, whatever the timing. An accepted candidate only stops
+    // the candidates ranked after it, the better ranked ones still run to the end.
+    const int nRanked = vScoreAndCandidate.size();
+    vector<g2o::Sim3> vgScm(nRanked);
+    vector<vector<MapPoint*> > vvpMapPointMatches(nRanked);
+    atomic<int> nBestRank(nRanked);
+
+    ThreadPool::ParallelFor(nRanked,ThreadPool::NumThreads(),[&](int i)
     {
-        for(int i=0; i<nInitialCandidates; i++)
-        {
-            if(vbDiscarded[i])
-                continue;
-
-            KeyFrame* pKF = mvpEnoughConsistentCandidates[i];
-
-            // Perform 5 Ransac Iterations
-            vector<bool> vbInliers;
-            int nInliers;
-            bool bNoMore;
-
-            Sim3Solver* pSolver = vpSim3Solvers[i];
-            cv::Mat Scm  = pSolver->iterate(5,bNoMore,vbInliers,nInliers);
-
-            // If Ransac reachs max. iterations discard keyframe
-            if(bNoMore)
-            {
-                vbDiscarded[i]=true;
-                nCandidates--;
-            }
-
-            // If RANSAC returns a Sim3, perform a guided matching and optimize with all correspondences
-            if(!Scm.empty())
-            {
-                vector<MapPoint*> vpMapPointMatches(vvpMapPointMatches[i].size(), static_cast<MapPoint*>(NULL));
-                for(size_t j=0, jend=vbInliers.size(); j<jend; j++)
-                {
-                    if(vbInliers[j])
-                       vpMapPointMatches[j]=vvpMapPointMatches[i][j];
-                }
-
-                cv::Mat R = pSolver->GetEstimatedRotation();
-                cv::Mat t = pSolver->GetEstimatedTranslation();
-                const float s = pSolver->GetEstimatedScale();
-                matcher.SearchBySim3(mpCurrentKF,pKF,vpMapPointMatches,s,R,t,7.5);
-
-                g2o::Sim3 gScm(Converter::toMatrix3d(R),Converter::toVector3d(t),s);
-                const int nInliers = Optimizer::OptimizeSim3(mpCurrentKF, pKF, vpMapPointMatches, gScm, 10, mbFixScale);
+        if(nBestRank<i)
+            return;
+        if(!VerifyLoopCandidate(vScoreAndCandidate[i].second,i,nBestRank,vgScm[i],vvpMapPointMatches[i]))
+            return;
 
-                // If optimization is succesful stop ransacs and continue
-                if(nInliers>=20)
-                {
-                    bMatch = true;
-                    mpMatchedKF = pKF;
-                    g2o::Sim3 gSmw(Converter::toMatrix3d(pKF->GetRotation()),Converter::toVector3d(pKF->GetTranslation()),1.0);
-                    mg2oScw = gScm*gSmw;
-                    mScw = Converter::toCvMat(mg2oScw);
+        int nBest = nBestRank;
+        while(i<nBest && !nBestRank.compare_exchange_weak(nBest,i))
+            ;
+    });
 
-                    mvpCurrentMatchedPoints = vpMapPointMatches;
-                    break;
-                }
-            }
-        }
+    const bool bMatch = nBestRank<nRanked;
+    if(bMatch)
+    {
+        const int i = nBestRank;
+        KeyFrame* pKF = vScoreAndCandidate[i].second;
+        mpMatchedKF = pKF;
+        g2o::Sim3 gSmw(Converter::toMatrix3d(pKF->GetRotation()),Converter::toVector3d(pKF->GetTranslation()),1.0);
+        mg2oScw = vgScm[i]*gSmw;
+        mScw = Converter::toCvMat(mg2oScw);
+
+        mvpCurrentMatchedPoints = vvpMapPointMatches[i];
     }
-
-    if(!bMatch)
+    else
     {
         for(int i=0; i<nInitialCandidates; i++)
              mvpEnoughConsistentCandidates[i]->SetErase();
@@ -349,6 +295,8 @@ bool LoopClosing::ComputeSim3()
         return false;
     }
 
+    ORBmatcher matcher(0.75,true);
+
     // Retrieve MapPoints seen in Loop Keyframe and neighbors
     vector<KeyFrame*> vpLoopConnectedKFs = mpMatchedKF->GetVectorCovisibleKeyFrames();
     vpLoopConnectedKFs.push_back(mpMatchedKF);
@@ -399,6 +347,58 @@ bool LoopClosing::ComputeSim3()
 
 }
 
+bool LoopClosing::VerifyLoopCandidate(KeyFrame* pKF, const int nRank, const atomic<int> &nBestRank,
+                                      g2o::Sim3 &gScm, vector<MapPoint*> &vpMapPointMatches)
+{
+    // We compute first ORB matches with the candidate
+    // If enough matches are found, we setup a Sim3Solver
+    ORBmatcher matcher(0.75,true);
+
+    vector<MapPoint*> vpBoWMatches;
+    const int nmatches = matcher.SearchByBoW(mpCurrentKF,pKF,vpBoWMatches);
+    if(nmatches<20)
+        return false;
+
+    Sim3Solver solver(mpCurrentKF,pKF,vpBoWMatches,mbFixScale);
+    solver.SetRansacParameters(0.99,20,300);
+    solver.SetSeed(0,pKF->mnId);
+
+    // Perform RANSAC iterations until the candidate is accepted or discarded,
+    // checking every 5 iterations whether a better ranked candidate has already been accepted
+    bool bNoMore = false;
+    while(!bNoMore && nBestRank>nRank)
+    {
+        vector<bool> vbInliers;
+        int nInliers;
+        cv::Mat Scm  = solver.iterate(5,bNoMore,vbInliers,nInliers);
+
+        // If RANSAC returns a Sim3, perform a guided matching and optimize with all correspondences
+        if(Scm.empty())
+            continue;
+
+        vpMapPointMatches.assign(vpBoWMatches.size(), static_cast<MapPoint*>(NULL));
+        for(size_t j=0, jend=vbInliers.size(); j<jend; j++)
+        {
+            if(vbInliers[j])
+               vpMapPointMatches[j]=vpBoWMatches[j];
+        }
+
+        cv::Mat R = solver.GetEstimatedRotation();
+        cv::Mat t = solver.GetEstimatedTranslation();
+        const float s = solver.GetEstimatedScale();
+        matcher.SearchBySim3(mpCurrentKF,pKF,vpMapPointMatches,s,R,t,7.5);
+
+        gScm = g2o::Sim3(Converter::toMatrix3d(R),Converter::toVector3d(t),s);
+        const int nOptInliers = Optimizer::OptimizeSim3(mpCurrentKF, pKF, vpMapPointMatches, gScm, 10, mbFixScale);
+
+        // If optimization is succesful stop ransacs and continue
+        if(nOptInliers>=20)
+            return true;
+    }
+
+    return false;
+}
+
 void LoopClosing::CorrectLoop()
 {
     cout << "Loop detected!" << endl;
@@ -638,6 +638,10 @@ void LoopClosing::ResetIfRequested()
     {
         mlpLoopKeyFrameQueue.clear();
         mLastLoopKFid=0;
+        {
+            unique_lock<mutex> lock2(mMutexGBA);
+            mnLastGBAKFid=0;
+        }
         mbResetRequested=false;
     }
 }
@@ -647,7 +651,12 @@ void LoopClosing::RunGlobalBundleAdjustment(unsigned long nLoopKF)
     cout << "Starting Global Bundle Adjustment" << endl;
 
     int idx =  mnFullBAIdx;
-    Optimizer::GlobalBundleAdjustemnt(mpMap,10,&mbStopGBA,nLoopKF,false);
+    unsigned long nLastGBAKFid;
+    {
+        unique_lock<mutex> lock(mMutexGBA);
+        nLastGBAKFid = mnLastGBAKFid;
+    }
+    const unsigned long nMaxKFid = Optimizer::IncrementalGlobalBundleAdjustment(mpMap,10,&mbStopGBA,nLoopKF,nLastGBAKFid);
 
     // Update all MapPoints and KeyFrames
     // Local Mapping was active during BA, that means that there might be new keyframes
@@ -670,8 +679,11 @@ void LoopClosing::RunGlobalBundleAdjustment(unsigned long nLoopKF)
                 usleep(1000);
             }
 
-            // Get Map Mutex
-            unique_lock<mutex> lock(mpMap->mMutexMapUpdate);
+            // The corrected poses are computed first without the map mutex, Local Mapping is
+            // stopped so no one else changes keyframe poses or the spanning tree. Tracking is
+            // only blocked while the results are written to the map.
+            vector<KeyFrame*> vpCorrectedKFs;
+            map<KeyFrame*,cv::Mat> mCorrectedTwc;
 
             // Correct keyframes starting at map first keyframe
             list<KeyFrame*> lpKFtoCheck(mpMap->mvpKeyFrameOrigins.begin(),mpMap->mvpKeyFrameOrigins.end());
@@ -695,12 +707,24 @@ void LoopClosing::RunGlobalBundleAdjustment(unsigned long nLoopKF)
                 }
 
                 pKF->mTcwBefGBA = pKF->GetPose();
-                pKF->SetPose(pKF->mTcwGBA);
+                vpCorrectedKFs.push_back(pKF);
+
+                cv::Mat Rwc = pKF->mTcwGBA.rowRange(0,3).colRange(0,3).t();
+                cv::Mat twc = -Rwc*pKF->mTcwGBA.rowRange(0,3).col(3);
+                cv::Mat Twc_corrected = cv::Mat::eye(4,4,CV_32F);
+                Rwc.copyTo(Twc_corrected.rowRange(0,3).colRange(0,3));
+                twc.copyTo(Twc_corrected.rowRange(0,3).col(3));
+                mCorrectedTwc[pKF] = Twc_corrected;
+
                 lpKFtoCheck.pop_front();
             }
 
             // Correct MapPoints
             const vector<MapPoint*> vpMPs = mpMap->GetAllMapPoints();
+            vector<MapPoint*> vpCorrectedMPs;
+            vector<cv::Mat> vCorrectedPos;
+            vpCorrectedMPs.reserve(vpMPs.size());
+            vCorrectedPos.reserve(vpMPs.size());
 
             for(size_t i=0; i<vpMPs.size(); i++)
             {
@@ -712,7 +736,8 @@ void LoopClosing::RunGlobalBundleAdjustment(unsigned long nLoopKF)
                 if(pMP->mnBAGlobalForKF==nLoopKF)
                 {
                     // If optimized by Global BA, just update
-                    pMP->SetWorldPos(pMP->mPosGBA);
+                    vpCorrectedMPs.push_back(pMP);
+                    vCorrectedPos.push_back(pMP->mPosGBA);
                 }
                 else
                 {
@@ -722,24 +747,42 @@ void LoopClosing::RunGlobalBundleAdjustment(unsigned long nLoopKF)
                     if(pRefKF->mnBAGlobalForKF!=nLoopKF)
                         continue;
 
+                    map<KeyFrame*,cv::Mat>::const_iterator mit = mCorrectedTwc.find(pRefKF);
+                    if(mit==mCorrectedTwc.end())
+                        continue;
+
                     // Map to non-corrected camera
                     cv::Mat Rcw = pRefKF->mTcwBefGBA.rowRange(0,3).colRange(0,3);
                     cv::Mat tcw = pRefKF->mTcwBefGBA.rowRange(0,3).col(3);
                     cv::Mat Xc = Rcw*pMP->GetWorldPos()+tcw;
 
                     // Backproject using corrected camera
-                    cv::Mat Twc = pRefKF->GetPoseInverse();
+                    const cv::Mat &Twc = mit->second;
                     cv::Mat Rwc = Twc.rowRange(0,3).colRange(0,3);
                     cv::Mat twc = Twc.rowRange(0,3).col(3);
 
-                    pMP->SetWorldPos(Rwc*Xc+twc);
+                    vpCorrectedMPs.push_back(pMP);
+                    vCorrectedPos.push_back(Rwc*Xc+twc);
                 }
-            }            
+            }
+
+            {
+                // Get Map Mutex
+                unique_lock<mutex> lock(mpMap->mMutexMapUpdate);
+
+                for(size_t i=0; i<vpCorrectedKFs.size(); i++)
+                    vpCorrectedKFs[i]->SetPose(vpCorrectedKFs[i]->mTcwGBA);
+
+                for(size_t i=0; i<vpCorrectedMPs.size(); i++)
+                    vpCorrectedMPs[i]->SetWorldPos(vCorrectedPos[i]);
+            }
 
             mpMap->InformNewBigChange();
 
             mpLocalMapper->Release();
 
+            mnLastGBAKFid = nMaxKFid;
+
             cout << "Map updated!" << endl;
         }
 
@@ -35,10 +35,36 @@ Map::Map(int initKFid):mnInitKFid(initKFid), mnMaxKFid(initKFid)
     mnId=nNextId++;
 }
 
+// Inserts p into the dense array unless it is already there
+template <class T>
+static void InsertDense(T* p, vector<T*> &vp, vector<int> &vnPos)
+{
+    if(p->mnHandle>=vnPos.size())
+        vnPos.resize(max(p->mnHandle+1,2*vnPos.size()),-1);
+    if(vnPos[p->mnHandle]>=0)
+        return;
+    vnPos[p->mnHandle] = vp.size();
+    vp.push_back(p);
+}
+
+// Moves the last element into the place of p
+template <class T>
+static void EraseDense(T* p, vector<T*> &vp, vector<int> &vnPos)
+{
+    if(p->mnHandle>=vnPos.size() || vnPos[p->mnHandle]<0)
+        return;
+    const int pos = vnPos[p->mnHandle];
+    T* pLast = vp.back();
+    vp[pos] = pLast;
+    vnPos[pLast->mnHandle] = pos;
+    vp.pop_back();
+    vnPos[p->mnHandle] = -1;
+}
+
 void Map::AddKeyFrame(KeyFrame *pKF)
 {
     unique_lock<mutex> lock(mMutexMap);
-    mspKeyFrames.insert(pKF);
+    InsertDense(pKF,mvpKeyFrames,mvnKeyFramePos);
     if(pKF->mnId>mnMaxKFid)
         mnMaxKFid=pKF->mnId;
 }
@@ -46,13 +72,13 @@ void Map::AddKeyFrame(KeyFrame *pKF)
 void Map::AddMapPoint(MapPoint *pMP)
 {
     unique_lock<mutex> lock(mMutexMap);
-    mspMapPoints.insert(pMP);
+    InsertDense(pMP,mvpMapPoints,mvnMapPointPos);
 }
 
 void Map::EraseMapPoint(MapPoint *pMP)
 {
     unique_lock<mutex> lock(mMutexMap);
-    mspMapPoints.erase(pMP);
+    EraseDense(pMP,mvpMapPoints,mvnMapPointPos);
 
     // TODO: This only erase the pointer.
     // Delete the MapPoint
@@ -61,7 +87,7 @@ void Map::EraseMapPoint(MapPoint *pMP)
 void Map::EraseKeyFrame(KeyFrame *pKF)
 {
     unique_lock<mutex> lock(mMutexMap);
-    mspKeyFrames.erase(pKF);
+    EraseDense(pKF,mvpKeyFrames,mvnKeyFramePos);
 
     // TODO: This only erase the pointer.
     // Delete the MapPoint
@@ -88,25 +114,37 @@ int Map::GetLastBigChangeIdx()
 vector<KeyFrame*> Map::GetAllKeyFrames()
 {
     unique_lock<mutex> lock(mMutexMap);
-    return vector<KeyFrame*>(mspKeyFrames.begin(),mspKeyFrames.end());
+    return mvpKeyFrames;
 }
 
 vector<MapPoint*> Map::GetAllMapPoints()
 {
     unique_lock<mutex> lock(mMutexMap);
-    return vector<MapPoint*>(mspMapPoints.begin(),mspMapPoints.end());
+    return mvpMapPoints;
+}
+
+void Map::GetAllKeyFrames(vector<KeyFrame*> &vpKFs)
+{
+    unique_lock<mutex> lock(mMutexMap);
+    vpKFs.assign(mvpKeyFrames.begin(),mvpKeyFrames.end());
+}
+
+void Map::GetAllMapPoints(vector<MapPoint*> &vpMPs)
+{
+    unique_lock<mutex> lock(mMutexMap);
+    vpMPs.assign(mvpMapPoints.begin(),mvpMapPoints.end());
 }
 
 long unsigned int Map::MapPointsInMap()
 {
     unique_lock<mutex> lock(mMutexMap);
-    return mspMapPoints.size();
+    return mvpMapPoints.size();
 }
 
 long unsigned int Map::KeyFramesInMap()
 {
     unique_lock<mutex> lock(mMutexMap);
-    return mspKeyFrames.size();
+    return mvpKeyFrames.size();
 }
 
 vector<MapPoint*> Map::GetReferenceMapPoints()
@@ -183,14 +221,17 @@ long unsigned int Map::GetInitKFid()
 
 void Map::clear()
 {
-    for(set<MapPoint*>::iterator sit=mspMapPoints.begin(), send=mspMapPoints.end(); sit!=send; sit++)
-        delete *sit;
+    // the memory goes back to the MapPoint/KeyFrame pools
+    for(size_t i=0; i<mvpMapPoints.size(); i++)
+        delete mvpMapPoints[i];
 
-    for(set<KeyFrame*>::iterator sit=mspKeyFrames.begin(), send=mspKeyFrames.end(); sit!=send; sit++)
-        delete *sit;
+    for(size_t i=0; i<mvpKeyFrames.size(); i++)
+        delete mvpKeyFrames[i];
 
-    mspMapPoints.clear();
-    mspKeyFrames.clear();
+    mvpMapPoints.clear();
+    mvpKeyFrames.clear();
+    mvnMapPointPos.clear();
+    mvnKeyFramePos.clear();
     mnMaxKFid = 0;
     mvpReferenceMapPoints.clear();
     mvpKeyFrameOrigins.clear();
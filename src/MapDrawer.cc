@@ -43,21 +43,25 @@ MapDrawer::MapDrawer(Map* pMap, const string &strSettingPath):mpMap(pMap)
 
 void MapDrawer::DrawMapPoints()
 {
-    const vector<MapPoint*> &vpMPs = mpMap->GetAllMapPoints();
+    mpMap->GetAllMapPoints(mvpMapPoints);
+    const vector<MapPoint*> &vpMPs = mvpMapPoints;
     const vector<MapPoint*> &vpRefMPs = mpMap->GetReferenceMapPoints();
 
-    set<MapPoint*> spRefMPs(vpRefMPs.begin(), vpRefMPs.end());
-
     if(vpMPs.empty())
         return;
 
+    mvbReferenceMP.resize(ObjectPool<MapPoint>::Instance().Capacity(),0);
+    for(size_t i=0, iend=vpRefMPs.size(); i<iend;i++)
+        if(vpRefMPs[i])
+            mvbReferenceMP[vpRefMPs[i]->mnHandle] = 1;
+
     glPointSize(mPointSize);
     glBegin(GL_POINTS);
     glColor3f(0.0,0.0,0.0);
 
     for(size_t i=0, iend=vpMPs.size(); i<iend;i++)
     {
-        if(vpMPs[i]->isBad() || spRefMPs.count(vpMPs[i]))
+        if(vpMPs[i]->isBad() || mvbReferenceMP[vpMPs[i]->mnHandle])
             continue;
         cv::Mat pos = vpMPs[i]->GetWorldPos();
         glVertex3f(pos.at<float>(0),pos.at<float>(1),pos.at<float>(2));
@@ -68,11 +72,16 @@ void MapDrawer::DrawMapPoints()
     glBegin(GL_POINTS);
     glColor3f(1.0,0.0,0.0);
 
-    for(set<MapPoint*>::iterator sit=spRefMPs.begin(), send=spRefMPs.end(); sit!=send; sit++)
+    for(size_t i=0, iend=vpRefMPs.size(); i<iend;i++)
     {
-        if((*sit)->isBad())
+        MapPoint* pMP = vpRefMPs[i];
+        if(!pMP || !mvbReferenceMP[pMP->mnHandle])
+            continue;
+        // reset the flag for the next frame, this also skips duplicates
+        mvbReferenceMP[pMP->mnHandle] = 0;
+        if(pMP->isBad())
             continue;
-        cv::Mat pos = (*sit)->GetWorldPos();
+        cv::Mat pos = pMP->GetWorldPos();
         glVertex3f(pos.at<float>(0),pos.at<float>(1),pos.at<float>(2));
 
     }
@@ -86,7 +95,8 @@ void MapDrawer::DrawKeyFrames(const bool bDrawKF, const bool bDrawGraph)
     const float h = w*0.75;
     const float z = w*0.6;
 
-    const vector<KeyFrame*> vpKFs = mpMap->GetAllKeyFrames();
+    mpMap->GetAllKeyFrames(mvpKeyFrames);
+    const vector<KeyFrame*> &vpKFs = mvpKeyFrames;
 
     if(bDrawKF)
     {
@@ -20,8 +20,10 @@
 
 #include "MapPoint.h"
 #include "ORBmatcher.h"
+#include "MapPointStore.h"
 
 #include<mutex>
+#include<algorithm>
 
 namespace ORB_SLAM2
 {
@@ -50,6 +52,11 @@ MapPoint::MapPoint(const cv::Mat &Pos, KeyFrame *pRefKF, Map* pMap)
     , mfMaxDistance(0)
     , mpMap(pMap)
 {
+    mnHandle = ObjectPool<MapPoint>::HandleOf(this);
+    MapPointStore& store = MapPointStore::Instance();
+    store.Reset(mnHandle);
+    std::fill(mvnObsPerLevel,mvnObsPerLevel+MAX_OBS_LEVELS,0);
+
     mMovingProbability = 0.5;
     mStaticProbability = 0.5;
     mnObservedDynamic = 0;
@@ -57,6 +64,7 @@ MapPoint::MapPoint(const cv::Mat &Pos, KeyFrame *pRefKF, Map* pMap)
 
     Pos.copyTo(mWorldPos);
     mNormalVector = cv::Mat::zeros(3,1,CV_32F);
+    store.SetWorldPos(mnHandle,mWorldPos);
 
     // MapPoints can be created from Tracking and Local Mapping. This mutex avoid conflicts with id.
     unique_lock<mutex> lock(mpMap->mMutexPointCreation);
@@ -69,6 +77,11 @@ MapPoint::MapPoint(const cv::Mat &Pos, Map* pMap, Frame* pFrame, const int &idxF
     mnCorrectedReference(0), mnBAGlobalForKF(0), mpRefKF(static_cast<KeyFrame*>(NULL)), mnVisible(1),
     mnFound(1), mbBad(false), mpReplaced(NULL), mpMap(pMap)
 {
+    mnHandle = ObjectPool<MapPoint>::HandleOf(this);
+    MapPointStore& store = MapPointStore::Instance();
+    store.Reset(mnHandle);
+    std::fill(mvnObsPerLevel,mvnObsPerLevel+MAX_OBS_LEVELS,0);
+
     Pos.copyTo(mWorldPos);
     cv::Mat Ow = pFrame->GetCameraCenter();
     mNormalVector = mWorldPos - Ow;
@@ -85,6 +98,10 @@ MapPoint::MapPoint(const cv::Mat &Pos, Map* pMap, Frame* pFrame, const int &idxF
 
     pFrame->mDescriptors.row(idxF).copyTo(mDescriptor);
 
+    store.SetWorldPos(mnHandle,mWorldPos);
+    store.SetNormalAndDepth(mnHandle,mNormalVector,mfMinDistance,mfMaxDistance);
+    store.SetDescriptor(mnHandle,mDescriptor);
+
     // MapPoints can be created from Tracking and Local Mapping. This mutex avoid conflicts with id.
     unique_lock<mutex> lock(mpMap->mMutexPointCreation);
     mnId=nNextId++;
@@ -95,18 +112,29 @@ void MapPoint::SetWorldPos(const cv::Mat &Pos)
     unique_lock<mutex> lock2(mGlobalMutex);
     unique_lock<mutex> lock(mMutexPos);
     Pos.copyTo(mWorldPos);
+    MapPointStore::Instance().SetWorldPos(mnHandle,mWorldPos);
 }
 
 cv::Mat MapPoint::GetWorldPos()
 {
-    unique_lock<mutex> lock(mMutexPos);
-    return mWorldPos.clone();
+    cv::Mat Pos(3,1,CV_32F);
+    MapPointStore::Instance().GetWorldPos(mnHandle,Pos.ptr<float>(0));
+    return Pos;
+}
+
+Eigen::Vector3f MapPoint::GetWorldPosEigen()
+{
+    Eigen::Vector3f Pos;
+    MapPointStore::Instance().GetWorldPos(mnHandle,Pos.data());
+    return Pos;
 }
 
 cv::Mat MapPoint::GetNormal()
 {
-    unique_lock<mutex> lock(mMutexPos);
-    return mNormalVector.clone();
+    cv::Mat Normal(3,1,CV_32F);
+    float P[3], fMinDistance, fMaxDistance;
+    MapPointStore::Instance().GetGeometry(mnHandle,P,Normal.ptr<float>(0),fMinDistance,fMaxDistance);
+    return Normal;
 }
 
 KeyFrame* MapPoint::GetReferenceKeyFrame()
@@ -115,12 +143,23 @@ KeyFrame* MapPoint::GetReferenceKeyFrame()
     return mpRefKF;
 }
 
+MapPoint::ObservationList::iterator MapPoint::FindObservation(KeyFrame* pKF)
+{
+    ObservationList::iterator it=mObservations.begin();
+    for(ObservationList::iterator itend=mObservations.end(); it!=itend; it++)
+        if(it->first==pKF)
+            break;
+    return it;
+}
+
 void MapPoint::AddObservation(KeyFrame* pKF, size_t idx)
 {
     unique_lock<mutex> lock(mMutexFeatures);
-    if(mObservations.count(pKF))
+    if(FindObservation(pKF)!=mObservations.end())
         return;
-    mObservations[pKF]=idx;
+    mObservations.push_back(Observation(pKF,idx));
+    mvnObsPerLevel[ObsLevel(pKF,idx)]++;
+    mMedoid.Offer(pKF,idx,pKF->mDescriptors.ptr<uint8_t>(idx));
 
     if(pKF->mvuRight[idx]>=0)
         nObs+=2;
@@ -133,15 +172,18 @@ void MapPoint::EraseObservation(KeyFrame* pKF)
     bool bBad=false;
     {
         unique_lock<mutex> lock(mMutexFeatures);
-        if(mObservations.count(pKF))
+        ObservationList::iterator it = FindObservation(pKF);
+        if(it!=mObservations.end())
         {
-            int idx = mObservations[pKF];
+            int idx = it->second;
             if(pKF->mvuRight[idx]>=0)
                 nObs-=2;
             else
                 nObs--;
+            mvnObsPerLevel[ObsLevel(pKF,idx)]--;
+            mMedoid.Erase(pKF,idx);
 
-            mObservations.erase(pKF);
+            mObservations.erase(it);
 
             if(mpRefKF==pKF)
                 mpRefKF=mObservations.begin()->first;
@@ -156,7 +198,7 @@ void MapPoint::EraseObservation(KeyFrame* pKF)
         SetBadFlag();
 }
 
-map<KeyFrame*, size_t> MapPoint::GetObservations()
+MapPoint::ObservationList MapPoint::GetObservations()
 {
     unique_lock<mutex> lock(mMutexFeatures);
     return mObservations;
@@ -168,17 +210,41 @@ int MapPoint::Observations()
     return nObs;
 }
 
+int MapPoint::ObsLevel(KeyFrame* pKF, size_t idx)
+{
+    return std::min(pKF->mvKeysUn[idx].octave,MAX_OBS_LEVELS-1);
+}
+
+int MapPoint::ObservationsUpToLevel(int maxLevel, KeyFrame* pKF)
+{
+    if(maxLevel<0)
+        return 0;
+    const int nLevels = std::min(maxLevel+1,MAX_OBS_LEVELS);
+
+    unique_lock<mutex> lock(mMutexFeatures);
+    int n=0;
+    for(int l=0; l<nLevels; l++)
+        n+=mvnObsPerLevel[l];
+
+    ObservationList::iterator it = FindObservation(pKF);
+    if(it!=mObservations.end() && ObsLevel(pKF,it->second)<nLevels)
+        n--;
+    return n;
+}
+
 void MapPoint::SetBadFlag()
 {
-    map<KeyFrame*,size_t> obs;
+    ObservationList obs;
     {
         unique_lock<mutex> lock1(mMutexFeatures);
         unique_lock<mutex> lock2(mMutexPos);
         mbBad=true;
         obs = mObservations;
         mObservations.clear();
+        std::fill(mvnObsPerLevel,mvnObsPerLevel+MAX_OBS_LEVELS,0);
+        mMedoid.Clear();
     }
-    for(map<KeyFrame*,size_t>::iterator mit=obs.begin(), mend=obs.end(); mit!=mend; mit++)
+    for(ObservationList::iterator mit=obs.begin(), mend=obs.end(); mit!=mend; mit++)
     {
         KeyFrame* pKF = mit->first;
         pKF->EraseMapPointMatch(mit->second);
@@ -200,19 +266,21 @@ void MapPoint::Replace(MapPoint* pMP)
         return;
 
     int nvisible, nfound;
-    map<KeyFrame*,size_t> obs;
+    ObservationList obs;
     {
         unique_lock<mutex> lock1(mMutexFeatures);
         unique_lock<mutex> lock2(mMutexPos);
         obs=mObservations;
         mObservations.clear();
+        std::fill(mvnObsPerLevel,mvnObsPerLevel+MAX_OBS_LEVELS,0);
+        mMedoid.Clear();
         mbBad=true;
         nvisible = mnVisible;
         nfound = mnFound;
         mpReplaced = pMP;
     }
 
-    for(map<KeyFrame*,size_t>::iterator mit=obs.begin(), mend=obs.end(); mit!=mend; mit++)
+    for(ObservationList::iterator mit=obs.begin(), mend=obs.end(); mit!=mend; mit++)
     {
         // Replace measurement in keyframe
         KeyFrame* pKF = mit->first;
@@ -261,69 +329,18 @@ float MapPoint::GetFoundRatio()
 
 void MapPoint::ComputeDistinctiveDescriptors()
 {
-    // Retrieve all observed descriptors
-    vector<cv::Mat> vDescriptors;
-
-    map<KeyFrame*,size_t> observations;
-
-    {
-        unique_lock<mutex> lock1(mMutexFeatures);
-        if(mbBad)
-            return;
-        observations=mObservations;
-    }
-
-    if(observations.empty())
+    // The sample follows AddObservation/EraseObservation, only its medoid is read here
+    unique_lock<mutex> lock(mMutexFeatures);
+    if(mbBad)
         return;
 
-    vDescriptors.reserve(observations.size());
-
-    for(map<KeyFrame*,size_t>::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
-    {
-        KeyFrame* pKF = mit->first;
-
-        if(!pKF->isBad())
-            vDescriptors.push_back(pKF->mDescriptors.row(mit->second));
-    }
-
-    if(vDescriptors.empty())
+    // Take the descriptor with least distance to the rest
+    const int BestIdx = mMedoid.Best();
+    if(BestIdx<0)
         return;
 
-    // Compute distances between them
-    const size_t N = vDescriptors.size();
-
-    float Distances[N][N];
-    for(size_t i=0;i<N;i++)
-    {
-        Distances[i][i]=0;
-        for(size_t j=i+1;j<N;j++)
-        {
-            int distij = ORBmatcher::DescriptorDistance(vDescriptors[i],vDescriptors[j]);
-            Distances[i][j]=distij;
-            Distances[j][i]=distij;
-        }
-    }
-
-    // Take the descriptor with least median distance to the rest
-    int BestMedian = INT_MAX;
-    int BestIdx = 0;
-    for(size_t i=0;i<N;i++)
-    {
-        vector<int> vDists(Distances[i],Distances[i]+N);
-        sort(vDists.begin(),vDists.end());
-        int median = vDists[0.5*(N-1)];
-
-        if(median<BestMedian)
-        {
-            BestMedian = median;
-            BestIdx = i;
-        }
-    }
-
-    {
-        unique_lock<mutex> lock(mMutexFeatures);
-        mDescriptor = vDescriptors[BestIdx].clone();
-    }
+    mDescriptor = cv::Mat(1,DescriptorMedoid::DESC_BYTES,CV_8U,(void*)mMedoid.GetDescriptor(BestIdx)).clone();
+    MapPointStore::Instance().SetDescriptor(mnHandle,mDescriptor);
 }
 
 cv::Mat MapPoint::GetDescriptor()
@@ -335,8 +352,9 @@ cv::Mat MapPoint::GetDescriptor()
 int MapPoint::GetIndexInKeyFrame(KeyFrame *pKF)
 {
     unique_lock<mutex> lock(mMutexFeatures);
-    if(mObservations.count(pKF))
-        return mObservations[pKF];
+    ObservationList::iterator it = FindObservation(pKF);
+    if(it!=mObservations.end())
+        return it->second;
     else
         return -1;
 }
@@ -344,14 +362,15 @@ int MapPoint::GetIndexInKeyFrame(KeyFrame *pKF)
 bool MapPoint::IsInKeyFrame(KeyFrame *pKF)
 {
     unique_lock<mutex> lock(mMutexFeatures);
-    return (mObservations.count(pKF));
+    return FindObservation(pKF)!=mObservations.end();
 }
 
 void MapPoint::UpdateNormalAndDepth()
 {
-    map<KeyFrame*,size_t> observations;
+    ObservationList observations;
     KeyFrame* pRefKF;
-    cv::Mat Pos;
+    size_t nRefIdx = 0;
+    Eigen::Vector3f Pos;
     {
         unique_lock<mutex> lock1(mMutexFeatures);
         unique_lock<mutex> lock2(mMutexPos);
@@ -359,26 +378,27 @@ void MapPoint::UpdateNormalAndDepth()
             return;
         observations=mObservations;
         pRefKF=mpRefKF;
-        Pos = mWorldPos.clone();
+        ObservationList::iterator it = FindObservation(pRefKF);
+        if(it!=mObservations.end())
+            nRefIdx = it->second;
+        Pos = Eigen::Map<const Eigen::Vector3f>(mWorldPos.ptr<float>(0));
     }
 
     if(observations.empty())
         return;
 
-    cv::Mat normal = cv::Mat::zeros(3,1,CV_32F);
+    Eigen::Vector3f normal = Eigen::Vector3f::Zero();
     int n=0;
-    for(map<KeyFrame*,size_t>::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+    for(ObservationList::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
     {
         KeyFrame* pKF = mit->first;
-        cv::Mat Owi = pKF->GetCameraCenter();
-        cv::Mat normali = mWorldPos - Owi;
-        normal = normal + normali/cv::norm(normali);
+        const Eigen::Vector3f normali = Pos - pKF->GetCameraCenterEigen();
+        normal += normali/normali.norm();
         n++;
     }
 
-    cv::Mat PC = Pos - pRefKF->GetCameraCenter();
-    const float dist = cv::norm(PC);
-    const int level = pRefKF->mvKeysUn[observations[pRefKF]].octave;
+    const float dist = (Pos - pRefKF->GetCameraCenterEigen()).norm();
+    const int level = pRefKF->mvKeysUn[nRefIdx].octave;
     const float levelScaleFactor =  pRefKF->mvScaleFactors[level];
     const int nLevels = pRefKF->mnScaleLevels;
 
@@ -386,29 +406,30 @@ void MapPoint::UpdateNormalAndDepth()
         unique_lock<mutex> lock3(mMutexPos);
         mfMaxDistance = dist*levelScaleFactor;
         mfMinDistance = mfMaxDistance/pRefKF->mvScaleFactors[nLevels-1];
-        mNormalVector = normal/n;
+        mNormalVector = (cv::Mat_<float>(3,1) << normal(0)/n, normal(1)/n, normal(2)/n);
+        MapPointStore::Instance().SetNormalAndDepth(mnHandle,mNormalVector,mfMinDistance,mfMaxDistance);
     }
 }
 
 float MapPoint::GetMinDistanceInvariance()
 {
-    unique_lock<mutex> lock(mMutexPos);
-    return 0.8f*mfMinDistance;
+    float fMinDistance, fMaxDistance;
+    MapPointStore::Instance().GetDistances(mnHandle,fMinDistance,fMaxDistance);
+    return 0.8f*fMinDistance;
 }
 
 float MapPoint::GetMaxDistanceInvariance()
 {
-    unique_lock<mutex> lock(mMutexPos);
-    return 1.2f*mfMaxDistance;
+    float fMinDistance, fMaxDistance;
+    MapPointStore::Instance().GetDistances(mnHandle,fMinDistance,fMaxDistance);
+    return 1.2f*fMaxDistance;
 }
 
 int MapPoint::PredictScale(const float &currentDist, KeyFrame* pKF)
 {
-    float ratio;
-    {
-        unique_lock<mutex> lock(mMutexPos);
-        ratio = mfMaxDistance/currentDist;
-    }
+    float fMinDistance, fMaxDistance;
+    MapPointStore::Instance().GetDistances(mnHandle,fMinDistance,fMaxDistance);
+    const float ratio = fMaxDistance/currentDist;
 
     int nScale = ceil(log(ratio)/pKF->mfLogScaleFactor);
     if(nScale<0)
@@ -421,11 +442,9 @@ int MapPoint::PredictScale(const float &currentDist, KeyFrame* pKF)
 
 int MapPoint::PredictScale(const float &currentDist, Frame* pF)
 {
-    float ratio;
-    {
-        unique_lock<mutex> lock(mMutexPos);
-        ratio = mfMaxDistance/currentDist;
-    }
+    float fMinDistance, fMaxDistance;
+    MapPointStore::Instance().GetDistances(mnHandle,fMinDistance,fMaxDistance);
+    const float ratio = fMaxDistance/currentDist;
 
     int nScale = ceil(log(ratio)/pF->mfLogScaleFactor);
     if(nScale<0)
@@ -450,6 +469,7 @@ void MapPoint::SetMovingProbability(const float& in_mp)
 {
     unique_lock<mutex> lock(mMutexFeatures);
     mMovingProbability = in_mp;
+    MapPointStore::Instance().SetMovingProbability(mnHandle,in_mp);
 }
 
 float MapPoint::GetMovingProbability()
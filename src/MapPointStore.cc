@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#include "MapPointStore.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <new>
+
+namespace ORB_SLAM2 {
+
+static const std::memory_order relaxed = std::memory_order_relaxed;
+
+MapPointStore& MapPointStore::Instance()
+{
+    // never destroyed, like the MapPoint pool
+    static MapPointStore* pStore = new MapPointStore();
+    return *pStore;
+}
+
+MapPointStore::Directory::Directory()
+{
+    for (size_t i = 0; i < DIR_CHUNKS; i++)
+        vpChunks[i].store(NULL, relaxed);
+}
+
+MapPointStore::MapPointStore()
+{
+    for (size_t i = 0; i < MAX_DIRS; i++)
+        mpDirs[i].store(NULL, relaxed);
+}
+
+void MapPointStore::Reset(size_t h)
+{
+    if (h >= MAX_HANDLES)
+        throw std::bad_alloc();
+
+    const size_t c = h / CHUNK;
+    std::atomic<Directory*>& dir = mpDirs[c / DIR_CHUNKS];
+    if (!dir.load(std::memory_order_acquire) ||
+        !dir.load(std::memory_order_acquire)->vpChunks[c % DIR_CHUNKS].load(std::memory_order_acquire)) {
+        std::unique_lock<std::mutex> lock(mMutexChunks);
+        if (!dir.load(relaxed))
+            dir.store(new Directory, std::memory_order_release);
+        std::atomic<Chunk*>& chunk = dir.load(relaxed)->vpChunks[c % DIR_CHUNKS];
+        if (!chunk.load(relaxed))
+            chunk.store(new Chunk, std::memory_order_release);
+    }
+
+    Chunk& C = GetChunk(h);
+    const size_t i = h % CHUNK;
+    C.vSeqGeometry[i].BeginWrite();
+    C.vX[i].store(0, relaxed);
+    C.vY[i].store(0, relaxed);
+    C.vZ[i].store(0, relaxed);
+    C.vNx[i].store(0, relaxed);
+    C.vNy[i].store(0, relaxed);
+    C.vNz[i].store(0, relaxed);
+    C.vMinDistance[i].store(0, relaxed);
+    C.vMaxDistance[i].store(0, relaxed);
+    C.vSeqGeometry[i].EndWrite();
+
+    C.vSeqDescriptor[i].BeginWrite();
+    for (int k = 0; k < DESC_BYTES / 8; k++)
+        C.vDescriptor[i][k].store(0, relaxed);
+    C.vSeqDescriptor[i].EndWrite();
+
+    C.vMovingProbability[i].store(0.5f, relaxed);
+}
+
+void MapPointStore::SetWorldPos(size_t h, const cv::Mat& Pos)
+{
+    Chunk& C = GetChunk(h);
+    const size_t i = h % CHUNK;
+    C.vSeqGeometry[i].BeginWrite();
+    C.vX[i].store(Pos.at<float>(0), relaxed);
+    C.vY[i].store(Pos.at<float>(1), relaxed);
+    C.vZ[i].store(Pos.at<float>(2), relaxed);
+    C.vSeqGeometry[i].EndWrite();
+}
+
+void MapPointStore::SetNormalAndDepth(size_t h, const cv::Mat& Normal, float fMinDistance, float fMaxDistance)
+{
+    Chunk& C = GetChunk(h);
+    const size_t i = h % CHUNK;
+    C.vSeqGeometry[i].BeginWrite();
+    C.vNx[i].store(Normal.at<float>(0), relaxed);
+    C.vNy[i].store(Normal.at<float>(1), relaxed);
+    C.vNz[i].store(Normal.at<float>(2), relaxed);
+    C.vMinDistance[i].store(fMinDistance, relaxed);
+    C.vMaxDistance[i].store(fMaxDistance, relaxed);
+    C.vSeqGeometry[i].EndWrite();
+}
+
+void MapPointStore::SetDescriptor(size_t h, const cv::Mat& Descriptor)
+{
+    assert(Descriptor.type() == CV_8U && Descriptor.total() == (size_t)DESC_BYTES);
+    uint64_t d[DESC_BYTES / 8];
+    memcpy(d, Descriptor.ptr<unsigned char>(0), DESC_BYTES);
+
+    Chunk& C = GetChunk(h);
+    const size_t i = h % CHUNK;
+    C.vSeqDescriptor[i].BeginWrite();
+    for (int k = 0; k < DESC_BYTES / 8; k++)
+        C.vDescriptor[i][k].store(d[k], relaxed);
+    C.vSeqDescriptor[i].EndWrite();
+}
+
+void MapPointStore::SetMovingProbability(size_t h, float p)
+{
+    GetChunk(h).vMovingProbability[h % CHUNK].store(p, relaxed);
+}
+
+void MapPointStore::GetGeometry(size_t h, float* P, float* Normal, float& fMinDistance, float& fMaxDistance) const
+{
+    const Chunk& C = GetChunk(h);
+    const size_t i = h % CHUNK;
+    unsigned int s;
+    do {
+        s = C.vSeqGeometry[i].BeginRead();
+        P[0] = C.vX[i].load(relaxed);
+        P[1] = C.vY[i].load(relaxed);
+        P[2] = C.vZ[i].load(relaxed);
+        Normal[0] = C.vNx[i].load(relaxed);
+        Normal[1] = C.vNy[i].load(relaxed);
+        Normal[2] = C.vNz[i].load(relaxed);
+        fMinDistance = C.vMinDistance[i].load(relaxed);
+        fMaxDistance = C.vMaxDistance[i].load(relaxed);
+    } while (!C.vSeqGeometry[i].EndRead(s));
+}
+
+void MapPointStore::GetWorldPos(size_t h, float* P) const
+{
+    const Chunk& C = GetChunk(h);
+    const size_t i = h % CHUNK;
+    unsigned int s;
+    do {
+        s = C.vSeqGeometry[i].BeginRead();
+        P[0] = C.vX[i].load(relaxed);
+        P[1] = C.vY[i].load(relaxed);
+        P[2] = C.vZ[i].load(relaxed);
+    } while (!C.vSeqGeometry[i].EndRead(s));
+}
+
+void MapPointStore::GetDistances(size_t h, float& fMinDistance, float& fMaxDistance) const
+{
+    const Chunk& C = GetChunk(h);
+    const size_t i = h % CHUNK;
+    unsigned int s;
+    do {
+        s = C.vSeqGeometry[i].BeginRead();
+        fMinDistance = C.vMinDistance[i].load(relaxed);
+        fMaxDistance = C.vMaxDistance[i].load(relaxed);
+    } while (!C.vSeqGeometry[i].EndRead(s));
+}
+
+void MapPointStore::GetDescriptor(size_t h, unsigned char* Descriptor) const
+{
+    const Chunk& C = GetChunk(h);
+    const size_t i = h % CHUNK;
+    uint64_t d[DESC_BYTES / 8];
+    unsigned int s;
+    do {
+        s = C.vSeqDescriptor[i].BeginRead();
+        for (int k = 0; k < DESC_BYTES / 8; k++)
+            d[k] = C.vDescriptor[i][k].load(relaxed);
+    } while (!C.vSeqDescriptor[i].EndRead(s));
+    memcpy(Descriptor, d, DESC_BYTES);
+}
+
+float MapPointStore::GetMovingProbability(size_t h) const
+{
+    return GetChunk(h).vMovingProbability[h % CHUNK].load(relaxed);
+}
+
+int MapPointStore::PredictScale(float fMaxDistance, float currentDist, float fLogScaleFactor, int nScaleLevels)
+{
+    const float ratio = fMaxDistance / currentDist;
+
+    int nScale = ceil(log(ratio) / fLogScaleFactor);
+    if (nScale < 0)
+        nScale = 0;
+    else if (nScale >= nScaleLevels)
+        nScale = nScaleLevels - 1;
+
+    return nScale;
+}
+
+}  // namespace ORB_SLAM2
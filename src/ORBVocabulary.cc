@@ -0,0 +1,445 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ORBVocabulary.h"
+#include "HammingMatcher.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <iostream>
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ORB_SLAM2
+{
+
+ORBVocabulary::ORBVocabulary(): ORBVocabularyBase(), mpMapping(NULL), mnMappingSize(0),
+    mpNodeDescriptors(NULL), mpChildDescriptors(NULL)
+{
+}
+
+ORBVocabulary::~ORBVocabulary()
+{
+    // the node headers must not outlive the mapping
+    m_words.clear();
+    m_nodes.clear();
+    ReleaseMapping();
+}
+
+void ORBVocabulary::ReleaseMapping()
+{
+    if(mpMapping)
+        munmap(mpMapping,mnMappingSize);
+    mpMapping = NULL;
+    mnMappingSize = 0;
+    mpNodeDescriptors = NULL;
+}
+
+bool ORBVocabulary::loadFromTextFile(const std::string &filename)
+{
+    if(!ORBVocabularyBase::loadFromTextFile(filename))
+        return false;
+
+    ReleaseMapping();
+    BuildDescentCache();
+    return true;
+}
+
+// Binary vocabulary layout (host byte order):
+//
+//   BinaryHeader                       32 bytes
+//   uint32_t parent[nNodes]            parent id (root: 0)
+//   uint32_t wordId[nNodes]            word id, NO_WORD for inner nodes
+//   double   weight[nNodes]
+//   uint8_t  descriptor[nNodes][32]
+//
+// Every array starts at a multiple of 8 bytes, so the file can be used
+// directly from a memory mapping. Node ids are breadth first: the parent of
+// a node has a smaller id, and the leaves are exactly the words.
+namespace
+{
+
+const char BINARY_MAGIC[8] = {'O','R','B','V','O','C','B','1'};
+const uint32_t NO_WORD = 0xFFFFFFFF;
+
+struct BinaryHeader
+{
+    char magic[8];
+    uint32_t k;
+    uint32_t L;
+    uint32_t scoring;
+    uint32_t weighting;
+    uint32_t nNodes;
+    uint32_t nWords;
+};
+
+}
+
+bool ORBVocabulary::load(const std::string &filename)
+{
+    const std::string ext = ".bin";
+    if(filename.size()>ext.size() && filename.compare(filename.size()-ext.size(),ext.size(),ext)==0)
+        return loadFromBinaryFile(filename);
+    return loadFromTextFile(filename);
+}
+
+bool ORBVocabulary::saveToBinaryFile(const std::string &filename) const
+{
+    std::ofstream f(filename.c_str(), std::ios::out | std::ios::binary);
+    if(!f.is_open())
+        return false;
+
+    const uint32_t nNodes = m_nodes.size();
+
+    BinaryHeader header;
+    memcpy(header.magic,BINARY_MAGIC,sizeof(BINARY_MAGIC));
+    header.k = m_k;
+    header.L = m_L;
+    header.scoring = m_scoring;
+    header.weighting = m_weighting;
+    header.nNodes = nNodes;
+    header.nWords = m_words.size();
+    f.write(reinterpret_cast<const char*>(&header),sizeof(header));
+
+    std::vector<uint32_t> vParents(nNodes), vWordIds(nNodes);
+    std::vector<double> vWeights(nNodes);
+    std::vector<uint8_t> vDescriptors(nNodes*HammingMatcher::DESC_BYTES,0);
+    for(uint32_t i=0; i<nNodes; i++)
+    {
+        const Node &node = m_nodes[i];
+        vParents[i] = node.parent;
+        vWordIds[i] = node.word_id<m_words.size() && m_words[node.word_id]==&node ? node.word_id : NO_WORD;
+        vWeights[i] = node.weight;
+        if(!node.descriptor.empty())
+            memcpy(&vDescriptors[i*HammingMatcher::DESC_BYTES],node.descriptor.ptr<uint8_t>(),HammingMatcher::DESC_BYTES);
+    }
+
+    f.write(reinterpret_cast<const char*>(vParents.data()),vParents.size()*sizeof(uint32_t));
+    f.write(reinterpret_cast<const char*>(vWordIds.data()),vWordIds.size()*sizeof(uint32_t));
+    f.write(reinterpret_cast<const char*>(vWeights.data()),vWeights.size()*sizeof(double));
+    f.write(reinterpret_cast<const char*>(vDescriptors.data()),vDescriptors.size());
+
+    return f.good();
+}
+
+bool ORBVocabulary::loadFromBinaryFile(const std::string &filename)
+{
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if(fd<0)
+        return false;
+
+    struct stat st;
+    if(fstat(fd,&st)!=0 || st.st_size<(off_t)sizeof(BinaryHeader))
+    {
+        close(fd);
+        return false;
+    }
+
+    const size_t fileSize = st.st_size;
+    void *pMap = mmap(NULL,fileSize,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if(pMap==MAP_FAILED)
+        return false;
+
+    const uint8_t *pData = static_cast<const uint8_t*>(pMap);
+    BinaryHeader header;
+    memcpy(&header,pData,sizeof(header));
+
+    const size_t nNodes = header.nNodes;
+    const size_t nWords = header.nWords;
+    const size_t expectedSize = sizeof(BinaryHeader) +
+            nNodes*(2*sizeof(uint32_t)+sizeof(double)+HammingMatcher::DESC_BYTES);
+
+    if(memcmp(header.magic,BINARY_MAGIC,sizeof(BINARY_MAGIC))!=0 || fileSize!=expectedSize ||
+       header.k>20 || header.L<1 || header.L>10 || header.scoring>5 || header.weighting>3 ||
+       nNodes==0 || nWords==0 || nWords>=nNodes)
+    {
+        std::cerr << "Vocabulary loading failure: This is not a correct binary file!" << std::endl;
+        munmap(pMap,fileSize);
+        return false;
+    }
+
+    const uint32_t *pParents = reinterpret_cast<const uint32_t*>(pData+sizeof(BinaryHeader));
+    const uint32_t *pWordIds = pParents + nNodes;
+    const double *pWeights = reinterpret_cast<const double*>(pWordIds + nNodes);
+    const uint8_t *pDescriptors = reinterpret_cast<const uint8_t*>(pWeights + nNodes);
+
+    m_k = header.k;
+    m_L = header.L;
+    m_scoring = (DBoW2::ScoringType)header.scoring;
+    m_weighting = (DBoW2::WeightingType)header.weighting;
+    createScoringObject();
+
+    m_words.clear();
+    m_nodes.clear();
+    ReleaseMapping();
+    m_nodes.resize(nNodes);
+    m_words.assign(nWords,static_cast<Node*>(NULL));
+
+    // The mapping stays alive with the vocabulary, the node descriptors are Mat headers on
+    // it and are never copied. It is mapped read only, DBoW2 does not write them.
+    mpMapping = pMap;
+    mnMappingSize = fileSize;
+    mpNodeDescriptors = pDescriptors;
+
+    // Nodes are independent, fill them in parallel chunks
+    const int nChunks = ThreadPool::NumThreads();
+    const size_t nChunk = (nNodes+nChunks-1)/nChunks;
+    std::vector<char> vbChunkValid(nChunks,1);
+    ThreadPool::ParallelFor(nChunks,nChunks,[&](int t)
+    {
+        const size_t iBegin = t*nChunk;
+        const size_t iEnd = std::min(nNodes,iBegin+nChunk);
+        for(size_t i=iBegin; i<iEnd; i++)
+        {
+            Node &node = m_nodes[i];
+            node.id = i;
+            node.parent = pParents[i];
+            node.weight = pWeights[i];
+            node.word_id = 0;
+            if(i==0)
+                continue;   // root has no descriptor
+
+            if(node.parent>=i)
+                vbChunkValid[t] = 0;
+
+            node.descriptor = cv::Mat(1,HammingMatcher::DESC_BYTES,CV_8U,
+                                      const_cast<uint8_t*>(pDescriptors+i*HammingMatcher::DESC_BYTES));
+        }
+    });
+
+    bool bValid = std::find(vbChunkValid.begin(),vbChunkValid.end(),0)==vbChunkValid.end() &&
+                  pWordIds[0]==NO_WORD;
+
+    // Children lists in node id order, as the text loader builds them
+    if(bValid)
+    {
+        std::vector<unsigned int> vnChildren(nNodes,0);
+        for(size_t i=1; i<nNodes; i++)
+            vnChildren[pParents[i]]++;
+        for(size_t i=0; i<nNodes; i++)
+            m_nodes[i].children.reserve(vnChildren[i]);
+        for(size_t i=1; i<nNodes; i++)
+            m_nodes[pParents[i]].children.push_back(i);
+    }
+
+    // Every leaf is one word and every word slot is taken exactly once, so that a
+    // truncated or inconsistent file can not leave NULL words behind
+    size_t nLeaves = 0;
+    for(size_t i=1; i<nNodes && bValid; i++)
+    {
+        const bool bLeaf = m_nodes[i].children.empty();
+        const uint32_t wid = pWordIds[i];
+        if(!bLeaf)
+        {
+            bValid = wid==NO_WORD;
+            continue;
+        }
+
+        nLeaves++;
+        bValid = wid<nWords && !m_words[wid];
+        if(bValid)
+        {
+            m_nodes[i].word_id = wid;
+            m_words[wid] = &m_nodes[i];
+        }
+    }
+    bValid = bValid && nLeaves==nWords;
+
+    if(!bValid)
+    {
+        std::cerr << "Vocabulary loading failure: corrupted binary file!" << std::endl;
+        m_words.clear();
+        m_nodes.clear();
+        ReleaseMapping();
+        BuildDescentCache();
+        return false;
+    }
+
+    BuildDescentCache();
+    return true;
+}
+
+void ORBVocabulary::BuildDescentCache()
+{
+    const size_t nNodes = m_nodes.size();
+    mvChildBegin.assign(nNodes,0);
+    mvChildCount.assign(nNodes,0);
+    mvChildIds.clear();
+    mvChildDescriptors.clear();
+    mpChildDescriptors = NULL;
+
+    if(nNodes==0)
+        return;
+
+    // A binary vocabulary has every children list at consecutive ids in its descriptor
+    // block, which is then used as it is: the child ranges are node ids
+    if(mpNodeDescriptors)
+    {
+        bool bConsecutive = true;
+        for(size_t id=0; id<nNodes && bConsecutive; id++)
+        {
+            const std::vector<DBoW2::NodeId> &children = m_nodes[id].children;
+            bConsecutive = children.empty() || children.back()-children.front()+1==children.size();
+            if(!children.empty())
+                mvChildBegin[id] = children.front();
+            mvChildCount[id] = children.size();
+        }
+
+        if(bConsecutive)
+        {
+            mpChildDescriptors = mpNodeDescriptors;
+            return;
+        }
+    }
+
+    mvChildIds.reserve(nNodes);
+    mvChildDescriptors.reserve(nNodes*HammingMatcher::DESC_BYTES);
+
+    // Breadth first, so that the children blocks of one level are contiguous
+    std::deque<DBoW2::NodeId> queue;
+    queue.push_back(0);
+    while(!queue.empty())
+    {
+        const DBoW2::NodeId id = queue.front();
+        queue.pop_front();
+
+        const std::vector<DBoW2::NodeId> &children = m_nodes[id].children;
+        mvChildBegin[id] = mvChildIds.size();
+        mvChildCount[id] = children.size();
+
+        for(size_t i=0; i<children.size(); i++)
+        {
+            const DBoW2::NodeId cid = children[i];
+            const cv::Mat &d = m_nodes[cid].descriptor;
+            const uint8_t *pd = d.ptr<uint8_t>();
+            mvChildIds.push_back(cid);
+            mvChildDescriptors.insert(mvChildDescriptors.end(),pd,pd+HammingMatcher::DESC_BYTES);
+            queue.push_back(cid);
+        }
+    }
+    mpChildDescriptors = mvChildDescriptors.data();
+}
+
+void ORBVocabulary::Descend(const uint8_t *feature, DBoW2::WordId &word_id, DBoW2::WordValue &weight,
+                            DBoW2::NodeId &nid, const int nid_level) const
+{
+    if(nid_level <= 0) nid = 0; // root
+
+    DBoW2::NodeId final_id = 0; // root
+    int current_level = 0;
+
+    while(mvChildCount[final_id]>0)
+    {
+        ++current_level;
+
+        const unsigned int begin = mvChildBegin[final_id];
+        const unsigned int end = begin + mvChildCount[final_id];
+        const uint8_t *pd = mpChildDescriptors + begin*HammingMatcher::DESC_BYTES;
+
+        unsigned int best = begin;
+        int best_d = HammingMatcher::Distance(feature,pd);
+        pd += HammingMatcher::DESC_BYTES;
+
+        for(unsigned int c=begin+1; c<end; c++, pd+=HammingMatcher::DESC_BYTES)
+        {
+            const int d = HammingMatcher::Distance(feature,pd);
+            if(d < best_d)
+            {
+                best_d = d;
+                best = c;
+            }
+        }
+
+        final_id = mvChildIds.empty() ? best : mvChildIds[best];
+
+        if(current_level == nid_level)
+            nid = final_id;
+    }
+
+    // turn node id into word id
+    word_id = m_nodes[final_id].word_id;
+    weight = m_nodes[final_id].weight;
+}
+
+void ORBVocabulary::transform(const cv::Mat &descriptors, DBoW2::BowVector &v,
+                              DBoW2::FeatureVector &fv, int levelsup) const
+{
+    v.clear();
+    fv.clear();
+
+    if(empty())
+        return;
+
+    if(mvChildCount.size()!=m_nodes.size())
+    {
+        // descent cache not built (e.g. vocabulary created in place), generic path
+        std::vector<cv::Mat> vDesc(descriptors.rows);
+        for(int i=0; i<descriptors.rows; i++)
+            vDesc[i] = descriptors.row(i);
+        ORBVocabularyBase::transform(vDesc,v,fv,levelsup);
+        return;
+    }
+
+    // normalize
+    DBoW2::LNorm norm;
+    const bool must = m_scoring_object->mustNormalize(norm);
+
+    // level at which the node must be stored in fv
+    const int nid_level = m_L - levelsup;
+    const bool bTF = m_weighting == DBoW2::TF || m_weighting == DBoW2::TF_IDF;
+
+    for(int i_feature=0; i_feature<descriptors.rows; i_feature++)
+    {
+        DBoW2::WordId id;
+        DBoW2::NodeId nid = 0;
+        DBoW2::WordValue w;
+        // w is the idf value if TF_IDF, 1 if TF
+
+        Descend(descriptors.ptr<uint8_t>(i_feature),id,w,nid,nid_level);
+
+        if(w > 0) // not stopped
+        {
+            if(bTF)
+                v.addWeight(id, w);
+            else
+                v.addIfNotExist(id, w);
+            fv.addFeature(nid, i_feature);
+        }
+    }
+
+    if(bTF && !v.empty() && !must)
+    {
+        // unnecessary when normalizing
+        const double nd = v.size();
+        for(DBoW2::BowVector::iterator vit = v.begin(); vit != v.end(); vit++)
+            vit->second /= nd;
+    }
+
+    if(must) v.normalize(norm);
+}
+
+} //namespace ORB_SLAM
@@ -29,6 +29,8 @@
 
 #include <stdint-gcc.h>
 #include "Semantic.h"
+#include "HammingMatcher.h"
+#include "MapPointStore.h"
 
 using namespace std;
 
@@ -59,6 +61,8 @@ int ORBmatcher::SearchByProjection(Frame& F, const vector<MapPoint*>& vpMapPoint
     // ================= [semantic] Test==========
     cv::Mat showFeature = F.mImRGB.clone();
 
+    const MapPointStore& store = MapPointStore::Instance();
+
     for(size_t iMP=0; iMP<vpMapPoints.size(); iMP++)    //遍历所有MapPoints
     {
         /*判断该点是否需要投影*/
@@ -92,50 +96,37 @@ int ORBmatcher::SearchByProjection(Frame& F, const vector<MapPoint*>& vpMapPoint
         if(vIndices.empty())
             continue;
 
-        const cv::Mat MPdescriptor = pMP->GetDescriptor();  //求描述子
+        // 描述子直接从MapPointStore读取, 不加锁也不复制cv::Mat
+        unsigned char descriptor[MapPointStore::DESC_BYTES];
+        store.GetDescriptor(pMP->mnHandle,descriptor);
+        const cv::Mat MPdescriptor(1,MapPointStore::DESC_BYTES,CV_8U,descriptor);
 
-        int bestDist=256;
-        int bestLevel= -1;
-        int bestDist2=256;
-        int bestLevel2 = -1;
-        int bestIdx =-1 ;
+        const float maxErrR = r*F.mvScaleFactors[nPredictedLevel];
 
         // Get best and second matches with near keypoints
-        for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
-        {
-            const size_t idx = *vit;
-
-            // 如果Frame中的该兴趣点已经有对应的MapPoint了,则退出该次循环
-            if(F.mvpMapPoints[idx])
-                if(F.mvpMapPoints[idx]->Observations()>0)
-                    continue;
-
-            if(F.mvuRight[idx]>0)
+        // 根据描述子寻找描述子距离最小和次小的特征点
+        const HammingMatcher::Result best = HammingMatcher::SearchBest(MPdescriptor, F.mDescriptors, vIndices,
+            [&](size_t idx)
             {
-                const float er = fabs(pMP->mTrackProjXR-F.mvuRight[idx]);
-                if(er>r*F.mvScaleFactors[nPredictedLevel])
-                    continue;
-            }
-
-            const cv::Mat &d = F.mDescriptors.row(idx);
+                // 如果Frame中的该兴趣点已经有对应的MapPoint了,则跳过
+                if(F.mvpMapPoints[idx])
+                    if(F.mvpMapPoints[idx]->Observations()>0)
+                        return false;
 
-            const int dist = DescriptorDistance(MPdescriptor,d);    //求取描述子距离
+                if(F.mvuRight[idx]>0)
+                {
+                    const float er = fabs(pMP->mTrackProjXR-F.mvuRight[idx]);
+                    if(er>maxErrR)
+                        return false;
+                }
+                return true;
+            });
 
-            // 根据描述子寻找描述子距离最小和次小的特征点
-            if(dist<bestDist)
-            {
-                bestDist2=bestDist;
-                bestDist=dist;
-                bestLevel2 = bestLevel;
-                bestLevel = F.mvKeysUn[idx].octave;
-                bestIdx=idx;
-            }
-            else if(dist<bestDist2) //求次小距离
-            {
-                bestLevel2 = F.mvKeysUn[idx].octave;
-                bestDist2=dist;
-            }
-        }
+        const int bestDist = best.bestDist;
+        const int bestDist2 = best.bestDist2;
+        const int bestIdx = best.bestIdx;
+        const int bestLevel = bestIdx>=0 ? F.mvKeysUn[bestIdx].octave : -1;
+        const int bestLevel2 = best.secondIdx>=0 ? F.mvKeysUn[best.secondIdx].octave : -1;
 
         // Apply ratio to second match (only if best and second are in the same scale level)
         
@@ -145,17 +136,18 @@ int ORBmatcher::SearchByProjection(Frame& F, const vector<MapPoint*>& vpMapPoint
 
             //=========================判断地图点的移动概率=========================
             if(bestLevel != bestLevel2 || bestDist <= mfNNratio * bestDist2){
-                if (pMP->GetMovingProbability() > 0.5) {
+                const float movingProbability = store.GetMovingProbability(pMP->mnHandle);
+                if (movingProbability > 0.5) {
                     // cv::Point uv(pMP->mTrackProjX, pMP->mTrackProjY);
                     cv::Point uv = F.mvKeys[bestIdx].pt;
                     F.mvbKptOutliers[bestIdx] = true;   //是动态点，mvbKptOutliers值就为true
                     cv::circle(showFeature, uv, 5, cv::Scalar(0, 0, 255), -1);  // 动态点是红色
                     continue;
                 }
-                if (pMP->GetMovingProbability() == 0.5) {
+                if (movingProbability == 0.5) {
                     initMatchedPoints.insert(std::pair<int, MapPoint*>(bestIdx, pMP));
                 }
-                if (pMP->GetMovingProbability() < 0.5) {
+                if (movingProbability < 0.5) {
                     F.mvbKptOutliers[bestIdx] = false;
                     //F.mvpMapPoints[bestIdx] = pMP;
                     goodMatchedPoints.insert(std::pair<int, MapPoint*>(bestIdx, pMP));
@@ -279,32 +271,12 @@ int ORBmatcher::SearchByBoW(KeyFrame* pKF,Frame &F, vector<MapPoint*> &vpMapPoin
 
                 const cv::Mat &dKF= pKF->mDescriptors.row(realIdxKF);
 
-                int bestDist1=256;
-                int bestIdxF =-1 ;
-                int bestDist2=256;
-
-                for(size_t iF=0; iF<vIndicesF.size(); iF++)
-                {
-                    const unsigned int realIdxF = vIndicesF[iF];
-
-                    if(vpMapPointMatches[realIdxF])
-                        continue;
-
-                    const cv::Mat &dF = F.mDescriptors.row(realIdxF);
+                const HammingMatcher::Result best = HammingMatcher::SearchBest(dKF, F.mDescriptors, vIndicesF,
+                    [&](size_t realIdxF) { return !vpMapPointMatches[realIdxF]; });
 
-                    const int dist =  DescriptorDistance(dKF,dF);
-
-                    if(dist<bestDist1)
-                    {
-                        bestDist2=bestDist1;
-                        bestDist1=dist;
-                        bestIdxF=realIdxF;
-                    }
-                    else if(dist<bestDist2)
-                    {
-                        bestDist2=dist;
-                    }
-                }
+                const int bestDist1 = best.bestDist;
+                const int bestIdxF = best.bestIdx;
+                const int bestDist2 = best.bestDist2;
 
                 if(bestDist1<=TH_LOW)
                 {
@@ -453,29 +425,19 @@ int ORBmatcher::SearchByProjection(KeyFrame* pKF, cv::Mat Scw, const vector<MapP
         // Match to the most similar keypoint in the radius
         const cv::Mat dMP = pMP->GetDescriptor();
 
-        int bestDist = 256;
-        int bestIdx = -1;
-        for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
-        {
-            const size_t idx = *vit;
-            if(vpMatched[idx])
-                continue;
-
-            const int &kpLevel= pKF->mvKeysUn[idx].octave;
+        const HammingMatcher::Result best = HammingMatcher::SearchBest(dMP, pKF->mDescriptors, vIndices,
+            [&](size_t idx)
+            {
+                if(vpMatched[idx])
+                    return false;
 
-            if(kpLevel<nPredictedLevel-1 || kpLevel>nPredictedLevel)
-                continue;
+                const int &kpLevel= pKF->mvKeysUn[idx].octave;
 
-            const cv::Mat &dKF = pKF->mDescriptors.row(idx);
+                return !(kpLevel<nPredictedLevel-1 || kpLevel>nPredictedLevel);
+            });
 
-            const int dist = DescriptorDistance(dMP,dKF);
-
-            if(dist<bestDist)
-            {
-                bestDist = dist;
-                bestIdx = idx;
-            }
-        }
+        const int bestDist = best.bestDist;
+        const int bestIdx = best.bestIdx;
 
         if(bestDist<=TH_LOW)
         {
@@ -500,6 +462,7 @@ int ORBmatcher::SearchForInitialization(Frame &F1, Frame &F2, vector<cv::Point2f
 
     vector<int> vMatchedDistance(F2.mvKeysUn.size(),INT_MAX);
     vector<int> vnMatches21(F2.mvKeysUn.size(),-1);
+    vector<int> vDistances;
 
     for(size_t i1=0, iend1=F1.mvKeysUn.size(); i1<iend1; i1++)
     {
@@ -513,19 +476,20 @@ int ORBmatcher::SearchForInitialization(Frame &F1, Frame &F2, vector<cv::Point2f
         if(vIndices2.empty())
             continue;
 
-        cv::Mat d1 = F1.mDescriptors.row(i1);
+        // one-vs-many distances of the window, computed in one batch
+        vDistances.resize(vIndices2.size());
+        HammingMatcher::Distances(F1.mDescriptors.ptr<uint8_t>(i1), F2.mDescriptors,
+                                  vIndices2.data(), vIndices2.size(), vDistances.data());
 
         int bestDist = INT_MAX;
         int bestDist2 = INT_MAX;
         int bestIdx2 = -1;
 
-        for(vector<size_t>::iterator vit=vIndices2.begin(); vit!=vIndices2.end(); vit++)
+        for(size_t k=0, kend=vIndices2.size(); k<kend; k++)
         {
-            size_t i2 = *vit;
-
-            cv::Mat d2 = F2.mDescriptors.row(i2);
+            const size_t i2 = vIndices2[k];
 
-            int dist = DescriptorDistance(d1,d2);
+            const int dist = vDistances[k];
 
             if(vMatchedDistance[i2]<=dist)
                 continue;
@@ -649,37 +613,20 @@ int ORBmatcher::SearchByBoW(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint *> &
 
                 const cv::Mat &d1 = Descriptors1.row(idx1);
 
-                int bestDist1=256;
-                int bestIdx2 =-1 ;
-                int bestDist2=256;
-
-                for(size_t i2=0, iend2=f2it->second.size(); i2<iend2; i2++)
-                {
-                    const size_t idx2 = f2it->second[i2];
-
-                    MapPoint* pMP2 = vpMapPoints2[idx2];
-
-                    if(vbMatched2[idx2] || !pMP2)
-                        continue;
-
-                    if(pMP2->isBad())
-                        continue;
+                const HammingMatcher::Result best = HammingMatcher::SearchBest(d1, Descriptors2, f2it->second,
+                    [&](size_t idx2)
+                    {
+                        MapPoint* pMP2 = vpMapPoints2[idx2];
 
-                    const cv::Mat &d2 = Descriptors2.row(idx2);
+                        if(vbMatched2[idx2] || !pMP2)
+                            return false;
 
-                    int dist = DescriptorDistance(d1,d2);
+                        return !pMP2->isBad();
+                    });
 
-                    if(dist<bestDist1)
-                    {
-                        bestDist2=bestDist1;
-                        bestDist1=dist;
-                        bestIdx2=idx2;
-                    }
-                    else if(dist<bestDist2)
-                    {
-                        bestDist2=dist;
-                    }
-                }
+                const int bestDist1 = best.bestDist;
+                const int bestIdx2 = best.bestIdx;
+                const int bestDist2 = best.bestDist2;
 
                 if(bestDist1<TH_LOW)
                 {
@@ -796,7 +743,7 @@ int ORBmatcher::SearchForTriangulation(KeyFrame *pKF1, KeyFrame *pKF2, cv::Mat F
                 
                 const cv::KeyPoint &kp1 = pKF1->mvKeysUn[idx1];
                 
-                const cv::Mat &d1 = pKF1->mDescriptors.row(idx1);
+                const uint8_t* d1 = pKF1->mDescriptors.ptr<uint8_t>(idx1);
                 
                 int bestDist = TH_LOW;
                 int bestIdx2 = -1;
@@ -817,9 +764,7 @@ int ORBmatcher::SearchForTriangulation(KeyFrame *pKF1, KeyFrame *pKF2, cv::Mat F
                         if(!bStereo2)
                             continue;
                     
-                    const cv::Mat &d2 = pKF2->mDescriptors.row(idx2);
-                    
-                    const int dist = DescriptorDistance(d1,d2);
+                    const int dist = HammingMatcher::Distance(d1,pKF2->mDescriptors.ptr<uint8_t>(idx2));
                     
                     if(dist>TH_LOW || dist>bestDist)
                         continue;
@@ -910,6 +855,16 @@ int ORBmatcher::SearchForTriangulation(KeyFrame *pKF1, KeyFrame *pKF2, cv::Mat F
 
 int ORBmatcher::Fuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, const float th)
 {
+    vector<pair<MapPoint*,size_t> > vMatches;
+    SearchFuse(pKF,vpMapPoints,vMatches,th);
+    return ApplyFuse(pKF,vMatches);
+}
+
+void ORBmatcher::SearchFuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, vector<pair<MapPoint*,size_t> > &vMatches,
+                            const float th)
+{
+    vMatches.clear();
+
     cv::Mat Rcw = pKF->GetRotation();
     cv::Mat tcw = pKF->GetTranslation();
 
@@ -921,8 +876,6 @@ int ORBmatcher::Fuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, const
 
     cv::Mat Ow = pKF->GetCameraCenter();
 
-    int nFused=0;
-
     const int nMPs = vpMapPoints.size();
 
     for(int i=0; i<nMPs; i++)
@@ -984,77 +937,89 @@ int ORBmatcher::Fuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, const
 
         const cv::Mat dMP = pMP->GetDescriptor();
 
-        int bestDist = 256;
-        int bestIdx = -1;
-        for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
-        {
-            const size_t idx = *vit;
+        const HammingMatcher::Result best = HammingMatcher::SearchBest(dMP, pKF->mDescriptors, vIndices,
+            [&](size_t idx)
+            {
+                const cv::KeyPoint &kp = pKF->mvKeysUn[idx];
 
-            const cv::KeyPoint &kp = pKF->mvKeysUn[idx];
+                const int &kpLevel= kp.octave;
 
-            const int &kpLevel= kp.octave;
+                if(kpLevel<nPredictedLevel-1 || kpLevel>nPredictedLevel)
+                    return false;
 
-            if(kpLevel<nPredictedLevel-1 || kpLevel>nPredictedLevel)
-                continue;
+                if(pKF->mvuRight[idx]>=0)
+                {
+                    // Check reprojection error in stereo
+                    const float &kpx = kp.pt.x;
+                    const float &kpy = kp.pt.y;
+                    const float &kpr = pKF->mvuRight[idx];
+                    const float ex = u-kpx;
+                    const float ey = v-kpy;
+                    const float er = ur-kpr;
+                    const float e2 = ex*ex+ey*ey+er*er;
+
+                    if(e2*pKF->mvInvLevelSigma2[kpLevel]>7.8)
+                        return false;
+                }
+                else
+                {
+                    const float &kpx = kp.pt.x;
+                    const float &kpy = kp.pt.y;
+                    const float ex = u-kpx;
+                    const float ey = v-kpy;
+                    const float e2 = ex*ex+ey*ey;
+
+                    if(e2*pKF->mvInvLevelSigma2[kpLevel]>5.99)
+                        return false;
+                }
+                return true;
+            });
 
-            if(pKF->mvuRight[idx]>=0)
-            {
-                // Check reprojection error in stereo
-                const float &kpx = kp.pt.x;
-                const float &kpy = kp.pt.y;
-                const float &kpr = pKF->mvuRight[idx];
-                const float ex = u-kpx;
-                const float ey = v-kpy;
-                const float er = ur-kpr;
-                const float e2 = ex*ex+ey*ey+er*er;
-
-                if(e2*pKF->mvInvLevelSigma2[kpLevel]>7.8)
-                    continue;
-            }
-            else
-            {
-                const float &kpx = kp.pt.x;
-                const float &kpy = kp.pt.y;
-                const float ex = u-kpx;
-                const float ey = v-kpy;
-                const float e2 = ex*ex+ey*ey;
+        const int bestDist = best.bestDist;
+        const int bestIdx = best.bestIdx;
 
-                if(e2*pKF->mvInvLevelSigma2[kpLevel]>5.99)
-                    continue;
-            }
+        if(bestDist<=TH_LOW)
+            vMatches.push_back(make_pair(pMP,static_cast<size_t>(bestIdx)));
+    }
+}
 
-            const cv::Mat &dKF = pKF->mDescriptors.row(idx);
+int ORBmatcher::ApplyFuse(KeyFrame *pKF, const vector<pair<MapPoint*,size_t> > &vMatches)
+{
+    int nFused=0;
 
-            const int dist = DescriptorDistance(dMP,dKF);
+    for(size_t i=0, iend=vMatches.size(); i<iend; i++)
+    {
+        MapPoint* pMP = vMatches[i].first;
+        const size_t bestIdx = vMatches[i].second;
 
-            if(dist<bestDist)
-            {
-                bestDist = dist;
-                bestIdx = idx;
-            }
-        }
+        // A previous fusion may have merged this point into another one
+        while(pMP && pMP->isBad())
+            pMP = pMP->GetReplaced();
+        if(!pMP || pMP->IsInKeyFrame(pKF))
+            continue;
+
+        // and changed its descriptor since the search
+        if(DescriptorDistance(pMP->GetDescriptor(),pKF->mDescriptors.row(bestIdx))>TH_LOW)
+            continue;
 
         // If there is already a MapPoint replace otherwise add new measurement
-        if(bestDist<=TH_LOW)
+        MapPoint* pMPinKF = pKF->GetMapPoint(bestIdx);
+        if(pMPinKF)
         {
-            MapPoint* pMPinKF = pKF->GetMapPoint(bestIdx);
-            if(pMPinKF)
-            {
-                if(!pMPinKF->isBad())
-                {
-                    if(pMPinKF->Observations()>pMP->Observations())
-                        pMP->Replace(pMPinKF);
-                    else
-                        pMPinKF->Replace(pMP);
-                }
-            }
-            else
+            if(!pMPinKF->isBad())
             {
-                pMP->AddObservation(pKF,bestIdx);
-                pKF->AddMapPoint(pMP,bestIdx);
+                if(pMPinKF->Observations()>pMP->Observations())
+                    pMP->Replace(pMPinKF);
+                else
+                    pMPinKF->Replace(pMP);
             }
-            nFused++;
         }
+        else
+        {
+            pMP->AddObservation(pKF,bestIdx);
+            pKF->AddMapPoint(pMP,bestIdx);
+        }
+        nFused++;
     }
 
     return nFused;
@@ -1143,26 +1108,16 @@ int ORBmatcher::Fuse(KeyFrame *pKF, cv::Mat Scw, const vector<MapPoint *> &vpPoi
 
         const cv::Mat dMP = pMP->GetDescriptor();
 
-        int bestDist = INT_MAX;
-        int bestIdx = -1;
-        for(vector<size_t>::const_iterator vit=vIndices.begin(); vit!=vIndices.end(); vit++)
-        {
-            const size_t idx = *vit;
-            const int &kpLevel = pKF->mvKeysUn[idx].octave;
-
-            if(kpLevel<nPredictedLevel-1 || kpLevel>nPredictedLevel)
-                continue;
+        const HammingMatcher::Result best = HammingMatcher::SearchBest(dMP, pKF->mDescriptors, vIndices,
+            [&](size_t idx)
+            {
+                const int &kpLevel = pKF->mvKeysUn[idx].octave;
 
-            const cv::Mat &dKF = pKF->mDescriptors.row(idx);
+                return !(kpLevel<nPredictedLevel-1 || kpLevel>nPredictedLevel);
+            }, INT_MAX);
 
-            int dist = DescriptorDistance(dMP,dKF);
-
-            if(dist<bestDist)
-            {
-                bestDist = dist;
-                bestIdx = idx;
-            }
-        }
+        const int bestDist = best.bestDist;
+        const int bestIdx = best.bestIdx;
 
         // If there is already a MapPoint replace otherwise add new measurement
         if(bestDist<=TH_LOW)
@@ -1282,27 +1237,16 @@ int ORBmatcher::SearchBySim3(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint*> &
         // Match to the most similar keypoint in the radius
         const cv::Mat dMP = pMP->GetDescriptor();
 
-        int bestDist = INT_MAX;
-        int bestIdx = -1;
-        for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
-        {
-            const size_t idx = *vit;
-
-            const cv::KeyPoint &kp = pKF2->mvKeysUn[idx];
-
-            if(kp.octave<nPredictedLevel-1 || kp.octave>nPredictedLevel)
-                continue;
-
-            const cv::Mat &dKF = pKF2->mDescriptors.row(idx);
+        const HammingMatcher::Result best = HammingMatcher::SearchBest(dMP, pKF2->mDescriptors, vIndices,
+            [&](size_t idx)
+            {
+                const cv::KeyPoint &kp = pKF2->mvKeysUn[idx];
 
-            const int dist = DescriptorDistance(dMP,dKF);
+                return !(kp.octave<nPredictedLevel-1 || kp.octave>nPredictedLevel);
+            }, INT_MAX);
 
-            if(dist<bestDist)
-            {
-                bestDist = dist;
-                bestIdx = idx;
-            }
-        }
+        const int bestDist = best.bestDist;
+        const int bestIdx = best.bestIdx;
 
         if(bestDist<=TH_HIGH)
         {
@@ -1362,27 +1306,16 @@ int ORBmatcher::SearchBySim3(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint*> &
         // Match to the most similar keypoint in the radius
         const cv::Mat dMP = pMP->GetDescriptor();
 
-        int bestDist = INT_MAX;
-        int bestIdx = -1;
-        for(vector<size_t>::const_iterator vit=vIndices.begin(), vend=vIndices.end(); vit!=vend; vit++)
-        {
-            const size_t idx = *vit;
-
-            const cv::KeyPoint &kp = pKF1->mvKeysUn[idx];
-
-            if(kp.octave<nPredictedLevel-1 || kp.octave>nPredictedLevel)
-                continue;
+        const HammingMatcher::Result best = HammingMatcher::SearchBest(dMP, pKF1->mDescriptors, vIndices,
+            [&](size_t idx)
+            {
+                const cv::KeyPoint &kp = pKF1->mvKeysUn[idx];
 
-            const cv::Mat &dKF = pKF1->mDescriptors.row(idx);
+                return !(kp.octave<nPredictedLevel-1 || kp.octave>nPredictedLevel);
+            }, INT_MAX);
 
-            const int dist = DescriptorDistance(dMP,dKF);
-
-            if(dist<bestDist)
-            {
-                bestDist = dist;
-                bestIdx = idx;
-            }
-        }
+        const int bestDist = best.bestDist;
+        const int bestIdx = best.bestIdx;
 
         if(bestDist<=TH_HIGH)
         {
@@ -1494,34 +1427,26 @@ int ORBmatcher::SearchByProjection(Frame &CurrentFrame, Frame &LastFrame, const
 
                 const cv::Mat dMP = pMP->GetDescriptor();
 
-                int bestDist = 256;
-                int bestIdx2 = -1;
-
-                for(vector<size_t>::const_iterator vit=vIndices2.begin(), vend=vIndices2.end(); vit!=vend; vit++)
-                {
-                    const size_t i2 = *vit;
-                    if(CurrentFrame.mvpMapPoints[i2])
-                        if(CurrentFrame.mvpMapPoints[i2]->Observations()>0)
-                            continue;
+                const float ur = u - CurrentFrame.mbf*invzc;
 
-                    if(CurrentFrame.mvuRight[i2]>0)
+                const HammingMatcher::Result best = HammingMatcher::SearchBest(dMP, CurrentFrame.mDescriptors, vIndices2,
+                    [&](size_t i2)
                     {
-                        const float ur = u - CurrentFrame.mbf*invzc;
-                        const float er = fabs(ur - CurrentFrame.mvuRight[i2]);
-                        if(er>radius)
-                            continue;
-                    }
+                        if(CurrentFrame.mvpMapPoints[i2])
+                            if(CurrentFrame.mvpMapPoints[i2]->Observations()>0)
+                                return false;
 
-                    const cv::Mat &d = CurrentFrame.mDescriptors.row(i2);
+                        if(CurrentFrame.mvuRight[i2]>0)
+                        {
+                            const float er = fabs(ur - CurrentFrame.mvuRight[i2]);
+                            if(er>radius)
+                                return false;
+                        }
+                        return true;
+                    });
 
-                    const int dist = DescriptorDistance(dMP,d);
-
-                    if(dist<bestDist)
-                    {
-                        bestDist=dist;
-                        bestIdx2=i2;
-                    }
-                }
+                const int bestDist = best.bestDist;
+                const int bestIdx2 = best.bestIdx;
 
                 if(bestDist<=TH_HIGH)
                     // CurrentFrame.mvpMapPoints[bestIdx2] = pMP;
@@ -1699,25 +1624,11 @@ int ORBmatcher::SearchByProjection(Frame &CurrentFrame, KeyFrame *pKF, const set
 
                 const cv::Mat dMP = pMP->GetDescriptor();
 
-                int bestDist = 256;
-                int bestIdx2 = -1;
+                const HammingMatcher::Result best = HammingMatcher::SearchBest(dMP, CurrentFrame.mDescriptors, vIndices2,
+                    [&](size_t i2) { return !CurrentFrame.mvpMapPoints[i2]; });
 
-                for(vector<size_t>::const_iterator vit=vIndices2.begin(); vit!=vIndices2.end(); vit++)
-                {
-                    const size_t i2 = *vit;
-                    if(CurrentFrame.mvpMapPoints[i2])
-                        continue;
-
-                    const cv::Mat &d = CurrentFrame.mDescriptors.row(i2);
-
-                    const int dist = DescriptorDistance(dMP,d);
-
-                    if(dist<bestDist)
-                    {
-                        bestDist=dist;
-                        bestIdx2=i2;
-                    }
-                }
+                const int bestDist = best.bestDist;
+                const int bestIdx2 = best.bestIdx;
 
                 if(bestDist<=ORBdist)
                 {
@@ -1809,24 +1720,10 @@ void ORBmatcher::ComputeThreeMaxima(vector<int>* histo, const int L, int &ind1,
 }
 
 
-// Bit set count operation from
-// http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
+// Hamming distance of two 256-bit ORB descriptors, see HammingMatcher
 int ORBmatcher::DescriptorDistance(const cv::Mat &a, const cv::Mat &b)
 {
-    const int *pa = a.ptr<int32_t>();
-    const int *pb = b.ptr<int32_t>();
-
-    int dist=0;
-
-    for(int i=0; i<8; i++, pa++, pb++)
-    {
-        unsigned  int v = *pa ^ *pb;
-        v = v - ((v >> 1) & 0x55555555);
-        v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
-        dist += (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
-    }
-
-    return dist;
+    return HammingMatcher::Distance(a,b);
 }
 
 //==========================================================
@@ -1902,25 +1799,16 @@ int ORBmatcher::SearchByProjection(KeyFrame& CurrentFrame, KeyFrame& LastFrame,
 
                 const cv::Mat dMP = pMP->GetDescriptor();
 
-                int bestDist = 256;
-                int bestIdx2 = -1;
-
-                for (vector<size_t>::const_iterator vit = vIndices2.begin(), vend = vIndices2.end(); vit != vend; vit++) {
-                    const size_t i2 = *vit;
-
-                    if (CurrentFrame.mvpMapPoints[i2])
-                        if (CurrentFrame.mvpMapPoints[i2]->Observations() > 0)
-                            continue;
-
-                    const cv::Mat& d = CurrentFrame.mDescriptors.row(i2);
-
-                    const int dist = DescriptorDistance(dMP, d);
+                const HammingMatcher::Result best = HammingMatcher::SearchBest(dMP, CurrentFrame.mDescriptors, vIndices2,
+                    [&](size_t i2) {
+                        if (CurrentFrame.mvpMapPoints[i2])
+                            if (CurrentFrame.mvpMapPoints[i2]->Observations() > 0)
+                                return false;
+                        return true;
+                    });
 
-                    if (dist < bestDist) {
-                        bestDist = dist;
-                        bestIdx2 = i2;
-                    }
-                }
+                const int bestDist = best.bestDist;
+                const int bestIdx2 = best.bestIdx;
 
                 if (bestDist <= TH_HIGH) {
                     CurrentFrame.mvpMapPoints[bestIdx2] = pMP;
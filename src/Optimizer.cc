@@ -31,12 +31,88 @@
 #include<Eigen/StdVector>
 
 #include "Converter.h"
+#include "LocalBAWindow.h"
 
+#include<algorithm>
 #include<mutex>
 
 namespace ORB_SLAM2
 {
 
+// Linear solver selection.
+// With the points marginalized (Schur complement in the block solver) only the reduced
+// pose system is factorized. Up to MAX_DENSE_POSES poses a dense Cholesky is faster than
+// the sparse one (no ordering/symbolic phase), bigger systems use Eigen's sparse LDLT.
+static const int MAX_DENSE_POSES = 20;
+
+// Eigen sparse solver that keeps its symbolic decomposition across initializeOptimization()
+// calls while the sparsity pattern does not change: in the second round of an optimization
+// after the outliers were removed, and in the local BA, whose solver lives in the
+// LocalBAWindow, between keyframes whose windows have the same pose blocks.
+template <typename MatrixType>
+class LinearSolverEigenReuse : public g2o::LinearSolverEigen<MatrixType>
+{
+public:
+    bool solve(const g2o::SparseBlockMatrix<MatrixType>& A, double* x, double* b)
+    {
+        if(this->_init)
+        {
+            this->_sparseMatrix.resize(A.rows(), A.cols());
+            this->fillSparseMatrix(A, false);
+            if(!SamePattern())
+            {
+                this->computeSymbolicDecomposition(A);
+                const int* outer = this->_sparseMatrix.outerIndexPtr();
+                const int* inner = this->_sparseMatrix.innerIndexPtr();
+                mvOuter.assign(outer, outer+this->_sparseMatrix.outerSize()+1);
+                mvInner.assign(inner, inner+this->_sparseMatrix.nonZeros());
+            }
+            this->_init = false;
+        }
+        else
+        {
+            this->fillSparseMatrix(A, true);
+        }
+
+        this->_cholesky.factorize(this->_sparseMatrix);
+        if(this->_cholesky.info()!=Eigen::Success)
+            return false;
+
+        g2o::VectorXD::MapType xx(x, this->_sparseMatrix.cols());
+        g2o::VectorXD::ConstMapType bb(b, this->_sparseMatrix.cols());
+        xx = this->_cholesky.solve(bb);
+        return true;
+    }
+
+private:
+    bool SamePattern() const
+    {
+        const int nOuter = this->_sparseMatrix.outerSize()+1;
+        const int nInner = this->_sparseMatrix.nonZeros();
+        return static_cast<int>(mvOuter.size())==nOuter && static_cast<int>(mvInner.size())==nInner &&
+               std::equal(mvOuter.begin(), mvOuter.end(), this->_sparseMatrix.outerIndexPtr()) &&
+               std::equal(mvInner.begin(), mvInner.end(), this->_sparseMatrix.innerIndexPtr());
+    }
+
+    std::vector<int> mvOuter;
+    std::vector<int> mvInner;
+};
+
+// Levenberg-Marquardt over BlockSolverType, with the linear solver picked by the number of poses
+template <class BlockSolverType>
+static g2o::OptimizationAlgorithmLevenberg* CreateLevenberg(int nPoses)
+{
+    typedef typename BlockSolverType::PoseMatrixType PoseMatrixType;
+
+    typename BlockSolverType::LinearSolverType* linearSolver;
+    if(nPoses<=MAX_DENSE_POSES)
+        linearSolver = new g2o::LinearSolverDense<PoseMatrixType>();
+    else
+        linearSolver = new LinearSolverEigenReuse<PoseMatrixType>();
+
+    return new g2o::OptimizationAlgorithmLevenberg(new BlockSolverType(linearSolver));
+}
+
 
 void Optimizer::GlobalBundleAdjustemnt(Map* pMap, int nIterations, bool* pbStopFlag, const unsigned long nLoopKF, const bool bRobust)
 {
@@ -45,142 +121,363 @@ void Optimizer::GlobalBundleAdjustemnt(Map* pMap, int nIterations, bool* pbStopF
     BundleAdjustment(vpKFs,vpMP,nIterations,pbStopFlag, nLoopKF, bRobust);
 }
 
-
-void Optimizer::BundleAdjustment(const vector<KeyFrame *> &vpKFs, const vector<MapPoint *> &vpMP,
-                                 int nIterations, bool* pbStopFlag, const unsigned long nLoopKF, const bool bRobust)
+// Fraction of the observations of a keyframe whose reprojection error is above the
+// chi2 thresholds of the bundle adjustments (95%, 2 dof mono / 3 dof stereo)
+static float InconsistentObservationRatio(KeyFrame* pKF)
 {
-    vector<bool> vbNotIncludedMP;
-    vbNotIncludedMP.resize(vpMP.size());
+    const cv::Mat Tcw = pKF->GetPose();
+    const cv::Mat Rcw = Tcw.rowRange(0,3).colRange(0,3);
+    const cv::Mat tcw = Tcw.rowRange(0,3).col(3);
 
-    g2o::SparseOptimizer optimizer;
-    g2o::BlockSolver_6_3::LinearSolverType * linearSolver;
+    const vector<MapPoint*> vpMPs = pKF->GetMapPointMatches();
+    int nObs = 0;
+    int nBad = 0;
+    for(size_t i=0, iend=vpMPs.size(); i<iend; i++)
+    {
+        MapPoint* pMP = vpMPs[i];
+        if(!pMP || pMP->isBad())
+            continue;
 
-    linearSolver = new g2o::LinearSolverEigen<g2o::BlockSolver_6_3::PoseMatrixType>();
+        nObs++;
+        const cv::Mat Xc = Rcw*pMP->GetWorldPos()+tcw;
+        const float z = Xc.at<float>(2);
+        if(z<=0)
+        {
+            nBad++;
+            continue;
+        }
 
-    g2o::BlockSolver_6_3 * solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
+        const float invz = 1.0f/z;
+        const float u = pKF->fx*Xc.at<float>(0)*invz+pKF->cx;
+        const float v = pKF->fy*Xc.at<float>(1)*invz+pKF->cy;
 
-    g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
-    optimizer.setAlgorithm(solver);
+        const cv::KeyPoint &kpUn = pKF->mvKeysUn[i];
+        const float ex = u-kpUn.pt.x;
+        const float ey = v-kpUn.pt.y;
+        float chi2 = ex*ex+ey*ey;
+        float th = 5.991;
+        if(pKF->mvuRight[i]>=0)
+        {
+            const float er = u-pKF->mbf*invz-pKF->mvuRight[i];
+            chi2 += er*er;
+            th = 7.815;
+        }
 
-    if(pbStopFlag)
-        optimizer.setForceStopFlag(pbStopFlag);
+        if(chi2*pKF->mvInvLevelSigma2[kpUn.octave]>th)
+            nBad++;
+    }
 
-    long unsigned int maxKFid = 0;
+    return nObs>0 ? static_cast<float>(nBad)/nObs : 0.f;
+}
 
-    // Set KeyFrame vertices
-    for(size_t i=0; i<vpKFs.size(); i++)
+// Adds the pose vertex of pKF, with the keyframe id as vertex id
+static void AddKeyFrameVertex(g2o::SparseOptimizer &optimizer, KeyFrame* pKF, const bool bFixed)
+{
+    g2o::VertexSE3Expmap * vSE3 = new g2o::VertexSE3Expmap();
+    vSE3->setEstimate(Converter::toSE3Quat(pKF->GetPose()));
+    vSE3->setId(pKF->mnId);
+    vSE3->setFixed(bFixed);
+    optimizer.addVertex(vSE3);
+}
+
+// Adds the vertex of pMP (id mnId+maxKFid+1) and one edge per observation in a good keyframe
+// up to maxKFid that has a vertex in the optimizer. Observations of keyframes without vertex
+// are skipped: the observations are read again here, and LocalMapping may have added one
+// meanwhile (e.g. a fusion while the loop BA runs). A point without edges is removed again.
+// Returns the number of edges.
+static int AddMapPointVertexAndEdges(g2o::SparseOptimizer &optimizer, MapPoint* pMP, const unsigned long maxKFid,
+                                     const bool bRobust)
+{
+    const float thHuber2D = sqrt(5.99);
+    const float thHuber3D = sqrt(7.815);
+
+    g2o::VertexSBAPointXYZ* vPoint = new g2o::VertexSBAPointXYZ();
+    vPoint->setEstimate(Converter::toVector3d(pMP->GetWorldPos()));
+    const int id = pMP->mnId+maxKFid+1;
+    vPoint->setId(id);
+    vPoint->setMarginalized(true);
+    optimizer.addVertex(vPoint);
+
+    const MapPoint::ObservationList observations = pMP->GetObservations();
+
+    int nEdges = 0;
+    //SET EDGES
+    for(MapPoint::ObservationList::const_iterator mit=observations.begin(); mit!=observations.end(); mit++)
     {
-        KeyFrame* pKF = vpKFs[i];
-        if(pKF->isBad())
+        KeyFrame* pKF = mit->first;
+        if(pKF->isBad() || pKF->mnId>maxKFid)
             continue;
-        g2o::VertexSE3Expmap * vSE3 = new g2o::VertexSE3Expmap();
-        vSE3->setEstimate(Converter::toSE3Quat(pKF->GetPose()));
-        vSE3->setId(pKF->mnId);
-        vSE3->setFixed(pKF->mnId==0);
-        optimizer.addVertex(vSE3);
-        if(pKF->mnId>maxKFid)
-            maxKFid=pKF->mnId;
+
+        g2o::OptimizableGraph::Vertex* vKF = dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(pKF->mnId));
+        if(!vKF)
+            continue;
+
+        nEdges++;
+
+        const cv::KeyPoint &kpUn = pKF->mvKeysUn[mit->second];
+
+        if(pKF->mvuRight[mit->second]<0)
+        {
+            Eigen::Matrix<double,2,1> obs;
+            obs << kpUn.pt.x, kpUn.pt.y;
+
+            g2o::EdgeSE3ProjectXYZ* e = new g2o::EdgeSE3ProjectXYZ();
+
+            e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
+            e->setVertex(1, vKF);
+            e->setMeasurement(obs);
+            const float &invSigma2 = pKF->mvInvLevelSigma2[kpUn.octave];
+            e->setInformation(Eigen::Matrix2d::Identity()*invSigma2);
+
+            if(bRobust)
+            {
+                g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
+                e->setRobustKernel(rk);
+                rk->setDelta(thHuber2D);
+            }
+
+            e->fx = pKF->fx;
+            e->fy = pKF->fy;
+            e->cx = pKF->cx;
+            e->cy = pKF->cy;
+
+            optimizer.addEdge(e);
+        }
+        else
+        {
+            Eigen::Matrix<double,3,1> obs;
+            const float kp_ur = pKF->mvuRight[mit->second];
+            obs << kpUn.pt.x, kpUn.pt.y, kp_ur;
+
+            g2o::EdgeStereoSE3ProjectXYZ* e = new g2o::EdgeStereoSE3ProjectXYZ();
+
+            e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
+            e->setVertex(1, vKF);
+            e->setMeasurement(obs);
+            const float &invSigma2 = pKF->mvInvLevelSigma2[kpUn.octave];
+            Eigen::Matrix3d Info = Eigen::Matrix3d::Identity()*invSigma2;
+            e->setInformation(Info);
+
+            if(bRobust)
+            {
+                g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
+                e->setRobustKernel(rk);
+                rk->setDelta(thHuber3D);
+            }
+
+            e->fx = pKF->fx;
+            e->fy = pKF->fy;
+            e->cx = pKF->cx;
+            e->cy = pKF->cy;
+            e->bf = pKF->mbf;
+
+            optimizer.addEdge(e);
+        }
     }
 
-    const float thHuber2D = sqrt(5.99);
-    const float thHuber3D = sqrt(7.815);
+    if(nEdges==0)
+        optimizer.removeVertex(vPoint);
 
-    // Set MapPoint vertices
-    for(size_t i=0; i<vpMP.size(); i++)
+    return nEdges;
+}
+
+unsigned long Optimizer::IncrementalGlobalBundleAdjustment(Map* pMap, int nIterations, bool* pbStopFlag,
+                                                           const unsigned long nLoopKF, const unsigned long nLastGBAKFid)
+{
+    // A keyframe is re-optimized if it is newer than the last global BA or if more than this
+    // fraction of its observations became inconsistent (e.g. after the loop correction)
+    const float thInconsistent = 0.25f;
+
+    vector<KeyFrame*> vpKFs = pMap->GetAllKeyFrames();
+    vector<MapPoint*> vpMP = pMap->GetAllMapPoints();
+
+    unsigned long maxKFid = 0;
+    for(size_t i=0; i<vpKFs.size(); i++)
+        maxKFid = max(maxKFid,vpKFs[i]->mnId);
+
+    if(nLastGBAKFid==0)
     {
-        MapPoint* pMP = vpMP[i];
-        if(pMP->isBad())
+        BundleAdjustment(vpKFs,vpMP,nIterations,pbStopFlag,nLoopKF,false);
+        return maxKFid;
+    }
+
+    // Affected keyframes plus one covisibility ring, so that the border can adjust
+    vector<bool> vbFreeKF(maxKFid+1,false);
+    list<KeyFrame*> lFreeKeyFrames;
+    for(size_t i=0; i<vpKFs.size(); i++)
+    {
+        KeyFrame* pKF = vpKFs[i];
+        if(pKF->isBad())
             continue;
-        g2o::VertexSBAPointXYZ* vPoint = new g2o::VertexSBAPointXYZ();
-        vPoint->setEstimate(Converter::toVector3d(pMP->GetWorldPos()));
-        const int id = pMP->mnId+maxKFid+1;
-        vPoint->setId(id);
-        vPoint->setMarginalized(true);
-        optimizer.addVertex(vPoint);
 
-       const map<KeyFrame*,size_t> observations = pMP->GetObservations();
+        if(pKF->mnId<=nLastGBAKFid && pKF->mnId!=nLoopKF && InconsistentObservationRatio(pKF)<=thInconsistent)
+            continue;
 
-        int nEdges = 0;
-        //SET EDGES
-        for(map<KeyFrame*,size_t>::const_iterator mit=observations.begin(); mit!=observations.end(); mit++)
+        if(!vbFreeKF[pKF->mnId])
         {
+            vbFreeKF[pKF->mnId] = true;
+            lFreeKeyFrames.push_back(pKF);
+        }
 
-            KeyFrame* pKF = mit->first;
-            if(pKF->isBad() || pKF->mnId>maxKFid)
+        const vector<KeyFrame*> vNeighKFs = pKF->GetVectorCovisibleKeyFrames();
+        for(size_t j=0; j<vNeighKFs.size(); j++)
+        {
+            KeyFrame* pKFi = vNeighKFs[j];
+            if(pKFi->isBad() || pKFi->mnId>maxKFid || vbFreeKF[pKFi->mnId])
                 continue;
+            vbFreeKF[pKFi->mnId] = true;
+            lFreeKeyFrames.push_back(pKFi);
+        }
+    }
 
-            nEdges++;
+    // Most of the map has to move anyway
+    if(lFreeKeyFrames.size()*2>vpKFs.size())
+    {
+        BundleAdjustment(vpKFs,vpMP,nIterations,pbStopFlag,nLoopKF,false);
+        return maxKFid;
+    }
 
-            const cv::KeyPoint &kpUn = pKF->mvKeysUn[mit->second];
+    // MapPoints seen in free KeyFrames
+    set<MapPoint*> sLocalMapPoints;
+    list<MapPoint*> lLocalMapPoints;
+    for(list<KeyFrame*>::iterator lit=lFreeKeyFrames.begin(), lend=lFreeKeyFrames.end(); lit!=lend; lit++)
+    {
+        vector<MapPoint*> vpMPs = (*lit)->GetMapPointMatches();
+        for(vector<MapPoint*>::iterator vit=vpMPs.begin(), vend=vpMPs.end(); vit!=vend; vit++)
+        {
+            MapPoint* pMP = *vit;
+            if(pMP && !pMP->isBad() && sLocalMapPoints.insert(pMP).second)
+                lLocalMapPoints.push_back(pMP);
+        }
+    }
 
-            if(pKF->mvuRight[mit->second]<0)
-            {
-                Eigen::Matrix<double,2,1> obs;
-                obs << kpUn.pt.x, kpUn.pt.y;
+    // Fixed Keyframes. Keyframes that see those MapPoints but are not free
+    set<KeyFrame*> sFixedCameras;
+    for(list<MapPoint*>::iterator lit=lLocalMapPoints.begin(), lend=lLocalMapPoints.end(); lit!=lend; lit++)
+    {
+        const MapPoint::ObservationList observations = (*lit)->GetObservations();
+        for(MapPoint::ObservationList::const_iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+        {
+            KeyFrame* pKFi = mit->first;
+            if(!pKFi->isBad() && pKFi->mnId<=maxKFid && !vbFreeKF[pKFi->mnId])
+                sFixedCameras.insert(pKFi);
+        }
+    }
 
-                g2o::EdgeSE3ProjectXYZ* e = new g2o::EdgeSE3ProjectXYZ();
+    g2o::SparseOptimizer optimizer;
+    g2o::OptimizationAlgorithmLevenberg* solver = CreateLevenberg<g2o::BlockSolver_6_3>(static_cast<int>(lFreeKeyFrames.size()));
+    optimizer.setAlgorithm(solver);
 
-                e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
-                e->setVertex(1, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(pKF->mnId)));
-                e->setMeasurement(obs);
-                const float &invSigma2 = pKF->mvInvLevelSigma2[kpUn.octave];
-                e->setInformation(Eigen::Matrix2d::Identity()*invSigma2);
+    if(pbStopFlag)
+        optimizer.setForceStopFlag(pbStopFlag);
 
-                if(bRobust)
-                {
-                    g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-                    e->setRobustKernel(rk);
-                    rk->setDelta(thHuber2D);
-                }
+    // Without keyframe 0 or a fixed neighbour the subgraph would be free to drift (gauge
+    // freedom), then its oldest keyframe is held fixed instead
+    KeyFrame* pGaugeKF = NULL;
+    if(sFixedCameras.empty())
+    {
+        for(list<KeyFrame*>::iterator lit=lFreeKeyFrames.begin(), lend=lFreeKeyFrames.end(); lit!=lend; lit++)
+            if(!pGaugeKF || (*lit)->mnId<pGaugeKF->mnId)
+                pGaugeKF = *lit;
+    }
 
-                e->fx = pKF->fx;
-                e->fy = pKF->fy;
-                e->cx = pKF->cx;
-                e->cy = pKF->cy;
+    // Set KeyFrame vertices
+    for(list<KeyFrame*>::iterator lit=lFreeKeyFrames.begin(), lend=lFreeKeyFrames.end(); lit!=lend; lit++)
+        AddKeyFrameVertex(optimizer,*lit,(*lit)->mnId==0 || *lit==pGaugeKF);
 
-                optimizer.addEdge(e);
-            }
-            else
-            {
-                Eigen::Matrix<double,3,1> obs;
-                const float kp_ur = pKF->mvuRight[mit->second];
-                obs << kpUn.pt.x, kpUn.pt.y, kp_ur;
+    for(set<KeyFrame*>::iterator sit=sFixedCameras.begin(), send=sFixedCameras.end(); sit!=send; sit++)
+        AddKeyFrameVertex(optimizer,*sit,true);
 
-                g2o::EdgeStereoSE3ProjectXYZ* e = new g2o::EdgeStereoSE3ProjectXYZ();
+    // Set MapPoint vertices
+    for(list<MapPoint*>::iterator lit=lLocalMapPoints.begin(), lend=lLocalMapPoints.end(); lit!=lend; lit++)
+        AddMapPointVertexAndEdges(optimizer,*lit,maxKFid,false);
 
-                e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
-                e->setVertex(1, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(pKF->mnId)));
-                e->setMeasurement(obs);
-                const float &invSigma2 = pKF->mvInvLevelSigma2[kpUn.octave];
-                Eigen::Matrix3d Info = Eigen::Matrix3d::Identity()*invSigma2;
-                e->setInformation(Info);
+    // Optimize!
+    optimizer.initializeOptimization();
+    optimizer.optimize(nIterations);
 
-                if(bRobust)
-                {
-                    g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-                    e->setRobustKernel(rk);
-                    rk->setDelta(thHuber3D);
-                }
+    // Recover optimized data. KeyFrames and MapPoints outside the optimized region keep
+    // their current estimate, so that LoopClosing only propagates the correction to the
+    // keyframes created during the BA.
 
-                e->fx = pKF->fx;
-                e->fy = pKF->fy;
-                e->cx = pKF->cx;
-                e->cy = pKF->cy;
-                e->bf = pKF->mbf;
+    //Keyframes
+    for(size_t i=0; i<vpKFs.size(); i++)
+    {
+        KeyFrame* pKF = vpKFs[i];
+        if(pKF->isBad())
+            continue;
 
-                optimizer.addEdge(e);
-            }
+        pKF->mTcwGBA.create(4,4,CV_32F);
+        if(vbFreeKF[pKF->mnId])
+        {
+            g2o::VertexSE3Expmap* vSE3 = static_cast<g2o::VertexSE3Expmap*>(optimizer.vertex(pKF->mnId));
+            Converter::toCvMat(vSE3->estimate()).copyTo(pKF->mTcwGBA);
+        }
+        else
+        {
+            pKF->GetPose().copyTo(pKF->mTcwGBA);
         }
+        pKF->mnBAGlobalForKF = nLoopKF;
+    }
 
-        if(nEdges==0)
+    //Points
+    for(size_t i=0; i<vpMP.size(); i++)
+    {
+        MapPoint* pMP = vpMP[i];
+        if(pMP->isBad())
+            continue;
+
+        pMP->mPosGBA.create(3,1,CV_32F);
+        g2o::VertexSBAPointXYZ* vPoint = sLocalMapPoints.count(pMP) ?
+                static_cast<g2o::VertexSBAPointXYZ*>(optimizer.vertex(pMP->mnId+maxKFid+1)) : NULL;
+        if(vPoint)
         {
-            optimizer.removeVertex(vPoint);
-            vbNotIncludedMP[i]=true;
+            Converter::toCvMat(vPoint->estimate()).copyTo(pMP->mPosGBA);
         }
         else
         {
-            vbNotIncludedMP[i]=false;
+            pMP->GetWorldPos().copyTo(pMP->mPosGBA);
         }
+        pMP->mnBAGlobalForKF = nLoopKF;
+    }
+
+    return maxKFid;
+}
+
+
+void Optimizer::BundleAdjustment(const vector<KeyFrame *> &vpKFs, const vector<MapPoint *> &vpMP,
+                                 int nIterations, bool* pbStopFlag, const unsigned long nLoopKF, const bool bRobust)
+{
+    vector<bool> vbNotIncludedMP;
+    vbNotIncludedMP.resize(vpMP.size());
+
+    g2o::SparseOptimizer optimizer;
+    g2o::OptimizationAlgorithmLevenberg* solver = CreateLevenberg<g2o::BlockSolver_6_3>(static_cast<int>(vpKFs.size()));
+    optimizer.setAlgorithm(solver);
+
+    if(pbStopFlag)
+        optimizer.setForceStopFlag(pbStopFlag);
+
+    long unsigned int maxKFid = 0;
+
+    // Set KeyFrame vertices
+    for(size_t i=0; i<vpKFs.size(); i++)
+    {
+        KeyFrame* pKF = vpKFs[i];
+        if(pKF->isBad())
+            continue;
+        AddKeyFrameVertex(optimizer,pKF,pKF->mnId==0);
+        if(pKF->mnId>maxKFid)
+            maxKFid=pKF->mnId;
+    }
+
+    // Set MapPoint vertices
+    for(size_t i=0; i<vpMP.size(); i++)
+    {
+        MapPoint* pMP = vpMP[i];
+        if(pMP->isBad())
+            continue;
+        vbNotIncludedMP[i] = AddMapPointVertexAndEdges(optimizer,pMP,maxKFid,bRobust)==0;
     }
 
     // Optimize!
@@ -239,13 +536,7 @@ void Optimizer::BundleAdjustment(const vector<KeyFrame *> &vpKFs, const vector<M
 int Optimizer::PoseOptimization(Frame *pFrame)
 {
     g2o::SparseOptimizer optimizer;
-    g2o::BlockSolver_6_3::LinearSolverType * linearSolver;
-
-    linearSolver = new g2o::LinearSolverDense<g2o::BlockSolver_6_3::PoseMatrixType>();
-
-    g2o::BlockSolver_6_3 * solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
-
-    g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
+    g2o::OptimizationAlgorithmLevenberg* solver = CreateLevenberg<g2o::BlockSolver_6_3>(1);
     optimizer.setAlgorithm(solver);
 
     int nInitialCorrespondences=0;
@@ -455,13 +746,7 @@ int Optimizer::PoseOptimization(Frame *pFrame)
 int Optimizer::PoseOptimization(Frame *pFrame,DynaSLAM::Geometry & geom)
 {
     g2o::SparseOptimizer optimizer;
-    g2o::BlockSolver_6_3::LinearSolverType * linearSolver;
-
-    linearSolver = new g2o::LinearSolverDense<g2o::BlockSolver_6_3::PoseMatrixType>();
-
-    g2o::BlockSolver_6_3 * solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
-
-    g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
+    g2o::OptimizationAlgorithmLevenberg* solver = CreateLevenberg<g2o::BlockSolver_6_3>(1);
     optimizer.setAlgorithm(solver);
 
     int nInitialCorrespondences=0;
@@ -666,7 +951,7 @@ int Optimizer::PoseOptimization(Frame *pFrame,DynaSLAM::Geometry & geom)
     return nInitialCorrespondences-nBad;
 }*/
 
-void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap)
+void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap, LocalBAWindow* pWindow)
 {    
     // Local KeyFrames: First Breath Search from Current Keyframe
     list<KeyFrame*> lLocalKeyFrames;
@@ -705,8 +990,8 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
     list<KeyFrame*> lFixedCameras;
     for(list<MapPoint*>::iterator lit=lLocalMapPoints.begin(), lend=lLocalMapPoints.end(); lit!=lend; lit++)
     {
-        map<KeyFrame*,size_t> observations = (*lit)->GetObservations();
-        for(map<KeyFrame*,size_t>::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+        MapPoint::ObservationList observations = (*lit)->GetObservations();
+        for(MapPoint::ObservationList::iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
         {
             KeyFrame* pKFi = mit->first;
 
@@ -719,49 +1004,62 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
         }
     }
 
-    // Setup optimizer
-    g2o::SparseOptimizer optimizer;
-    g2o::BlockSolver_6_3::LinearSolverType * linearSolver;
-
-    linearSolver = new g2o::LinearSolverEigen<g2o::BlockSolver_6_3::PoseMatrixType>();
+    // Without a persistent window the graph is built from scratch
+    LocalBAWindow window;
+    if(!pWindow)
+        pWindow = &window;
 
-    g2o::BlockSolver_6_3 * solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
+    g2o::SparseOptimizer &optimizer = pWindow->mOptimizer;
 
-    g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
-    optimizer.setAlgorithm(solver);
+    // Setup optimizer, the linear solver follows the size of the window. The window keeps
+    // both solvers, switching between them does not reallocate anything
+    const int nPoses = lLocalKeyFrames.size();
+    g2o::OptimizationAlgorithm* &pSolver = nPoses<=MAX_DENSE_POSES ? pWindow->mpDenseSolver : pWindow->mpSparseSolver;
+    if(!pSolver)
+        pSolver = CreateLevenberg<g2o::BlockSolver_6_3>(nPoses);
+    if(optimizer.solver()!=pSolver)
+        optimizer.setAlgorithm(pSolver);
 
-    if(pbStopFlag)
-        optimizer.setForceStopFlag(pbStopFlag);
+    optimizer.setForceStopFlag(pbStopFlag);
 
-    unsigned long maxKFid = 0;
+    const float thHuberMono = sqrt(5.991);
+    const float thHuberStereo = sqrt(7.815);
 
-    // Set Local KeyFrame vertices
-    for(list<KeyFrame*>::iterator lit=lLocalKeyFrames.begin(), lend=lLocalKeyFrames.end(); lit!=lend; lit++)
+    // MapPoints that left the window, their edges are removed with them
+    for(map<MapPoint*,LocalBAWindow::Point>::iterator mit=pWindow->mmPoints.begin(); mit!=pWindow->mmPoints.end();)
     {
-        KeyFrame* pKFi = *lit;
-        g2o::VertexSE3Expmap * vSE3 = new g2o::VertexSE3Expmap();
-        vSE3->setEstimate(Converter::toSE3Quat(pKFi->GetPose()));
-        vSE3->setId(pKFi->mnId);
-        vSE3->setFixed(pKFi->mnId==0);
-        optimizer.addVertex(vSE3);
-        if(pKFi->mnId>maxKFid)
-            maxKFid=pKFi->mnId;
+        if(mit->first->mnBALocalForKF!=pKF->mnId)
+        {
+            optimizer.removeVertex(mit->second.pVertex);
+            pWindow->mmPoints.erase(mit++);
+        }
+        else
+            mit++;
     }
 
-    // Set Fixed KeyFrame vertices
-    for(list<KeyFrame*>::iterator lit=lFixedCameras.begin(), lend=lFixedCameras.end(); lit!=lend; lit++)
+    // KeyFrame vertices. Existing ones start from the current pose, which is the previous
+    // solution unless loop closing moved the keyframe in between
+    set<KeyFrame*> sWindowKFs;
+    for(int bFixed=0; bFixed<2; bFixed++)
     {
-        KeyFrame* pKFi = *lit;
-        g2o::VertexSE3Expmap * vSE3 = new g2o::VertexSE3Expmap();
-        vSE3->setEstimate(Converter::toSE3Quat(pKFi->GetPose()));
-        vSE3->setId(pKFi->mnId);
-        vSE3->setFixed(true);
-        optimizer.addVertex(vSE3);
-        if(pKFi->mnId>maxKFid)
-            maxKFid=pKFi->mnId;
+        const list<KeyFrame*> &lKFs = bFixed ? lFixedCameras : lLocalKeyFrames;
+        for(list<KeyFrame*>::const_iterator lit=lKFs.begin(), lend=lKFs.end(); lit!=lend; lit++)
+        {
+            KeyFrame* pKFi = *lit;
+            g2o::VertexSE3Expmap* &vSE3 = pWindow->mmKeyFrames[pKFi];
+            if(!vSE3)
+            {
+                vSE3 = new g2o::VertexSE3Expmap();
+                vSE3->setId(2*pKFi->mnId);
+                optimizer.addVertex(vSE3);
+            }
+            vSE3->setEstimate(Converter::toSE3Quat(pKFi->GetPose()));
+            vSE3->setFixed(bFixed || pKFi->mnId==0);
+            sWindowKFs.insert(pKFi);
+        }
     }
 
-    // Set MapPoint vertices
+    // MapPoint vertices and edges
     const int nExpectedSize = (lLocalKeyFrames.size()+lFixedCameras.size())*lLocalMapPoints.size();
 
     vector<g2o::EdgeSE3ProjectXYZ*> vpEdgesMono;
@@ -782,90 +1080,150 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
     vector<MapPoint*> vpMapPointEdgeStereo;
     vpMapPointEdgeStereo.reserve(nExpectedSize);
 
-    const float thHuberMono = sqrt(5.991);
-    const float thHuberStereo = sqrt(7.815);
-
     for(list<MapPoint*>::iterator lit=lLocalMapPoints.begin(), lend=lLocalMapPoints.end(); lit!=lend; lit++)
     {
         MapPoint* pMP = *lit;
-        g2o::VertexSBAPointXYZ* vPoint = new g2o::VertexSBAPointXYZ();
-        vPoint->setEstimate(Converter::toVector3d(pMP->GetWorldPos()));
-        int id = pMP->mnId+maxKFid+1;
-        vPoint->setId(id);
-        vPoint->setMarginalized(true);
-        optimizer.addVertex(vPoint);
+        LocalBAWindow::Point &point = pWindow->mmPoints[pMP];
+        if(!point.pVertex)
+        {
+            point.pVertex = new g2o::VertexSBAPointXYZ();
+            point.pVertex->setId(2*pMP->mnId+1);
+            point.pVertex->setMarginalized(true);
+            optimizer.addVertex(point.pVertex);
+        }
+        point.pVertex->setEstimate(Converter::toVector3d(pMP->GetWorldPos()));
+
+        const MapPoint::ObservationList observations = pMP->GetObservations();
 
-        const map<KeyFrame*,size_t> observations = pMP->GetObservations();
+        // Remove the edges of observations that were erased or changed since the last window
+        for(map<KeyFrame*,LocalBAWindow::Observation>::iterator oit=point.mObservations.begin(); oit!=point.mObservations.end();)
+        {
+            MapPoint::ObservationList::const_iterator mit = observations.begin();
+            while(mit!=observations.end() && mit->first!=oit->first)
+                mit++;
+            if(mit==observations.end() || mit->second!=oit->second.idx || !sWindowKFs.count(oit->first))
+            {
+                optimizer.removeEdge(oit->second.pEdge);
+                point.mObservations.erase(oit++);
+            }
+            else
+                oit++;
+        }
 
         //Set edges
-        for(map<KeyFrame*,size_t>::const_iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
+        for(MapPoint::ObservationList::const_iterator mit=observations.begin(), mend=observations.end(); mit!=mend; mit++)
         {
             KeyFrame* pKFi = mit->first;
 
-            if(!pKFi->isBad())
-            {                
-                const cv::KeyPoint &kpUn = pKFi->mvKeysUn[mit->second];
+            if(pKFi->isBad() || !sWindowKFs.count(pKFi))
+                continue;
 
-                // Monocular observation
-                if(pKFi->mvuRight[mit->second]<0)
+            map<KeyFrame*,LocalBAWindow::Observation>::iterator oit = point.mObservations.find(pKFi);
+            if(oit!=point.mObservations.end())
+            {
+                // Reused edge, restore the state changed by the outlier rejection of the last window
+                g2o::OptimizableGraph::Edge* e = oit->second.pEdge;
+                e->setLevel(0);
+                e->robustKernel()->setDelta(oit->second.bStereo ? thHuberStereo : thHuberMono);
+
+                if(oit->second.bStereo)
                 {
-                    Eigen::Matrix<double,2,1> obs;
-                    obs << kpUn.pt.x, kpUn.pt.y;
+                    vpEdgesStereo.push_back(static_cast<g2o::EdgeStereoSE3ProjectXYZ*>(e));
+                    vpEdgeKFStereo.push_back(pKFi);
+                    vpMapPointEdgeStereo.push_back(pMP);
+                }
+                else
+                {
+                    vpEdgesMono.push_back(static_cast<g2o::EdgeSE3ProjectXYZ*>(e));
+                    vpEdgeKFMono.push_back(pKFi);
+                    vpMapPointEdgeMono.push_back(pMP);
+                }
+                continue;
+            }
 
-                    g2o::EdgeSE3ProjectXYZ* e = new g2o::EdgeSE3ProjectXYZ();
+            g2o::VertexSE3Expmap* vSE3 = pWindow->mmKeyFrames[pKFi];
+            const cv::KeyPoint &kpUn = pKFi->mvKeysUn[mit->second];
 
-                    e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
-                    e->setVertex(1, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(pKFi->mnId)));
-                    e->setMeasurement(obs);
-                    const float &invSigma2 = pKFi->mvInvLevelSigma2[kpUn.octave];
-                    e->setInformation(Eigen::Matrix2d::Identity()*invSigma2);
+            LocalBAWindow::Observation obsEntry;
+            obsEntry.idx = mit->second;
+            obsEntry.bStereo = pKFi->mvuRight[mit->second]>=0;
 
-                    g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-                    e->setRobustKernel(rk);
-                    rk->setDelta(thHuberMono);
+            // Monocular observation
+            if(!obsEntry.bStereo)
+            {
+                Eigen::Matrix<double,2,1> obs;
+                obs << kpUn.pt.x, kpUn.pt.y;
 
-                    e->fx = pKFi->fx;
-                    e->fy = pKFi->fy;
-                    e->cx = pKFi->cx;
-                    e->cy = pKFi->cy;
+                g2o::EdgeSE3ProjectXYZ* e = new g2o::EdgeSE3ProjectXYZ();
 
-                    optimizer.addEdge(e);
-                    vpEdgesMono.push_back(e);
-                    vpEdgeKFMono.push_back(pKFi);
-                    vpMapPointEdgeMono.push_back(pMP);
-                }
-                else // Stereo observation
-                {
-                    Eigen::Matrix<double,3,1> obs;
-                    const float kp_ur = pKFi->mvuRight[mit->second];
-                    obs << kpUn.pt.x, kpUn.pt.y, kp_ur;
+                e->setVertex(0, point.pVertex);
+                e->setVertex(1, vSE3);
+                e->setMeasurement(obs);
+                const float &invSigma2 = pKFi->mvInvLevelSigma2[kpUn.octave];
+                e->setInformation(Eigen::Matrix2d::Identity()*invSigma2);
 
-                    g2o::EdgeStereoSE3ProjectXYZ* e = new g2o::EdgeStereoSE3ProjectXYZ();
+                g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
+                e->setRobustKernel(rk);
+                rk->setDelta(thHuberMono);
 
-                    e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(id)));
-                    e->setVertex(1, dynamic_cast<g2o::OptimizableGraph::Vertex*>(optimizer.vertex(pKFi->mnId)));
-                    e->setMeasurement(obs);
-                    const float &invSigma2 = pKFi->mvInvLevelSigma2[kpUn.octave];
-                    Eigen::Matrix3d Info = Eigen::Matrix3d::Identity()*invSigma2;
-                    e->setInformation(Info);
+                e->fx = pKFi->fx;
+                e->fy = pKFi->fy;
+                e->cx = pKFi->cx;
+                e->cy = pKFi->cy;
 
-                    g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
-                    e->setRobustKernel(rk);
-                    rk->setDelta(thHuberStereo);
+                optimizer.addEdge(e);
+                obsEntry.pEdge = e;
+                vpEdgesMono.push_back(e);
+                vpEdgeKFMono.push_back(pKFi);
+                vpMapPointEdgeMono.push_back(pMP);
+            }
+            else // Stereo observation
+            {
+                Eigen::Matrix<double,3,1> obs;
+                const float kp_ur = pKFi->mvuRight[mit->second];
+                obs << kpUn.pt.x, kpUn.pt.y, kp_ur;
 
-                    e->fx = pKFi->fx;
-                    e->fy = pKFi->fy;
-                    e->cx = pKFi->cx;
-                    e->cy = pKFi->cy;
-                    e->bf = pKFi->mbf;
+                g2o::EdgeStereoSE3ProjectXYZ* e = new g2o::EdgeStereoSE3ProjectXYZ();
 
-                    optimizer.addEdge(e);
-                    vpEdgesStereo.push_back(e);
-                    vpEdgeKFStereo.push_back(pKFi);
-                    vpMapPointEdgeStereo.push_back(pMP);
-                }
+                e->setVertex(0, point.pVertex);
+                e->setVertex(1, vSE3);
+                e->setMeasurement(obs);
+                const float &invSigma2 = pKFi->mvInvLevelSigma2[kpUn.octave];
+                Eigen::Matrix3d Info = Eigen::Matrix3d::Identity()*invSigma2;
+                e->setInformation(Info);
+
+                g2o::RobustKernelHuber* rk = new g2o::RobustKernelHuber;
+                e->setRobustKernel(rk);
+                rk->setDelta(thHuberStereo);
+
+                e->fx = pKFi->fx;
+                e->fy = pKFi->fy;
+                e->cx = pKFi->cx;
+                e->cy = pKFi->cy;
+                e->bf = pKFi->mbf;
+
+                optimizer.addEdge(e);
+                obsEntry.pEdge = e;
+                vpEdgesStereo.push_back(e);
+                vpEdgeKFStereo.push_back(pKFi);
+                vpMapPointEdgeStereo.push_back(pMP);
             }
+
+            point.mObservations[pKFi] = obsEntry;
+        }
+    }
+
+    // KeyFrames that left the window. All their edges belonged to MapPoints that left
+    // or to observations removed above.
+    for(map<KeyFrame*,g2o::VertexSE3Expmap*>::iterator mit=pWindow->mmKeyFrames.begin(); mit!=pWindow->mmKeyFrames.end();)
+    {
+        if(!sWindowKFs.count(mit->first))
+        {
+            optimizer.removeVertex(mit->second);
+            pWindow->mmKeyFrames.erase(mit++);
         }
+        else
+            mit++;
     }
 
     if(pbStopFlag)
@@ -884,7 +1242,11 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
     if(bDoMore)
     {
 
-    // Check inlier observations
+    // Check inlier observations.
+    // The second round runs without robust cost. The kernels are kept for the next window
+    // and widened instead, a Huber kernel whose delta is never reached is the plain quadratic cost.
+    const float thHuberDisabled = 1e5;
+
     for(size_t i=0, iend=vpEdgesMono.size(); i<iend;i++)
     {
         g2o::EdgeSE3ProjectXYZ* e = vpEdgesMono[i];
@@ -898,7 +1260,7 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
             e->setLevel(1);
         }
 
-        e->setRobustKernel(0);
+        e->robustKernel()->setDelta(thHuberDisabled);
     }
 
     for(size_t i=0, iend=vpEdgesStereo.size(); i<iend;i++)
@@ -914,7 +1276,7 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
             e->setLevel(1);
         }
 
-        e->setRobustKernel(0);
+        e->robustKernel()->setDelta(thHuberDisabled);
     }
 
     // Optimize again without the outliers
@@ -978,7 +1340,7 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
     for(list<KeyFrame*>::iterator lit=lLocalKeyFrames.begin(), lend=lLocalKeyFrames.end(); lit!=lend; lit++)
     {
         KeyFrame* pKF = *lit;
-        g2o::VertexSE3Expmap* vSE3 = static_cast<g2o::VertexSE3Expmap*>(optimizer.vertex(pKF->mnId));
+        g2o::VertexSE3Expmap* vSE3 = pWindow->mmKeyFrames[pKF];
         g2o::SE3Quat SE3quat = vSE3->estimate();
         pKF->SetPose(Converter::toCvMat(SE3quat));
     }
@@ -987,7 +1349,7 @@ void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool* pbStopFlag, Map* pMap
     for(list<MapPoint*>::iterator lit=lLocalMapPoints.begin(), lend=lLocalMapPoints.end(); lit!=lend; lit++)
     {
         MapPoint* pMP = *lit;
-        g2o::VertexSBAPointXYZ* vPoint = static_cast<g2o::VertexSBAPointXYZ*>(optimizer.vertex(pMP->mnId+maxKFid+1));
+        g2o::VertexSBAPointXYZ* vPoint = pWindow->mmPoints[pMP].pVertex;
         pMP->SetWorldPos(Converter::toCvMat(vPoint->estimate()));
         pMP->UpdateNormalAndDepth();
     }
@@ -1002,10 +1364,7 @@ void Optimizer::OptimizeEssentialGraph(Map* pMap, KeyFrame* pLoopKF, KeyFrame* p
     // Setup optimizer
     g2o::SparseOptimizer optimizer;
     optimizer.setVerbose(false);
-    g2o::BlockSolver_7_3::LinearSolverType * linearSolver =
-           new g2o::LinearSolverEigen<g2o::BlockSolver_7_3::PoseMatrixType>();
-    g2o::BlockSolver_7_3 * solver_ptr= new g2o::BlockSolver_7_3(linearSolver);
-    g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
+    g2o::OptimizationAlgorithmLevenberg* solver = CreateLevenberg<g2o::BlockSolver_7_3>(pMap->KeyFramesInMap());
 
     solver->setUserLambdaInit(1e-16);
     optimizer.setAlgorithm(solver);
@@ -1262,13 +1621,7 @@ void Optimizer::OptimizeEssentialGraph(Map* pMap, KeyFrame* pLoopKF, KeyFrame* p
 int Optimizer::OptimizeSim3(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint *> &vpMatches1, g2o::Sim3 &g2oS12, const float th2, const bool bFixScale)
 {
     g2o::SparseOptimizer optimizer;
-    g2o::BlockSolverX::LinearSolverType * linearSolver;
-
-    linearSolver = new g2o::LinearSolverDense<g2o::BlockSolverX::PoseMatrixType>();
-
-    g2o::BlockSolverX * solver_ptr = new g2o::BlockSolverX(linearSolver);
-
-    g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
+    g2o::OptimizationAlgorithmLevenberg* solver = CreateLevenberg<g2o::BlockSolverX>(1);
     optimizer.setAlgorithm(solver);
 
     // Calibration
@@ -1462,11 +1815,7 @@ int Optimizer::OptimizeSim3(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint *> &
 int Optimizer::PoseOptimization(KeyFrame* pFrame, bool bUpdateMap)
 {
     g2o::SparseOptimizer optimizer;
-    g2o::BlockSolver_6_3::LinearSolverType* linearSolver;
-
-    linearSolver = new g2o::LinearSolverDense<g2o::BlockSolver_6_3::PoseMatrixType>();
-    g2o::BlockSolver_6_3* solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
-    g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
+    g2o::OptimizationAlgorithmLevenberg* solver = CreateLevenberg<g2o::BlockSolver_6_3>(1);
     optimizer.setAlgorithm(solver);
 
     int nInitialCorrespondences = 0;
@@ -1709,8 +2058,8 @@ void Optimizer::SemanticBundleAdjustment(KeyFrame* pKF, bool* pbStopFlag, Map* p
     // Fixed Keyframes. Keyframes that see Local MapPoints but that are not Local Keyframes
     list<KeyFrame*> lFixedCameras;
     for (list<MapPoint *>::iterator lit = lLocalMapPoints.begin(), lend = lLocalMapPoints.end(); lit != lend; lit++) {
-        map<KeyFrame*, size_t > observations = (*lit)->GetObservations();
-        for (map<KeyFrame *, size_t >::iterator mit = observations.begin(), mend = observations.end(); mit != mend; mit++) {
+        MapPoint::ObservationList observations = (*lit)->GetObservations();
+        for (MapPoint::ObservationList::iterator mit = observations.begin(), mend = observations.end(); mit != mend; mit++) {
             KeyFrame* pKFi = mit->first;
 
             if (!pKFi)
@@ -1780,13 +2129,7 @@ void Optimizer::SemanticBundleAdjustment(KeyFrame* pKF, bool* pbStopFlag, Map* p
 
     // Setup optimizer
     g2o::SparseOptimizer optimizer;
-    g2o::BlockSolver_6_3::LinearSolverType* linearSolver;
-
-    linearSolver = new g2o::LinearSolverEigen<g2o::BlockSolver_6_3::PoseMatrixType>();
-
-    g2o::BlockSolver_6_3* solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
-
-    g2o::OptimizationAlgorithmLevenberg* solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
+    g2o::OptimizationAlgorithmLevenberg* solver = CreateLevenberg<g2o::BlockSolver_6_3>(static_cast<int>(lLocalKeyFrames.size()));
     if (pMap->IsInertial())
         solver->setUserLambdaInit(100.0); // ================TODO uncomment
 
@@ -1871,10 +2214,10 @@ void Optimizer::SemanticBundleAdjustment(KeyFrame* pKF, bool* pbStopFlag, Map* p
         optimizer.addVertex(vPoint);
         nPoints++;
 
-        const map<KeyFrame*, size_t > observations = pMP->GetObservations();
+        const MapPoint::ObservationList observations = pMP->GetObservations();
 
         //Set edges
-        for (map<KeyFrame *, size_t >::const_iterator mit = observations.begin(), mend = observations.end(); mit != mend; mit++) {
+        for (MapPoint::ObservationList::const_iterator mit = observations.begin(), mend = observations.end(); mit != mend; mit++) {
             KeyFrame* pKFi = mit->first;
 
             if (pKFi->mnId > pKF->mnId)
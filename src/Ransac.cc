@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#include "Ransac.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+namespace ORB_SLAM2 {
+
+// The early termination test runs once per block
+static const int BLOCK = 64;
+
+#if defined(__AVX__)
+static inline float HorizontalSum(const __m256 v)
+{
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+static inline void StoreMask(const int mask, unsigned char* vbInliers)
+{
+    for (int k = 0; k < 8; k++)
+        vbInliers[k] = (mask >> k) & 1;
+}
+#endif
+
+void Ransac::Sampler::Seed(unsigned int seed, unsigned int task)
+{
+    std::seed_seq seq{seed, task};
+    mRng.seed(seq);
+}
+
+void Ransac::Sampler::Reset(int n)
+{
+    mvPool.resize(n);
+    for (int i = 0; i < n; i++)
+        mvPool[i] = i;
+}
+
+void Ransac::Sampler::Sample(int k, size_t* vIndices)
+{
+    const int n = mvPool.size();
+    for (int j = 0; j < k; j++) {
+        // modulo rather than std::uniform_int_distribution, whose draws
+        // differ between standard libraries
+        const int r = j + mRng() % (n - j);
+        std::swap(mvPool[j], mvPool[r]);
+        vIndices[j] = mvPool[j];
+    }
+}
+
+float Ransac::ScoreHomography(const float* H21, const float* H12,
+                              const float* u1, const float* v1, const float* u2, const float* v2, int n,
+                              float th, float invSigmaSquare, float bestScore, unsigned char* vbInliers)
+{
+    const float maxPerPoint = 2.f * th;
+    float score = 0;
+
+    int i = 0;
+    while (i < n) {
+        const int iEnd = std::min(n, i + BLOCK);
+
+#if defined(__AVX__)
+        __m256 vscore = _mm256_setzero_ps();
+        const __m256 vth = _mm256_set1_ps(th);
+        const __m256 vinvSigma2 = _mm256_set1_ps(invSigmaSquare);
+        const __m256 vone = _mm256_set1_ps(1.f);
+        for (; i + 8 <= iEnd; i += 8) {
+            const __m256 U1 = _mm256_loadu_ps(u1 + i);
+            const __m256 V1 = _mm256_loadu_ps(v1 + i);
+            const __m256 U2 = _mm256_loadu_ps(u2 + i);
+            const __m256 V2 = _mm256_loadu_ps(v2 + i);
+
+            // Reprojection error in first image, x2in1 = H12*x2
+            const __m256 w2in1inv = _mm256_div_ps(vone, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(H12[6]), U2), _mm256_mul_ps(_mm256_set1_ps(H12[7]), V2)), _mm256_set1_ps(H12[8])));
+            const __m256 u2in1 = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(H12[0]), U2), _mm256_mul_ps(_mm256_set1_ps(H12[1]), V2)), _mm256_set1_ps(H12[2])), w2in1inv);
+            const __m256 v2in1 = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(H12[3]), U2), _mm256_mul_ps(_mm256_set1_ps(H12[4]), V2)), _mm256_set1_ps(H12[5])), w2in1inv);
+            const __m256 du1 = _mm256_sub_ps(U1, u2in1);
+            const __m256 dv1 = _mm256_sub_ps(V1, v2in1);
+            const __m256 chi1 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(du1, du1), _mm256_mul_ps(dv1, dv1)), vinvSigma2);
+
+            // Reprojection error in second image, x1in2 = H21*x1
+            const __m256 w1in2inv = _mm256_div_ps(vone, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(H21[6]), U1), _mm256_mul_ps(_mm256_set1_ps(H21[7]), V1)), _mm256_set1_ps(H21[8])));
+            const __m256 u1in2 = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(H21[0]), U1), _mm256_mul_ps(_mm256_set1_ps(H21[1]), V1)), _mm256_set1_ps(H21[2])), w1in2inv);
+            const __m256 v1in2 = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(H21[3]), U1), _mm256_mul_ps(_mm256_set1_ps(H21[4]), V1)), _mm256_set1_ps(H21[5])), w1in2inv);
+            const __m256 du2 = _mm256_sub_ps(U2, u1in2);
+            const __m256 dv2 = _mm256_sub_ps(V2, v1in2);
+            const __m256 chi2 = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(du2, du2), _mm256_mul_ps(dv2, dv2)), vinvSigma2);
+
+            const __m256 in1 = _mm256_cmp_ps(chi1, vth, _CMP_LE_OQ);
+            const __m256 in2 = _mm256_cmp_ps(chi2, vth, _CMP_LE_OQ);
+            vscore = _mm256_add_ps(vscore, _mm256_and_ps(in1, _mm256_sub_ps(vth, chi1)));
+            vscore = _mm256_add_ps(vscore, _mm256_and_ps(in2, _mm256_sub_ps(vth, chi2)));
+            StoreMask(_mm256_movemask_ps(_mm256_and_ps(in1, in2)), vbInliers + i);
+        }
+        score += HorizontalSum(vscore);
+#endif
+
+        for (; i < iEnd; i++) {
+            bool bIn = true;
+
+            const float w2in1inv = 1.0 / (H12[6] * u2[i] + H12[7] * v2[i] + H12[8]);
+            const float u2in1 = (H12[0] * u2[i] + H12[1] * v2[i] + H12[2]) * w2in1inv;
+            const float v2in1 = (H12[3] * u2[i] + H12[4] * v2[i] + H12[5]) * w2in1inv;
+            const float chiSquare1 = ((u1[i] - u2in1) * (u1[i] - u2in1) + (v1[i] - v2in1) * (v1[i] - v2in1)) * invSigmaSquare;
+
+            if (chiSquare1 <= th)
+                score += th - chiSquare1;
+            else
+                bIn = false;
+
+            const float w1in2inv = 1.0 / (H21[6] * u1[i] + H21[7] * v1[i] + H21[8]);
+            const float u1in2 = (H21[0] * u1[i] + H21[1] * v1[i] + H21[2]) * w1in2inv;
+            const float v1in2 = (H21[3] * u1[i] + H21[4] * v1[i] + H21[5]) * w1in2inv;
+            const float chiSquare2 = ((u2[i] - u1in2) * (u2[i] - u1in2) + (v2[i] - v1in2) * (v2[i] - v1in2)) * invSigmaSquare;
+
+            if (chiSquare2 <= th)
+                score += th - chiSquare2;
+            else
+                bIn = false;
+
+            vbInliers[i] = bIn;
+        }
+
+        // Even if all the remaining matches were inliers with zero error
+        if (score + (n - i) * maxPerPoint <= bestScore)
+            return ABANDONED;
+    }
+
+    return score;
+}
+
+float Ransac::ScoreFundamental(const float* F21,
+                               const float* u1, const float* v1, const float* u2, const float* v2, int n,
+                               float th, float thScore, float invSigmaSquare, float bestScore, unsigned char* vbInliers)
+{
+    const float f11 = F21[0], f12 = F21[1], f13 = F21[2];
+    const float f21 = F21[3], f22 = F21[4], f23 = F21[5];
+    const float f31 = F21[6], f32 = F21[7], f33 = F21[8];
+
+    const float maxPerPoint = 2.f * thScore;
+    float score = 0;
+
+    int i = 0;
+    while (i < n) {
+        const int iEnd = std::min(n, i + BLOCK);
+
+#if defined(__AVX__)
+        __m256 vscore = _mm256_setzero_ps();
+        const __m256 vth = _mm256_set1_ps(th);
+        const __m256 vthScore = _mm256_set1_ps(thScore);
+        const __m256 vinvSigma2 = _mm256_set1_ps(invSigmaSquare);
+        for (; i + 8 <= iEnd; i += 8) {
+            const __m256 U1 = _mm256_loadu_ps(u1 + i);
+            const __m256 V1 = _mm256_loadu_ps(v1 + i);
+            const __m256 U2 = _mm256_loadu_ps(u2 + i);
+            const __m256 V2 = _mm256_loadu_ps(v2 + i);
+
+            // l2=F21x1=(a2,b2,c2)
+            const __m256 a2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(f11), U1), _mm256_mul_ps(_mm256_set1_ps(f12), V1)), _mm256_set1_ps(f13));
+            const __m256 b2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(f21), U1), _mm256_mul_ps(_mm256_set1_ps(f22), V1)), _mm256_set1_ps(f23));
+            const __m256 c2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(f31), U1), _mm256_mul_ps(_mm256_set1_ps(f32), V1)), _mm256_set1_ps(f33));
+            const __m256 num2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a2, U2), _mm256_mul_ps(b2, V2)), c2);
+            const __m256 chi1 = _mm256_mul_ps(_mm256_div_ps(_mm256_mul_ps(num2, num2), _mm256_add_ps(_mm256_mul_ps(a2, a2), _mm256_mul_ps(b2, b2))), vinvSigma2);
+
+            // l1 =x2tF21=(a1,b1,c1)
+            const __m256 a1 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(f11), U2), _mm256_mul_ps(_mm256_set1_ps(f21), V2)), _mm256_set1_ps(f31));
+            const __m256 b1 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(f12), U2), _mm256_mul_ps(_mm256_set1_ps(f22), V2)), _mm256_set1_ps(f32));
+            const __m256 c1 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(f13), U2), _mm256_mul_ps(_mm256_set1_ps(f23), V2)), _mm256_set1_ps(f33));
+            const __m256 num1 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a1, U1), _mm256_mul_ps(b1, V1)), c1);
+            const __m256 chi2 = _mm256_mul_ps(_mm256_div_ps(_mm256_mul_ps(num1, num1), _mm256_add_ps(_mm256_mul_ps(a1, a1), _mm256_mul_ps(b1, b1))), vinvSigma2);
+
+            const __m256 in1 = _mm256_cmp_ps(chi1, vth, _CMP_LE_OQ);
+            const __m256 in2 = _mm256_cmp_ps(chi2, vth, _CMP_LE_OQ);
+            vscore = _mm256_add_ps(vscore, _mm256_and_ps(in1, _mm256_sub_ps(vthScore, chi1)));
+            vscore = _mm256_add_ps(vscore, _mm256_and_ps(in2, _mm256_sub_ps(vthScore, chi2)));
+            StoreMask(_mm256_movemask_ps(_mm256_and_ps(in1, in2)), vbInliers + i);
+        }
+        score += HorizontalSum(vscore);
+#endif
+
+        for (; i < iEnd; i++) {
+            bool bIn = true;
+
+            const float a2 = f11 * u1[i] + f12 * v1[i] + f13;
+            const float b2 = f21 * u1[i] + f22 * v1[i] + f23;
+            const float c2 = f31 * u1[i] + f32 * v1[i] + f33;
+            const float num2 = a2 * u2[i] + b2 * v2[i] + c2;
+            const float chiSquare1 = num2 * num2 / (a2 * a2 + b2 * b2) * invSigmaSquare;
+
+            if (chiSquare1 <= th)
+                score += thScore - chiSquare1;
+            else
+                bIn = false;
+
+            const float a1 = f11 * u2[i] + f21 * v2[i] + f31;
+            const float b1 = f12 * u2[i] + f22 * v2[i] + f32;
+            const float c1 = f13 * u2[i] + f23 * v2[i] + f33;
+            const float num1 = a1 * u1[i] + b1 * v1[i] + c1;
+            const float chiSquare2 = num1 * num1 / (a1 * a1 + b1 * b1) * invSigmaSquare;
+
+            if (chiSquare2 <= th)
+                score += thScore - chiSquare2;
+            else
+                bIn = false;
+
+            vbInliers[i] = bIn;
+        }
+
+        if (score + (n - i) * maxPerPoint <= bestScore)
+            return ABANDONED;
+    }
+
+    return score;
+}
+
+int Ransac::ReprojectionInliers(const float* R, const float* t, float fx, float fy, float cx, float cy,
+                                const float* X, const float* Y, const float* Z,
+                                const float* u, const float* v, const float* maxError, int n,
+                                const unsigned char* vbMask, int minInliers, unsigned char* vbInliers)
+{
+    int nInliers = 0;
+
+    int i = 0;
+    while (i < n) {
+        const int iEnd = std::min(n, i + BLOCK);
+
+#if defined(__AVX__)
+        // A NaN error (point on the camera plane) compares false, as in the scalar loop
+        const __m256 vone = _mm256_set1_ps(1.0f);
+        for (; i + 8 <= iEnd; i += 8) {
+            const __m256 PX = _mm256_loadu_ps(X + i);
+            const __m256 PY = _mm256_loadu_ps(Y + i);
+            const __m256 PZ = _mm256_loadu_ps(Z + i);
+
+            const __m256 Xc = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(R[0]), PX), _mm256_mul_ps(_mm256_set1_ps(R[1]), PY)), _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(R[2]), PZ), _mm256_set1_ps(t[0])));
+            const __m256 Yc = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(R[3]), PX), _mm256_mul_ps(_mm256_set1_ps(R[4]), PY)), _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(R[5]), PZ), _mm256_set1_ps(t[1])));
+            const __m256 Zc = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(R[6]), PX), _mm256_mul_ps(_mm256_set1_ps(R[7]), PY)), _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(R[8]), PZ), _mm256_set1_ps(t[2])));
+            const __m256 invZc = _mm256_div_ps(vone, Zc);
+
+            const __m256 ue = _mm256_add_ps(_mm256_set1_ps(cx), _mm256_mul_ps(_mm256_set1_ps(fx), _mm256_mul_ps(Xc, invZc)));
+            const __m256 ve = _mm256_add_ps(_mm256_set1_ps(cy), _mm256_mul_ps(_mm256_set1_ps(fy), _mm256_mul_ps(Yc, invZc)));
+
+            const __m256 distX = _mm256_sub_ps(_mm256_loadu_ps(u + i), ue);
+            const __m256 distY = _mm256_sub_ps(_mm256_loadu_ps(v + i), ve);
+            const __m256 error2 = _mm256_add_ps(_mm256_mul_ps(distX, distX), _mm256_mul_ps(distY, distY));
+
+            int mask = _mm256_movemask_ps(_mm256_cmp_ps(error2, _mm256_loadu_ps(maxError + i), _CMP_LT_OQ));
+            if (vbMask) {
+                for (int k = 0; k < 8; k++)
+                    if (!vbMask[i + k])
+                        mask &= ~(1 << k);
+            }
+            StoreMask(mask, vbInliers + i);
+            nInliers += __builtin_popcount(mask);
+        }
+#endif
+
+        for (; i < iEnd; i++) {
+            const float Xc = R[0] * X[i] + R[1] * Y[i] + R[2] * Z[i] + t[0];
+            const float Yc = R[3] * X[i] + R[4] * Y[i] + R[5] * Z[i] + t[1];
+            const float invZc = 1.0f / (R[6] * X[i] + R[7] * Y[i] + R[8] * Z[i] + t[2]);
+
+            const float distX = u[i] - (cx + fx * Xc * invZc);
+            const float distY = v[i] - (cy + fy * Yc * invZc);
+            const float error2 = distX * distX + distY * distY;
+
+            const bool bIn = error2 < maxError[i] && (!vbMask || vbMask[i]);
+            vbInliers[i] = bIn;
+            nInliers += bIn;
+        }
+
+        if (nInliers + (n - i) < minInliers)
+            return ABANDONED;
+    }
+
+    return nInliers;
+}
+
+}  // namespace ORB_SLAM2
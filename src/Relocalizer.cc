@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#include "Relocalizer.h"
+
+#include "Frame.h"
+#include "KeyFrame.h"
+#include "ORBmatcher.h"
+#include "PnPsolver.h"
+#include "ThreadPool.h"
+
+namespace ORB_SLAM2 {
+
+Relocalizer::Relocalizer() : mpFrame(NULL) {}
+
+Relocalizer::~Relocalizer()
+{
+    Clear();
+}
+
+void Relocalizer::Clear()
+{
+    for (size_t i = 0; i < mvpPnPsolvers.size(); i++)
+        delete mvpPnPsolvers[i];
+    mvpPnPsolvers.clear();
+    mvActive.clear();
+    mpFrame = NULL;
+}
+
+void Relocalizer::SetCandidates(Frame* pF, const std::vector<KeyFrame*>& vpCandidateKFs)
+{
+    Clear();
+    mpFrame = pF;
+    mvpCandidateKFs = vpCandidateKFs;
+
+    const int nKFs = mvpCandidateKFs.size();
+    mvvpMapPointMatches.resize(nKFs);
+    mvpPnPsolvers.assign(nKFs, static_cast<PnPsolver*>(NULL));
+
+    // We perform first an ORB matching with each candidate
+    // If enough matches are found we setup a PnP solver
+    ThreadPool::ParallelFor(nKFs, ThreadPool::NumThreads(), [&](int i) {
+        KeyFrame* pKF = mvpCandidateKFs[i];
+        mvvpMapPointMatches[i].clear();
+        if (pKF->isBad())
+            return;
+
+        ORBmatcher matcher(0.75, true);
+        int nmatches = matcher.SearchByBoW(pKF, *mpFrame, mvvpMapPointMatches[i]);
+        if (nmatches < 15)
+            return;
+
+        PnPsolver* pSolver = new PnPsolver(*mpFrame, mvvpMapPointMatches[i]);
+        pSolver->SetRansacParameters(0.99, 10, 300, 4, 0.5, 5.991);
+        pSolver->SetSeed(0, i);
+        mvpPnPsolvers[i] = pSolver;
+    });
+
+    for (int i = 0; i < nKFs; i++)
+        if (mvpPnPsolvers[i])
+            mvActive.push_back(i);
+}
+
+bool Relocalizer::NextRound(std::vector<Hypothesis>& vHypotheses)
+{
+    vHypotheses.clear();
+    if (mvActive.empty())
+        return false;
+
+    // Perform 5 Ransac Iterations on every candidate. Each solver has its own
+    // sampler, so the hypotheses do not depend on the thread that computed them.
+    const int nActive = mvActive.size();
+    mvRound.resize(nActive);
+    mvbNoMore.assign(nActive, 0);
+    ThreadPool::ParallelFor(nActive, ThreadPool::NumThreads(), [&](int k) {
+        Hypothesis& hypothesis = mvRound[k];
+        hypothesis.nCandidate = mvActive[k];
+        bool bNoMore;
+        hypothesis.Tcw = mvpPnPsolvers[mvActive[k]]->iterate(5, bNoMore, hypothesis.vbInliers, hypothesis.nInliers);
+        mvbNoMore[k] = bNoMore;
+    });
+
+    // If Ransac reachs max. iterations discard keyframe
+    int nKept = 0;
+    for (int k = 0; k < nActive; k++) {
+        if (!mvRound[k].Tcw.empty())
+            vHypotheses.push_back(mvRound[k]);
+        if (!mvbNoMore[k])
+            mvActive[nKept++] = mvActive[k];
+    }
+    mvActive.resize(nKept);
+
+    return true;
+}
+
+}  // namespace ORB_SLAM2
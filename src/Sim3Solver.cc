@@ -27,8 +27,8 @@
 
 #include "KeyFrame.h"
 #include "ORBmatcher.h"
+#include "Ransac.h"
 
-#include "Thirdparty/DBoW2/DUtils/Random.h"
 
 namespace ORB_SLAM2
 {
@@ -48,17 +48,12 @@ Sim3Solver::Sim3Solver(KeyFrame *pKF1, KeyFrame *pKF2, const vector<MapPoint *>
     mvpMapPoints2.reserve(mN1);
     mvpMatches12 = vpMatched12;
     mvnIndices1.reserve(mN1);
-    mvX3Dc1.reserve(mN1);
-    mvX3Dc2.reserve(mN1);
 
     cv::Mat Rcw1 = pKF1->GetRotation();
     cv::Mat tcw1 = pKF1->GetTranslation();
     cv::Mat Rcw2 = pKF2->GetRotation();
     cv::Mat tcw2 = pKF2->GetTranslation();
 
-    mvAllIndices.reserve(mN1);
-
-    size_t idx=0;
     for(int i1=0; i1<mN1; i1++)
     {
         if(vpMatched12[i1])
@@ -84,29 +79,34 @@ Sim3Solver::Sim3Solver(KeyFrame *pKF1, KeyFrame *pKF2, const vector<MapPoint *>
             const float sigmaSquare1 = pKF1->mvLevelSigma2[kp1.octave];
             const float sigmaSquare2 = pKF2->mvLevelSigma2[kp2.octave];
 
-            mvnMaxError1.push_back(9.210*sigmaSquare1);
-            mvnMaxError2.push_back(9.210*sigmaSquare2);
+            mvMaxError1.push_back(9.210*sigmaSquare1);
+            mvMaxError2.push_back(9.210*sigmaSquare2);
 
             mvpMapPoints1.push_back(pMP1);
             mvpMapPoints2.push_back(pMP2);
             mvnIndices1.push_back(i1);
 
             cv::Mat X3D1w = pMP1->GetWorldPos();
-            mvX3Dc1.push_back(Rcw1*X3D1w+tcw1);
+            cv::Mat X3Dc1 = Rcw1*X3D1w+tcw1;
+            mvX1.push_back(X3Dc1.at<float>(0));
+            mvY1.push_back(X3Dc1.at<float>(1));
+            mvZ1.push_back(X3Dc1.at<float>(2));
 
             cv::Mat X3D2w = pMP2->GetWorldPos();
-            mvX3Dc2.push_back(Rcw2*X3D2w+tcw2);
-
-            mvAllIndices.push_back(idx);
-            idx++;
+            cv::Mat X3Dc2 = Rcw2*X3D2w+tcw2;
+            mvX2.push_back(X3Dc2.at<float>(0));
+            mvY2.push_back(X3Dc2.at<float>(1));
+            mvZ2.push_back(X3Dc2.at<float>(2));
         }
     }
 
     mK1 = pKF1->mK;
     mK2 = pKF2->mK;
 
-    FromCameraToImage(mvX3Dc1,mvP1im1,mK1);
-    FromCameraToImage(mvX3Dc2,mvP2im2,mK2);
+    FromCameraToImage(mvX1,mvY1,mvZ1,mvU1,mvV1,mK1);
+    FromCameraToImage(mvX2,mvY2,mvZ2,mvU2,mvV2,mK2);
+
+    mSampler.Reset(mvpMapPoints1.size());
 
     SetRansacParameters();
 }
@@ -149,10 +149,9 @@ cv::Mat Sim3Solver::iterate(int nIterations, bool &bNoMore, vector<bool> &vbInli
         return cv::Mat();
     }
 
-    vector<size_t> vAvailableIndices;
-
     cv::Mat P3Dc1i(3,3,CV_32F);
     cv::Mat P3Dc2i(3,3,CV_32F);
+    size_t vIndices[3];
 
     int nCurrentIterations = 0;
     while(mnIterations<mRansacMaxIts && nCurrentIterations<nIterations)
@@ -160,20 +159,18 @@ cv::Mat Sim3Solver::iterate(int nIterations, bool &bNoMore, vector<bool> &vbInli
         nCurrentIterations++;
         mnIterations++;
 
-        vAvailableIndices = mvAllIndices;
-
         // Get min set of points
+        mSampler.Sample(3,vIndices);
         for(short i = 0; i < 3; ++i)
         {
-            int randi = DUtils::Random::RandomInt(0, vAvailableIndices.size()-1);
-
-            int idx = vAvailableIndices[randi];
-
-            mvX3Dc1[idx].copyTo(P3Dc1i.col(i));
-            mvX3Dc2[idx].copyTo(P3Dc2i.col(i));
-
-            vAvailableIndices[randi] = vAvailableIndices.back();
-            vAvailableIndices.pop_back();
+            const size_t idx = vIndices[i];
+
+            P3Dc1i.at<float>(0,i) = mvX1[idx];
+            P3Dc1i.at<float>(1,i) = mvY1[idx];
+            P3Dc1i.at<float>(2,i) = mvZ1[idx];
+            P3Dc2i.at<float>(0,i) = mvX2[idx];
+            P3Dc2i.at<float>(1,i) = mvY2[idx];
+            P3Dc2i.at<float>(2,i) = mvZ2[idx];
         }
 
         ComputeSim3(P3Dc1i,P3Dc2i);
@@ -339,28 +336,32 @@ void Sim3Solver::ComputeSim3(cv::Mat &P1, cv::Mat &P2)
 
 void Sim3Solver::CheckInliers()
 {
-    vector<cv::Mat> vP1im2, vP2im1;
-    Project(mvX3Dc2,vP2im1,mT12i,mK1);
-    Project(mvX3Dc1,vP1im2,mT21i,mK2);
-
-    mnInliersi=0;
-
-    for(size_t i=0; i<mvP1im1.size(); i++)
+    float R12[9], t12[3], R21[9], t21[3];
+    for(int r=0; r<3; r++)
     {
-        cv::Mat dist1 = mvP1im1[i]-vP2im1[i];
-        cv::Mat dist2 = vP1im2[i]-mvP2im2[i];
-
-        const float err1 = dist1.dot(dist1);
-        const float err2 = dist2.dot(dist2);
-
-        if(err1<mvnMaxError1[i] && err2<mvnMaxError2[i])
+        for(int c=0; c<3; c++)
         {
-            mvbInliersi[i]=true;
-            mnInliersi++;
+            R12[3*r+c] = mT12i.at<float>(r,c);
+            R21[3*r+c] = mT21i.at<float>(r,c);
         }
-        else
-            mvbInliersi[i]=false;
+        t12[r] = mT12i.at<float>(r,3);
+        t21[r] = mT21i.at<float>(r,3);
     }
+
+    // A hypothesis with fewer inliers than the best one is of no use, the
+    // scoring gives up on it as soon as it cannot reach mnBestInliers.
+
+    // Points of KF2 reprojected in KF1
+    mnInliersi = Ransac::ReprojectionInliers(R12, t12, mK1.at<float>(0,0), mK1.at<float>(1,1), mK1.at<float>(0,2), mK1.at<float>(1,2),
+                                             mvX2.data(), mvY2.data(), mvZ2.data(), mvU1.data(), mvV1.data(), mvMaxError1.data(), N,
+                                             NULL, mnBestInliers, mvbInliersi.data());
+    if(mnInliersi==Ransac::ABANDONED)
+        return;
+
+    // Points of KF1 reprojected in KF2, only for the inliers of the first pass
+    mnInliersi = Ransac::ReprojectionInliers(R21, t21, mK2.at<float>(0,0), mK2.at<float>(1,1), mK2.at<float>(0,2), mK2.at<float>(1,2),
+                                             mvX1.data(), mvY1.data(), mvZ1.data(), mvU2.data(), mvV2.data(), mvMaxError2.data(), N,
+                                             mvbInliersi.data(), mnBestInliers, mvbInliersi.data());
 }
 
 
@@ -379,46 +380,23 @@ float Sim3Solver::GetEstimatedScale()
     return mBestScale;
 }
 
-void Sim3Solver::Project(const vector<cv::Mat> &vP3Dw, vector<cv::Mat> &vP2D, cv::Mat Tcw, cv::Mat K)
-{
-    cv::Mat Rcw = Tcw.rowRange(0,3).colRange(0,3);
-    cv::Mat tcw = Tcw.rowRange(0,3).col(3);
-    const float &fx = K.at<float>(0,0);
-    const float &fy = K.at<float>(1,1);
-    const float &cx = K.at<float>(0,2);
-    const float &cy = K.at<float>(1,2);
-
-    vP2D.clear();
-    vP2D.reserve(vP3Dw.size());
-
-    for(size_t i=0, iend=vP3Dw.size(); i<iend; i++)
-    {
-        cv::Mat P3Dc = Rcw*vP3Dw[i]+tcw;
-        const float invz = 1/(P3Dc.at<float>(2));
-        const float x = P3Dc.at<float>(0)*invz;
-        const float y = P3Dc.at<float>(1)*invz;
-
-        vP2D.push_back((cv::Mat_<float>(2,1) << fx*x+cx, fy*y+cy));
-    }
-}
-
-void Sim3Solver::FromCameraToImage(const vector<cv::Mat> &vP3Dc, vector<cv::Mat> &vP2D, cv::Mat K)
+void Sim3Solver::FromCameraToImage(const vector<float> &vX, const vector<float> &vY, const vector<float> &vZ,
+                                   vector<float> &vU, vector<float> &vV, cv::Mat K)
 {
     const float &fx = K.at<float>(0,0);
     const float &fy = K.at<float>(1,1);
     const float &cx = K.at<float>(0,2);
     const float &cy = K.at<float>(1,2);
 
-    vP2D.clear();
-    vP2D.reserve(vP3Dc.size());
+    const size_t n = vX.size();
+    vU.resize(n);
+    vV.resize(n);
 
-    for(size_t i=0, iend=vP3Dc.size(); i<iend; i++)
+    for(size_t i=0; i<n; i++)
     {
-        const float invz = 1/(vP3Dc[i].at<float>(2));
-        const float x = vP3Dc[i].at<float>(0)*invz;
-        const float y = vP3Dc[i].at<float>(1)*invz;
-
-        vP2D.push_back((cv::Mat_<float>(2,1) << fx*x+cx, fy*y+cy));
+        const float invz = 1/vZ[i];
+        vU[i] = fx*vX[i]*invz+cx;
+        vV[i] = fy*vY[i]*invz+cy;
     }
 }
 
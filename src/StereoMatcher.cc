@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#include "StereoMatcher.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+namespace ORB_SLAM2 {
+
+void StereoRowIndex::Build(const std::vector<cv::KeyPoint>& vKeysRight, const std::vector<float>& vScaleFactors, int nRows)
+{
+    mnRows = nRows;
+    mvRowStart.assign(nRows + 1, 0);
+
+    const int Nr = vKeysRight.size();
+    std::vector<int> vMinR(Nr), vMaxR(Nr);
+
+    // 1. count keypoints per row
+    for (int iR = 0; iR < Nr; iR++) {
+        const cv::KeyPoint& kp = vKeysRight[iR];
+        const float& kpY = kp.pt.y;
+        const float r = 2.0f * vScaleFactors[kp.octave];
+        vMaxR[iR] = std::min((int)ceil(kpY + r), nRows - 1);
+        vMinR[iR] = std::max((int)floor(kpY - r), 0);
+
+        for (int yi = vMinR[iR]; yi <= vMaxR[iR]; yi++)
+            mvRowStart[yi + 1]++;
+    }
+
+    // 2. prefix sum
+    for (int y = 0; y < nRows; y++)
+        mvRowStart[y + 1] += mvRowStart[y];
+
+    // 3. fill, keeping the ascending keypoint order of the old per-row vectors
+    mvItems.resize(mvRowStart[nRows]);
+    std::vector<int> vFill(mvRowStart.begin(), mvRowStart.end() - 1);
+    for (int iR = 0; iR < Nr; iR++)
+        for (int yi = vMinR[iR]; yi <= vMaxR[iR]; yi++)
+            mvItems[vFill[yi]++] = iR;
+}
+
+// Patches are copied once into int16 buffers padded to 16 lanes, so both the
+// SIMD and the scalar path read only inside the buffers.
+bool StereoPatchMatcher::SearchRow(const cv::Mat& imL, const cv::Mat& imR, int uL, int vL, int uR0, float* vDists)
+{
+    const int P = 2 * W + 1;           // patch width
+    const int S = 2 * L + 2 * W + 1;  // right strip width
+
+    if (vL - W < 0 || vL + W >= imL.rows || vL + W >= imR.rows)
+        return false;
+    if (uL - W < 0 || uL + W >= imL.cols)
+        return false;
+    if (uR0 - L - W < 0 || uR0 + L + W >= imR.cols)
+        return false;
+
+    alignas(16) int16_t patchL[P][16];
+    alignas(16) int16_t stripR[P][32];
+
+    // left patch minus its center value
+    const int cL = imL.ptr<uchar>(vL)[uL];
+    for (int r = 0; r < P; r++) {
+        const uchar* pL = imL.ptr<uchar>(vL - W + r) + uL - W;
+        for (int c = 0; c < P; c++)
+            patchL[r][c] = pL[c] - cL;
+        for (int c = P; c < 16; c++)
+            patchL[r][c] = 0;
+    }
+
+    for (int r = 0; r < P; r++) {
+        const uchar* pR = imR.ptr<uchar>(vL - W + r) + uR0 - L - W;
+        for (int c = 0; c < S; c++)
+            stripR[r][c] = pR[c];
+        for (int c = S; c < 32; c++)
+            stripR[r][c] = 0;
+    }
+
+#if defined(__SSSE3__)
+    // lanes 11..15 do not belong to the patch
+    const __m128i mask_hi = _mm_setr_epi16(-1, -1, -1, 0, 0, 0, 0, 0);
+    const __m128i ones = _mm_set1_epi16(1);
+#endif
+
+    for (int incR = -L; incR <= L; incR++) {
+        const int j0 = incR + L;  // patch start in the strip
+        const int cR = stripR[W][j0 + W];
+        int dist = 0;
+
+#if defined(__SSSE3__)
+        const __m128i vcR = _mm_set1_epi16(cR);
+        __m128i acc = _mm_setzero_si128();
+        for (int r = 0; r < P; r++) {
+            const __m128i l0 = _mm_load_si128(reinterpret_cast<const __m128i*>(&patchL[r][0]));
+            const __m128i l1 = _mm_load_si128(reinterpret_cast<const __m128i*>(&patchL[r][8]));
+            const __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&stripR[r][j0]));
+            const __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&stripR[r][j0 + 8]));
+
+            // (IL - cL) - (IR - cR)
+            const __m128i d0 = _mm_abs_epi16(_mm_add_epi16(_mm_sub_epi16(l0, r0), vcR));
+            const __m128i d1 = _mm_and_si128(_mm_abs_epi16(_mm_add_epi16(_mm_sub_epi16(l1, r1), vcR)), mask_hi);
+
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(d0, ones));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(d1, ones));
+        }
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+        dist = _mm_cvtsi128_si32(acc);
+#else
+        for (int r = 0; r < P; r++)
+            for (int c = 0; c < P; c++)
+                dist += abs(patchL[r][c] - stripR[r][j0 + c] + cR);
+#endif
+
+        vDists[L + incR] = dist;
+    }
+
+    return true;
+}
+
+}  // namespace ORB_SLAM2
@@ -10,6 +10,7 @@
 
 #include "System.h"
 #include "Converter.h"
+#include "Thirdparty/g2o/g2o/core/openmp_mutex.h"
 #include <unistd.h>
 #include <thread>
 #include <pangolin/pangolin.h>
@@ -43,12 +44,17 @@ System::System(const string &strVocFile, const string &strSettingsFile, const eS
        exit(-1);
     }
 
+    // Threads used by g2o to evaluate the edges of every optimization (missing or 1: serial)
+    int nOptimizerThreads = fsSettings["Optimizer.nThreads"];
+    g2o::setNumThreads(nOptimizerThreads);
+
 
     //Load ORB Vocabulary
+    // ORBvoc.bin (see tools/bin_vocabulary) loads much faster than ORBvoc.txt
     cout << endl << "Loading ORB Vocabulary. This could take a while..." << endl;
 
     mpVocabulary = new ORBVocabulary();
-    bool bVocLoad = mpVocabulary->loadFromTextFile(strVocFile);
+    bool bVocLoad = mpVocabulary->load(strVocFile);
     if(!bVocLoad)
     {
         cerr << "Wrong path to vocabulary. " << endl;
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace ORB_SLAM2 {
+
+ThreadPool& ThreadPool::Instance()
+{
+    // never destroyed, the workers live as long as the process
+    static ThreadPool* pPool = new ThreadPool();
+    return *pPool;
+}
+
+ThreadPool::ThreadPool()
+{
+    mnThreads = std::max(1u, std::thread::hardware_concurrency());
+    mvWorkers.reserve(mnThreads - 1);
+    for (int t = 1; t < mnThreads; t++)
+        mvWorkers.push_back(std::thread(&ThreadPool::Worker, this));
+}
+
+void ThreadPool::Run(int n, int nThreads, const std::function<void(int, int)>& range)
+{
+    nThreads = std::max(1, std::min(std::min(nThreads, n), mnThreads));
+
+    Job job;
+    job.pRange = &range;
+    job.n = n;
+    job.nChunk = (n + nThreads - 1) / nThreads;
+    job.nChunks = (n + job.nChunk - 1) / job.nChunk;
+    job.nNext = 0;
+    job.nDone = 0;
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mqJobs.push_back(&job);
+    mCondJobs.notify_all();
+
+    // The caller works on its own job, so it never waits for workers that
+    // are busy elsewhere
+    while (job.nNext < job.nChunks)
+        RunChunk(job, lock);
+
+    while (job.nDone < job.nChunks)
+        mCondDone.wait(lock);
+}
+
+void ThreadPool::RunChunk(Job& job, std::unique_lock<std::mutex>& lock)
+{
+    const int c = job.nNext++;
+    if (job.nNext == job.nChunks)
+        mqJobs.erase(std::find(mqJobs.begin(), mqJobs.end(), &job));
+
+    lock.unlock();
+    const int iBegin = c * job.nChunk;
+    const int iEnd = std::min(job.n, iBegin + job.nChunk);
+    (*job.pRange)(iBegin, iEnd);
+    lock.lock();
+
+    // job may be gone as soon as the caller sees the last chunk done
+    if (++job.nDone == job.nChunks)
+        mCondDone.notify_all();
+}
+
+void ThreadPool::Worker()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        while (mqJobs.empty())
+            mCondJobs.wait(lock);
+        RunChunk(*mqJobs.front(), lock);
+    }
+}
+
+}  // namespace ORB_SLAM2
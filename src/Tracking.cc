@@ -15,6 +15,8 @@
 #include <unistd.h>
 #include "Frame.h"
 #include "ORBmatcher.h"
+#include "HammingMatcher.h"
+#include "MapPointStore.h"
 #include "FrameDrawer.h"
 #include "Converter.h"
 #include "Map.h"
@@ -22,6 +24,7 @@
 
 #include "Optimizer.h"
 #include "PnPsolver.h"
+#include "Relocalizer.h"
 
 #include <iostream>
 
@@ -670,7 +673,7 @@ void Tracking::StereoInitialization()
         mpLastKeyFrame = pKFini;
 
         mvpLocalKeyFrames.push_back(pKFini);
-        mvpLocalMapPoints=mpMap->GetAllMapPoints();
+        mpMap->GetAllMapPoints(mvpLocalMapPoints);
         mpReferenceKF = pKFini;
         mCurrentFrame.mpReferenceKF = pKFini;
 
@@ -846,7 +849,7 @@ void Tracking::CreateInitialMapMonocular()
 
     mvpLocalKeyFrames.push_back(pKFcur);
     mvpLocalKeyFrames.push_back(pKFini);
-    mvpLocalMapPoints=mpMap->GetAllMapPoints();
+    mpMap->GetAllMapPoints(mvpLocalMapPoints);
     mpReferenceKF = pKFcur;
     mCurrentFrame.mpReferenceKF = pKFcur;
 
@@ -1369,6 +1372,7 @@ void Tracking::SearchLocalPoints()
     int nToMatch=0;
 
     // Project points in frame and check its visibility
+    mvpFrustumCandidates.clear();
     for(vector<MapPoint*>::iterator vit=mvpLocalMapPoints.begin(), vend=mvpLocalMapPoints.end(); vit!=vend; vit++)
     {
         MapPoint* pMP = *vit;
@@ -1376,11 +1380,20 @@ void Tracking::SearchLocalPoints()
             continue;
         if(pMP->isBad())
             continue;
-        // Project (this fills MapPoint variables for matching)
-        if(mCurrentFrame.isInFrustum(pMP,0.5))
+        mvpFrustumCandidates.push_back(pMP);
+    }
+
+    // Project (this fills MapPoint variables for matching)
+    if(mCurrentFrame.isInFrustum(mvpFrustumCandidates,0.5,mvFrustumBuffer)>0)
+    {
+        for(size_t i=0; i<mvpFrustumCandidates.size(); i++)
         {
-            pMP->IncreaseVisible();
-            nToMatch++;
+            MapPoint* pMP = mvpFrustumCandidates[i];
+            if(pMP->mbTrackInView)
+            {
+                pMP->IncreaseVisible();
+                nToMatch++;
+            }
         }
     }
 
@@ -1444,9 +1457,10 @@ void Tracking::UpdateLocalKeyFrames()
             MapPoint* pMP = mCurrentFrame.mvpMapPoints[i];
             if(!pMP->isBad())
             {
-                const map<KeyFrame*,size_t> observations = pMP->GetObservations();
-                for(map<KeyFrame*,size_t>::const_iterator it=observations.begin(), itend=observations.end(); it!=itend; it++)
-                    keyframeCounter[it->first]++;
+                pMP->ForEachObservation([&](KeyFrame* pKF, size_t)
+                {
+                    keyframeCounter[pKF]++;
+                });
             }
             else
             {
@@ -1484,6 +1498,7 @@ void Tracking::UpdateLocalKeyFrames()
 
 
     // Include also some not-already-included keyframes that are neighbors to already-included keyframes
+    vector<KeyFrame*> vNeighs;
     for(vector<KeyFrame*>::const_iterator itKF=mvpLocalKeyFrames.begin(), itEndKF=mvpLocalKeyFrames.end(); itKF!=itEndKF; itKF++)
     {
         // Limit the number of keyframes
@@ -1492,7 +1507,7 @@ void Tracking::UpdateLocalKeyFrames()
 
         KeyFrame* pKF = *itKF;
 
-        const vector<KeyFrame*> vNeighs = pKF->GetBestCovisibilityKeyFrames(10);
+        pKF->GetBestCovisibilityKeyFrames(10,vNeighs);
 
         for(vector<KeyFrame*>::const_iterator itNeighKF=vNeighs.begin(), itEndNeighKF=vNeighs.end(); itNeighKF!=itEndNeighKF; itNeighKF++)
         {
@@ -1555,144 +1570,92 @@ bool Tracking::Relocalization(int update)
     if(vpCandidateKFs.empty())
         return false;
 
-    const int nKFs = vpCandidateKFs.size();
-
-    // We perform first an ORB matching with each candidate
-    // If enough matches are found we setup a PnP solver
-    ORBmatcher matcher(0.75,true);
-
-    vector<PnPsolver*> vpPnPsolvers;
-    vpPnPsolvers.resize(nKFs);
-
-    vector<vector<MapPoint*> > vvpMapPointMatches;
-    vvpMapPointMatches.resize(nKFs);
-
-    vector<bool> vbDiscarded;
-    vbDiscarded.resize(nKFs);
-
-    int nCandidates=0;
-
-    for(int i=0; i<nKFs; i++)
-    {
-        KeyFrame* pKF = vpCandidateKFs[i];
-        if(pKF->isBad())
-            vbDiscarded[i] = true;
-        else
-        {
-            int nmatches = matcher.SearchByBoW(pKF,mCurrentFrame,vvpMapPointMatches[i]);
-            if(nmatches<15)
-            {
-                vbDiscarded[i] = true;
-                continue;
-            }
-            else
-            {
-                PnPsolver* pSolver = new PnPsolver(mCurrentFrame,vvpMapPointMatches[i]);
-                pSolver->SetRansacParameters(0.99,10,300,4,0.5,5.991);
-                vpPnPsolvers[i] = pSolver;
-                nCandidates++;
-            }
-        }
-    }
-
-    // Alternatively perform some iterations of P4P RANSAC
+    // BoW matching and P4P RANSAC run in parallel over the candidates, the pose
+    // hypotheses of each round are optimized here in candidate order.
     // Until we found a camera pose supported by enough inliers
+    mRelocalizer.SetCandidates(&mCurrentFrame,vpCandidateKFs);
+
     bool bMatch = false;
     ORBmatcher matcher2(0.9,true);
 
-    while(nCandidates>0 && !bMatch)
+    vector<Relocalizer::Hypothesis> vHypotheses;
+    while(!bMatch && mRelocalizer.NextRound(vHypotheses))
     {
-        for(int i=0; i<nKFs; i++)
+        for(size_t h=0; h<vHypotheses.size() && !bMatch; h++)
         {
-            if(vbDiscarded[i])
-                continue;
-
-            // Perform 5 Ransac Iterations
-            vector<bool> vbInliers;
-            int nInliers;
-            bool bNoMore;
-
-            PnPsolver* pSolver = vpPnPsolvers[i];
-            cv::Mat Tcw = pSolver->iterate(5,bNoMore,vbInliers,nInliers);
-
-            // If Ransac reachs max. iterations discard keyframe
-            if(bNoMore)
-            {
-                vbDiscarded[i]=true;
-                nCandidates--;
-            }
+            const Relocalizer::Hypothesis &hypothesis = vHypotheses[h];
+            const int i = hypothesis.nCandidate;
+            const vector<MapPoint*> &vpMapPointMatches = mRelocalizer.GetMatches(i);
+            const vector<bool> &vbInliers = hypothesis.vbInliers;
 
             // If a Camera Pose is computed, optimize
-            if(!Tcw.empty())
-            {
-                Tcw.copyTo(mCurrentFrame.mTcw);
+            hypothesis.Tcw.copyTo(mCurrentFrame.mTcw);
 
-                set<MapPoint*> sFound;
+            set<MapPoint*> sFound;
 
-                const int np = vbInliers.size();
+            const int np = vbInliers.size();
 
-                for(int j=0; j<np; j++)
+            for(int j=0; j<np; j++)
+            {
+                if(vbInliers[j])
                 {
-                    if(vbInliers[j])
-                    {
-                        mCurrentFrame.mvpMapPoints[j]=vvpMapPointMatches[i][j];
-                        sFound.insert(vvpMapPointMatches[i][j]);
-                    }
-                    else
-                        mCurrentFrame.mvpMapPoints[j]=NULL;
+                    mCurrentFrame.mvpMapPoints[j]=vpMapPointMatches[j];
+                    sFound.insert(vpMapPointMatches[j]);
                 }
+                else
+                    mCurrentFrame.mvpMapPoints[j]=NULL;
+            }
 
-                int nGood = Optimizer::PoseOptimization(&mCurrentFrame);
+            int nGood = Optimizer::PoseOptimization(&mCurrentFrame);
 
-                if(nGood<10)
-                    continue;
+            if(nGood<10)
+                continue;
 
-                for(int io =0; io<mCurrentFrame.N; io++)
-                    if(mCurrentFrame.mvbOutlier[io])
-                        mCurrentFrame.mvpMapPoints[io]=static_cast<MapPoint*>(NULL);
+            for(int io =0; io<mCurrentFrame.N; io++)
+                if(mCurrentFrame.mvbOutlier[io])
+                    mCurrentFrame.mvpMapPoints[io]=static_cast<MapPoint*>(NULL);
+
+            // If few inliers, search by projection in a coarse window and optimize again
+            if(nGood<50)
+            {
+                int nadditional =matcher2.SearchByProjection(mCurrentFrame,vpCandidateKFs[i],sFound,10,100);
 
-                // If few inliers, search by projection in a coarse window and optimize again
-                if(nGood<50)
+                if(nadditional+nGood>=50)
                 {
-                    int nadditional =matcher2.SearchByProjection(mCurrentFrame,vpCandidateKFs[i],sFound,10,100);
+                    nGood = Optimizer::PoseOptimization(&mCurrentFrame);
 
-                    if(nadditional+nGood>=50)
+                    // If many inliers but still not enough, search by projection again in a narrower window
+                    // the camera has been already optimized with many points
+                    if(nGood>30 && nGood<50)
                     {
-                        nGood = Optimizer::PoseOptimization(&mCurrentFrame);
-
-                        // If many inliers but still not enough, search by projection again in a narrower window
-                        // the camera has been already optimized with many points
-                        if(nGood>30 && nGood<50)
+                        sFound.clear();
+                        for(int ip =0; ip<mCurrentFrame.N; ip++)
+                            if(mCurrentFrame.mvpMapPoints[ip])
+                                sFound.insert(mCurrentFrame.mvpMapPoints[ip]);
+                        nadditional =matcher2.SearchByProjection(mCurrentFrame,vpCandidateKFs[i],sFound,3,64);
+
+                        // Final optimization
+                        if(nGood+nadditional>=50)
                         {
-                            sFound.clear();
-                            for(int ip =0; ip<mCurrentFrame.N; ip++)
-                                if(mCurrentFrame.mvpMapPoints[ip])
-                                    sFound.insert(mCurrentFrame.mvpMapPoints[ip]);
-                            nadditional =matcher2.SearchByProjection(mCurrentFrame,vpCandidateKFs[i],sFound,3,64);
-
-                            // Final optimization
-                            if(nGood+nadditional>=50)
-                            {
-                                nGood = Optimizer::PoseOptimization(&mCurrentFrame);
+                            nGood = Optimizer::PoseOptimization(&mCurrentFrame);
 
-                                for(int io =0; io<mCurrentFrame.N; io++)
-                                    if(mCurrentFrame.mvbOutlier[io])
-                                        mCurrentFrame.mvpMapPoints[io]=NULL;
-                            }
+                            for(int io =0; io<mCurrentFrame.N; io++)
+                                if(mCurrentFrame.mvbOutlier[io])
+                                    mCurrentFrame.mvpMapPoints[io]=NULL;
                         }
                     }
                 }
+            }
 
 
-                // If the pose is supported by enough inliers stop ransacs and continue
-                if(nGood>=50)
-                {
-                    bMatch = true;
-                    break;
-                }
+            // If the pose is supported by enough inliers stop ransacs and continue
+            if(nGood>=50)
+            {
+                bMatch = true;
             }
         }
     }
+    mRelocalizer.Clear();
 
     if(!bMatch)
     {
@@ -1820,6 +1783,7 @@ void Tracking::PredictSemanticMask(KeyFrame* lastKF, KeyFrame* currentKF)
     
     const cv::Mat twc = -Rcw.t() * tcw;
 
+    const MapPointStore& store = MapPointStore::Instance();
     for (size_t i = 0; i < currentKF->N; i++) {
         MapPoint* pMP = currentKF->mvpMapPoints[i];
         bool bCreateNew = false;    //默认不创建
@@ -1847,8 +1811,10 @@ void Tracking::PredictSemanticMask(KeyFrame* lastKF, KeyFrame* currentKF)
             currentKF->mvpTemptMapPoints.push_back(pMP);
         }
 
-        // project
-        cv::Mat x3Dw = pMP->GetWorldPos();
+        // project, the point data comes from the MapPointStore
+        float P[3], Normal[3], fMinDistance, fMaxDistance;
+        store.GetGeometry(pMP->mnHandle, P, Normal, fMinDistance, fMaxDistance);
+        const cv::Mat x3Dw(3, 1, CV_32F, P);
         cv::Mat x3Dc = Rcw * x3Dw + tcw;
 
         const float invzc = 1.0/x3Dc.at<float>(2);
@@ -1869,14 +1835,14 @@ void Tracking::PredictSemanticMask(KeyFrame* lastKF, KeyFrame* currentKF)
         cv::Mat PO = x3Dw - twc;
         float dist3D = cv::norm(PO);
 
-        const float maxDistance = pMP->GetMaxDistanceInvariance();
-        const float minDistance = pMP->GetMinDistanceInvariance();
+        const float maxDistance = 1.2f * fMaxDistance;
+        const float minDistance = 0.8f * fMinDistance;
 
         // Depth must be inside the scale pyramid of the image
         if (dist3D < minDistance || dist3D > maxDistance)
             continue;
 
-        int nPredictedLevel = pMP->PredictScale(dist3D, lastKF);
+        int nPredictedLevel = MapPointStore::PredictScale(fMaxDistance, dist3D, lastKF->mfLogScaleFactor, lastKF->mnScaleLevels);
         // Search in a window
         int th = 15;
         const float radius = th * lastKF->mvScaleFactors[nPredictedLevel];
@@ -1884,44 +1850,39 @@ void Tracking::PredictSemanticMask(KeyFrame* lastKF, KeyFrame* currentKF)
         
         if (vIndices2.empty())
             continue;
-        const cv::Mat dMP = pMP->GetDescriptor();
-
-        int bestDist = 256;
-        int bestIdx2 = -1;
-
-        for (vector<size_t>::const_iterator vit = vIndices2.begin(); vit != vIndices2.end(); vit++) {
-            const size_t i2 = *vit;
-            // if (currentKF->mvpMapPoints[i2])
-            //     continue;
-            const cv::Mat& d = lastKF->mDescriptors.row(i2);
-
-            const int dist = ORBmatcher::DescriptorDistance(dMP, d);
-
-            if (dist < bestDist) {
-                bestDist = dist;
-                bestIdx2 = i2;
-            }
-            // TH_HIGH = 100
-            if (bestDist <= 100) {
-                cv::KeyPoint kp1 = currentKF->mvKeys[i];
-                if (lastKF->mvbKptOutliers[bestIdx2]) {
-                    cv::circle(showCurrent, kp1.pt, 2, cv::Scalar(0, 0, 255), -1);
-                    vForeground.push_back(kp1.pt);
-                    // update outlier information
-                    currentKF->mvbKptOutliers[i] = true;
-                    pMP->mMovingProbability = 1;
-                    pMP->SetBadFlag();
-                } else {
-                    cv::circle(showCurrent, kp1.pt, 2, cv::Scalar(255, 0, 0), -1);
-                    vBackground.push_back(kp1.pt);
-                }
+        unsigned char descriptor[MapPointStore::DESC_BYTES];
+        store.GetDescriptor(pMP->mnHandle, descriptor);
+        const cv::Mat dMP(1, MapPointStore::DESC_BYTES, CV_8U, descriptor);
+
+        // if (currentKF->mvpMapPoints[i2])
+        //     continue;
+        const HammingMatcher::Result best = HammingMatcher::SearchBest(dMP, lastKF->mDescriptors, vIndices2);
+        const int bestDist = best.bestDist;
+        const int bestIdx2 = best.bestIdx;
+
+        // TH_HIGH = 100
+        if (bestDist <= ORBmatcher::TH_HIGH) {
+            cv::KeyPoint kp1 = currentKF->mvKeys[i];
+            if (lastKF->mvbKptOutliers[bestIdx2]) {
+                cv::circle(showCurrent, kp1.pt, 2, cv::Scalar(0, 0, 255), -1);
+                vForeground.push_back(kp1.pt);
+                // update outlier information
+                currentKF->mvbKptOutliers[i] = true;
+                pMP->SetMovingProbability(1);
+                pMP->SetBadFlag();
+            } else {
+                cv::circle(showCurrent, kp1.pt, 2, cv::Scalar(255, 0, 0), -1);
+                vBackground.push_back(kp1.pt);
             }
-
-            // TODO update covision graph
-            // if (!currentKF->mvpTemptMapPoints[bestIdx2])
-            //     currentKF->mvpTemptMapPoints[bestIdx2] = pMP;
-            nmatches++;
         }
+
+        // TODO update covision graph
+        // if (!currentKF->mvpTemptMapPoints[bestIdx2])
+        //     currentKF->mvpTemptMapPoints[bestIdx2] = pMP;
+
+        // counted once per candidate keypoint in the window, as the per-candidate
+        // loop did, the nmatches<20 check below relies on that
+        nmatches += vIndices2.size();
     }
 
     if (nmatches < 20) {
@@ -1986,6 +1947,7 @@ void Tracking::PredictFeatureProbability(KeyFrame* lastKF, KeyFrame* currentKF)
     cv::Mat Rcw = lastKF->GetPose().rowRange(0, 3).colRange(0, 3);
     cv::Mat tcw = lastKF->GetPose().rowRange(0, 3).col(3);
     cv::Mat Ow = -Rcw.t() * tcw;
+    const MapPointStore& store = MapPointStore::Instance();
     for (size_t i = 0; i < currentKF->N; i++) {
         MapPoint* pMP = currentKF->mvpMapPoints[i];
         if (!pMP)
@@ -1993,8 +1955,10 @@ void Tracking::PredictFeatureProbability(KeyFrame* lastKF, KeyFrame* currentKF)
         if (pMP->isBad())
             continue;
 
-        // project
-        cv::Mat x3Dw = pMP->GetWorldPos();
+        // project, the point data comes from the MapPointStore
+        float P[3], Normal[3], fMinDistance, fMaxDistance;
+        store.GetGeometry(pMP->mnHandle, P, Normal, fMinDistance, fMaxDistance);
+        const cv::Mat x3Dw(3, 1, CV_32F, P);
         cv::Mat x3Dc = Rcw * x3Dw + tcw;
 
         //cv::Point2f uv = lastKF->mpCamera->project(x3Dc);
@@ -2031,54 +1995,50 @@ void Tracking::PredictFeatureProbability(KeyFrame* lastKF, KeyFrame* currentKF)
         cv::Mat PO = x3Dw - Ow;
         float dist3D = cv::norm(PO);
 
-        const float maxDistance = pMP->GetMaxDistanceInvariance();
-        const float minDistance = pMP->GetMinDistanceInvariance();
+        const float maxDistance = 1.2f * fMaxDistance;
+        const float minDistance = 0.8f * fMinDistance;
 
         // Depth must be inside the scale pyramid of the image
         if (dist3D < minDistance || dist3D > maxDistance)
             continue;
 
-        int nPredictedLevel = pMP->PredictScale(dist3D, lastKF);
+        int nPredictedLevel = MapPointStore::PredictScale(fMaxDistance, dist3D, lastKF->mfLogScaleFactor, lastKF->mnScaleLevels);
         // Search in a window
         int th = 15;
         const float radius = th * lastKF->mvScaleFactors[nPredictedLevel];
         const vector<size_t> vIndices2 = lastKF->GetFeaturesInArea(uv.x, uv.y, radius);
         if (vIndices2.empty())
             continue;
-        const cv::Mat dMP = pMP->GetDescriptor();
-
-        int bestDist = 256;
-        int bestIdx2 = -1;
-
-        for (vector<size_t>::const_iterator vit = vIndices2.begin(); vit != vIndices2.end(); vit++) {
-            const size_t i2 = *vit;
-            const cv::Mat& d = lastKF->mDescriptors.row(i2);
-            const int dist = ORBmatcher::DescriptorDistance(dMP, d);
-
-            if (dist < bestDist) {
-                bestDist = dist;
-                bestIdx2 = i2;
-            }
-            // TH_HIGH = 100
-            if (bestDist <= 100) {
-                cv::KeyPoint kp2 = currentKF->mvKeys[i];
-
-                if (lastKF->mvbKptOutliers[bestIdx2]) {
-                    cv::circle(showCurrent, kp2.pt, 2, cv::Scalar(0, 0, 255), -1);
-                    pMP->mMovingProbability = 1;
-                    currentKF->EraseMapPointMatch(i);
-                }
-                // else {
-                //     cv::circle(showCurrent, kp2.pt, 2, cv::Scalar(255, 0, 0), -1);
-                //     pMP->mMovingProbability = 0;
-                // }
+        unsigned char descriptor[MapPointStore::DESC_BYTES];
+        store.GetDescriptor(pMP->mnHandle, descriptor);
+        const cv::Mat dMP(1, MapPointStore::DESC_BYTES, CV_8U, descriptor);
+
+        const HammingMatcher::Result best = HammingMatcher::SearchBest(dMP, lastKF->mDescriptors, vIndices2);
+        const int bestDist = best.bestDist;
+        const int bestIdx2 = best.bestIdx;
+
+        // TH_HIGH = 100
+        if (bestDist <= ORBmatcher::TH_HIGH) {
+            cv::KeyPoint kp2 = currentKF->mvKeys[i];
+
+            if (lastKF->mvbKptOutliers[bestIdx2]) {
+                cv::circle(showCurrent, kp2.pt, 2, cv::Scalar(0, 0, 255), -1);
+                pMP->SetMovingProbability(1);
+                currentKF->EraseMapPointMatch(i);
             }
-
-            // TODO update covision graph
-            // if (!currentKF->mvpTemptMapPoints[bestIdx2])
-            //     currentKF->mvpTemptMapPoints[bestIdx2] = pMP;
-            nmatches++;
+            // else {
+            //     cv::circle(showCurrent, kp2.pt, 2, cv::Scalar(255, 0, 0), -1);
+            //     pMP->mMovingProbability = 0;
+            // }
         }
+
+        // TODO update covision graph
+        // if (!currentKF->mvpTemptMapPoints[bestIdx2])
+        //     currentKF->mvpTemptMapPoints[bestIdx2] = pMP;
+
+        // counted once per candidate keypoint in the window, as the per-candidate
+        // loop did, the nmatches<20 check below relies on that
+        nmatches += vIndices2.size();
     }
     // TODO how to do if no enough matches
     if (nmatches < 20) {
@@ -2118,9 +2078,11 @@ void Tracking::SemanticUpdateLocalKeyFrames(KeyFrame& currentKF)
                 if (Semantic::GetInstance()->IsDynamicMapPoint(pMP))    //如果是动态点就跳出
                     continue;
 
-                const map<KeyFrame*, size_t> observations = pMP->GetObservations();   //索引关联
-                for (map<KeyFrame*,size_t>::const_iterator it = observations.begin(), itend = observations.end(); it != itend; it++)
-                    keyframeCounter[it->first]++;   //数据存储在keyframeCounter
+                //索引关联, 数据存储在keyframeCounter
+                pMP->ForEachObservation([&](KeyFrame* pKF, size_t)
+                {
+                    keyframeCounter[pKF]++;
+                });
             } else {
                 currentKF.mvpMapPoints[i] = NULL;
             }
@@ -2149,6 +2111,7 @@ void Tracking::SemanticUpdateLocalKeyFrames(KeyFrame& currentKF)
     }
 
     // Include also some not-already-included keyframes that are neighbors to already-included keyframes
+    vector<KeyFrame*> vNeighs;
     for (vector<KeyFrame *>::const_iterator itKF = mvpSemanticLocalKeyFrames.begin(), itEndKF = mvpSemanticLocalKeyFrames.end(); itKF != itEndKF; itKF++)
     {
         if (mvpSemanticLocalKeyFrames.size() > 80) // 80
@@ -2156,7 +2119,7 @@ void Tracking::SemanticUpdateLocalKeyFrames(KeyFrame& currentKF)
 
         KeyFrame* pKF = *itKF;
 
-        const vector<KeyFrame*> vNeighs = pKF->GetBestCovisibilityKeyFrames(10);
+        pKF->GetBestCovisibilityKeyFrames(10,vNeighs);
 
         for (vector<KeyFrame *>::const_iterator itNeighKF = vNeighs.begin(), itEndNeighKF = vNeighs.end(); itNeighKF != itEndNeighKF; itNeighKF++) {
             KeyFrame* pNeighKF = *itNeighKF;
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#include "UndistortionMap.h"
+
+#include <algorithm>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace ORB_SLAM2 {
+
+UndistortionMap::UndistortionMap() : mnCols(0), mnRows(0)
+{
+}
+
+void UndistortionMap::Build(const cv::Mat& K, const cv::Mat& DistCoef, int cols, int rows)
+{
+    mK = K.clone();
+    mDistCoef = DistCoef.clone();
+    mnCols = cols;
+    mnRows = rows;
+
+    const int W = cols + 1;
+    const int H = rows + 1;
+
+    // one undistortPoints call over the whole integer pixel grid
+    cv::Mat grid(W * H, 1, CV_32FC2);
+    for (int y = 0; y < H; y++) {
+        cv::Vec2f* p = grid.ptr<cv::Vec2f>(y * W);
+        for (int x = 0; x < W; x++)
+            p[x] = cv::Vec2f(x, y);
+    }
+    cv::undistortPoints(grid, grid, mK, mDistCoef, cv::Mat(), mK);
+
+    mvMap.resize(2 * W * H);
+    const float* pg = grid.ptr<float>();
+    std::copy(pg, pg + 2 * W * H, mvMap.begin());
+}
+
+inline bool UndistortionMap::Lookup(float x, float y, float& xu, float& yu) const
+{
+    if (!(x >= 0.f && y >= 0.f && x <= mnCols && y <= mnRows))
+        return false;
+
+    // points on the last grid row/column (e.g. image corners) use the cell before it
+    const int x0 = std::min(static_cast<int>(x), mnCols - 1);
+    const int y0 = std::min(static_cast<int>(y), mnRows - 1);
+    const float ax = x - x0;
+    const float ay = y - y0;
+
+    const int W = mnCols + 1;
+    const float* p00 = &mvMap[2 * (y0 * W + x0)];
+    const float* p01 = p00 + 2;
+    const float* p10 = p00 + 2 * W;
+    const float* p11 = p10 + 2;
+
+    const float w00 = (1.f - ax) * (1.f - ay);
+    const float w01 = ax * (1.f - ay);
+    const float w10 = (1.f - ax) * ay;
+    const float w11 = ax * ay;
+
+    xu = w00 * p00[0] + w01 * p01[0] + w10 * p10[0] + w11 * p11[0];
+    yu = w00 * p00[1] + w01 * p01[1] + w10 * p10[1] + w11 * p11[1];
+    return true;
+}
+
+void UndistortionMap::UndistortExact(float x, float y, float& xu, float& yu) const
+{
+    cv::Mat pt(1, 1, CV_32FC2);
+    pt.at<cv::Vec2f>(0) = cv::Vec2f(x, y);
+    cv::undistortPoints(pt, pt, mK, mDistCoef, cv::Mat(), mK);
+    xu = pt.at<cv::Vec2f>(0)[0];
+    yu = pt.at<cv::Vec2f>(0)[1];
+}
+
+void UndistortionMap::UndistortPoints(const float* xy, int n, float* xyUn) const
+{
+    for (int i = 0; i < n; i++) {
+        const float x = xy[2 * i];
+        const float y = xy[2 * i + 1];
+        float xu, yu;
+        if (!Lookup(x, y, xu, yu))
+            UndistortExact(x, y, xu, yu);
+        xyUn[2 * i] = xu;
+        xyUn[2 * i + 1] = yu;
+    }
+}
+
+void UndistortionMap::UndistortKeyPoints(const std::vector<cv::KeyPoint>& vKeys, std::vector<cv::KeyPoint>& vKeysUn) const
+{
+    const size_t N = vKeys.size();
+    vKeysUn.resize(N);
+    for (size_t i = 0; i < N; i++) {
+        const cv::KeyPoint& kp = vKeys[i];
+        cv::KeyPoint& kpUn = vKeysUn[i];
+        kpUn = kp;
+        if (!Lookup(kp.pt.x, kp.pt.y, kpUn.pt.x, kpUn.pt.y))
+            UndistortExact(kp.pt.x, kp.pt.y, kpUn.pt.x, kpUn.pt.y);
+    }
+}
+
+}  // namespace ORB_SLAM2
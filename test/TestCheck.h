@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#ifndef _TEST_CHECK_H_
+#define _TEST_CHECK_H_
+
+#include <iostream>
+
+// 单元测试用的最小检查宏: 失败时打印位置并计数, 测试继续执行;
+// main 返回 TestResult(), 有失败时进程返回非零, ctest 据此判定。
+namespace ORB_SLAM2 {
+namespace test {
+
+inline int& Failures()
+{
+    static int nFailures = 0;
+    return nFailures;
+}
+
+inline int TestResult()
+{
+    if (Failures() > 0) {
+        std::cerr << Failures() << " check(s) failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+}  // namespace test
+}  // namespace ORB_SLAM2
+
+#define CHECK(cond)                                                                              \
+    do {                                                                                         \
+        if (!(cond)) {                                                                           \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed" << std::endl; \
+            ORB_SLAM2::test::Failures()++;                                                       \
+        }                                                                                        \
+    } while (0)
+
+#define CHECK_EQ(a, b) CHECK((a) == (b))
+
+#endif  // _TEST_CHECK_H_
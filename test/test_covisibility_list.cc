@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#include "CovisibilityList.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <vector>
+
+using namespace ORB_SLAM2;
+
+static KeyFrame* FakeKeyFrame(size_t i)
+{
+    // only compared, never dereferenced
+    return reinterpret_cast<KeyFrame*>(0x1000 + 64 * i);
+}
+
+// Ordered() against a (weight, pointer) decreasing sort of the reference map
+static bool OrderedMatches(CovisibilityList& list, const std::map<KeyFrame*, int>& ref)
+{
+    std::vector<std::pair<int, KeyFrame*> > vPairs;
+    for (std::map<KeyFrame*, int>::const_iterator it = ref.begin(); it != ref.end(); it++)
+        vPairs.push_back(std::make_pair(it->second, it->first));
+    std::sort(vPairs.rbegin(), vPairs.rend());
+
+    const std::vector<KeyFrame*>& vpOrdered = list.Ordered();
+    const std::vector<int>& vWeights = list.OrderedWeights();
+    if (vpOrdered.size() != vPairs.size() || vWeights.size() != vPairs.size())
+        return false;
+    for (size_t i = 0; i < vPairs.size(); i++)
+        if (vpOrdered[i] != vPairs[i].second || vWeights[i] != vPairs[i].first)
+            return false;
+    return true;
+}
+
+// Random Set/Erase against a std::map
+static void TestSetErase()
+{
+    std::mt19937 rng(3);
+    CovisibilityList list;
+    std::map<KeyFrame*, int> ref;
+
+    for (int it = 0; it < 2000; it++) {
+        KeyFrame* pKF = FakeKeyFrame(rng() % 50);
+        if (rng() % 4 == 0) {
+            CHECK_EQ(list.Erase(pKF), ref.erase(pKF) == 1);
+        } else {
+            const int w = 1 + rng() % 30;
+            const bool bChanged = !ref.count(pKF) || ref[pKF] != w;
+            ref[pKF] = w;
+            CHECK_EQ(list.Set(pKF, w), bChanged);
+        }
+
+        CHECK_EQ(list.Edges().size(), ref.size());
+        CHECK(std::is_sorted(list.Edges().begin(), list.Edges().end()));
+        CHECK_EQ(list.Weight(pKF), ref.count(pKF) ? ref[pKF] : 0);
+        if (it % 10 == 0)
+            CHECK(OrderedMatches(list, ref));
+    }
+
+    list.Clear();
+    CHECK(list.Edges().empty());
+    CHECK(list.Ordered().empty());
+    CHECK_EQ(list.Weight(FakeKeyFrame(0)), 0);
+}
+
+// Assign orders only the edges above the threshold, or the heaviest one
+static void TestAssign()
+{
+    CovisibilityList list;
+    std::vector<CovisibilityList::Edge> vEdges;
+    vEdges.push_back(CovisibilityList::Edge(FakeKeyFrame(1), 20));
+    vEdges.push_back(CovisibilityList::Edge(FakeKeyFrame(2), 5));
+    vEdges.push_back(CovisibilityList::Edge(FakeKeyFrame(3), 15));
+    vEdges.push_back(CovisibilityList::Edge(FakeKeyFrame(4), 15));
+    list.Assign(vEdges, 15);
+
+    CHECK_EQ(list.Edges().size(), 4u);
+    CHECK_EQ(list.Weight(FakeKeyFrame(2)), 5);
+    const std::vector<KeyFrame*>& vpOrdered = list.Ordered();
+    CHECK_EQ(vpOrdered.size(), 3u);
+    CHECK(vpOrdered[0] == FakeKeyFrame(1));
+    CHECK(vpOrdered[1] == FakeKeyFrame(4) && vpOrdered[2] == FakeKeyFrame(3));
+
+    // nothing reaches the threshold: only the heaviest
+    std::vector<CovisibilityList::Edge> vWeak;
+    vWeak.push_back(CovisibilityList::Edge(FakeKeyFrame(5), 3));
+    vWeak.push_back(CovisibilityList::Edge(FakeKeyFrame(6), 9));
+    list.Assign(vWeak, 15);
+    CHECK_EQ(list.Ordered().size(), 1u);
+    CHECK(list.Ordered()[0] == FakeKeyFrame(6));
+    CHECK_EQ(list.OrderedWeights()[0], 9);
+
+    // a later Set orders every edge again
+    list.Set(FakeKeyFrame(7), 1);
+    CHECK_EQ(list.Ordered().size(), 3u);
+    CHECK(list.Ordered()[2] == FakeKeyFrame(7));
+}
+
+int main()
+{
+    TestSetErase();
+    TestAssign();
+    return test::TestResult();
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#include "DescriptorMedoid.h"
+#include "HammingMatcher.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace ORB_SLAM2;
+
+typedef std::vector<uint8_t> Descriptor;
+
+static KeyFrame* FakeKeyFrame(size_t i)
+{
+    // only compared, never dereferenced
+    return reinterpret_cast<KeyFrame*>(0x1000 + 64 * i);
+}
+
+// The distance sums and the medoid match a brute force computation over the sample
+static bool Consistent(const DescriptorMedoid& medoid)
+{
+    int nBestSum = -1;
+    for (size_t i = 0; i < medoid.Size(); i++) {
+        int nSum = 0;
+        for (size_t j = 0; j < medoid.Size(); j++)
+            if (j != i)
+                nSum += HammingMatcher::Distance(medoid.GetDescriptor(i), medoid.GetDescriptor(j));
+        if (nSum != medoid.GetDistanceSum(i))
+            return false;
+        if (nBestSum < 0 || nSum < nBestSum)
+            nBestSum = nSum;
+    }
+
+    const int best = medoid.Best();
+    if (medoid.Size() == 0)
+        return best == -1;
+    return best >= 0 && medoid.GetDistanceSum(best) == nBestSum;
+}
+
+// Random offers and erases, as AddObservation/EraseObservation do
+static void TestIncrementalSums()
+{
+    std::mt19937 rng(7);
+    const size_t nObs = 400;
+    std::vector<Descriptor> vDesc(nObs, Descriptor(DescriptorMedoid::DESC_BYTES));
+    for (size_t i = 0; i < nObs; i++)
+        for (int b = 0; b < DescriptorMedoid::DESC_BYTES; b++)
+            vDesc[i][b] = rng() & 0xFF;
+
+    DescriptorMedoid medoid;
+    CHECK(Consistent(medoid));
+
+    std::vector<size_t> vLive;
+    std::vector<bool> vbLive(nObs, false);
+    for (int it = 0; it < 3000; it++) {
+        if (vLive.empty() || rng() % 3 != 0) {
+            const size_t k = rng() % nObs;
+            if (vbLive[k])
+                continue;
+            vbLive[k] = true;
+            vLive.push_back(k);
+            medoid.Offer(FakeKeyFrame(k), k, &vDesc[k][0]);
+        } else {
+            const size_t p = rng() % vLive.size();
+            const size_t k = vLive[p];
+            vLive.erase(vLive.begin() + p);
+            vbLive[k] = false;
+            medoid.Erase(FakeKeyFrame(k), k);
+        }
+
+        CHECK(medoid.Size() <= DescriptorMedoid::MAX_SAMPLES);
+        CHECK(medoid.Size() <= vLive.size());
+        CHECK(Consistent(medoid));
+        for (size_t i = 0; i < medoid.Size(); i++)
+            CHECK(vbLive[medoid.GetIndex(i)]);
+    }
+
+    medoid.Clear();
+    CHECK_EQ(medoid.Size(), 0u);
+    CHECK_EQ(medoid.Best(), -1);
+}
+
+// The medoid of a cluster around one descriptor is the descriptor itself
+static void TestMedoid()
+{
+    Descriptor center(DescriptorMedoid::DESC_BYTES, 0);
+    DescriptorMedoid medoid;
+    for (int i = 0; i < 16; i++) {
+        Descriptor d = center;
+        if (i > 0)
+            d[i] ^= 0x0F;  // 4 bits away from the center
+        medoid.Offer(FakeKeyFrame(i), i, &d[0]);
+    }
+    CHECK(Consistent(medoid));
+    CHECK_EQ(medoid.GetIndex(medoid.Best()), 0u);
+}
+
+// After the sample is full, later observations still get in (reservoir sampling)
+static void TestReservoir()
+{
+    const size_t nObs = 1000;
+    Descriptor d(DescriptorMedoid::DESC_BYTES, 0);
+    DescriptorMedoid medoid;
+    for (size_t i = 0; i < nObs; i++) {
+        d[i % DescriptorMedoid::DESC_BYTES] ^= 1 << (i % 8);
+        medoid.Offer(FakeKeyFrame(i), i, &d[0]);
+    }
+
+    CHECK_EQ(medoid.Size(), DescriptorMedoid::MAX_SAMPLES);
+    CHECK(Consistent(medoid));
+
+    size_t nLate = 0;
+    for (size_t i = 0; i < medoid.Size(); i++)
+        if (medoid.GetIndex(i) >= nObs / 2)
+            nLate++;
+    // about half of a uniform sample, not none as with first-come sampling
+    CHECK(nLate >= 6 && nLate <= 26);
+
+    // same observation order, same sample
+    DescriptorMedoid medoid2;
+    Descriptor d2(DescriptorMedoid::DESC_BYTES, 0);
+    for (size_t i = 0; i < nObs; i++) {
+        d2[i % DescriptorMedoid::DESC_BYTES] ^= 1 << (i % 8);
+        medoid2.Offer(FakeKeyFrame(i), i, &d2[0]);
+    }
+    for (size_t i = 0; i < medoid.Size(); i++)
+        CHECK_EQ(medoid.GetIndex(i), medoid2.GetIndex(i));
+}
+
+int main()
+{
+    TestIncrementalSums();
+    TestMedoid();
+    TestReservoir();
+    return test::TestResult();
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#include "ObjectPool.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+using namespace ORB_SLAM2;
+
+struct Pooled {
+    POOL_ALLOCATED_OBJECT(Pooled)
+
+    explicit Pooled(int v) : value(v), handle(ObjectPool<Pooled>::HandleOf(this)) {}
+
+    int value;
+    size_t handle;
+    double padding[3];
+};
+
+// Handles are dense slot numbers, below Capacity() and unique among live objects
+static void TestDenseHandles()
+{
+    const size_t n = 2500;  // more than two slabs
+    std::vector<Pooled*> vp;
+    std::set<size_t> sHandles;
+    for (size_t i = 0; i < n; i++) {
+        vp.push_back(new Pooled(i));
+        sHandles.insert(vp.back()->handle);
+    }
+
+    CHECK_EQ(sHandles.size(), n);
+    CHECK(*sHandles.rbegin() < ObjectPool<Pooled>::Instance().Capacity());
+    CHECK_EQ(ObjectPool<Pooled>::Instance().Capacity() % 1024, 0u);
+
+    for (size_t i = 0; i < n; i++) {
+        CHECK_EQ(vp[i]->value, (int)i);
+        CHECK_EQ(ObjectPool<Pooled>::HandleOf(vp[i]), vp[i]->handle);
+        delete vp[i];
+    }
+}
+
+// Released slots are reused with their handle, the pool does not grow
+static void TestReuse()
+{
+    const size_t nCapacity = ObjectPool<Pooled>::Instance().Capacity();
+
+    Pooled* pA = new Pooled(1);
+    const size_t hA = pA->handle;
+    delete pA;
+    Pooled* pB = new Pooled(2);
+    CHECK_EQ(pB->handle, hA);
+    CHECK_EQ(pB->value, 2);
+    delete pB;
+
+    std::vector<Pooled*> vp;
+    for (size_t i = 0; i < nCapacity; i++)
+        vp.push_back(new Pooled(i));
+    CHECK_EQ(ObjectPool<Pooled>::Instance().Capacity(), nCapacity);
+    for (size_t i = 0; i < vp.size(); i++)
+        delete vp[i];
+
+    delete static_cast<Pooled*>(NULL);
+}
+
+int main()
+{
+    TestDenseHandles();
+    TestReuse();
+    return test::TestResult();
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#include "SeqLock.h"
+#include "TestCheck.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace ORB_SLAM2;
+
+// A read that overlaps a write fails, one that does not succeeds
+static void TestSequence()
+{
+    SeqLock seq;
+    const unsigned int s0 = seq.BeginRead();
+    CHECK(seq.EndRead(s0));
+
+    const unsigned int s1 = seq.BeginRead();
+    seq.BeginWrite();
+    seq.EndWrite();
+    CHECK(!seq.EndRead(s1));
+
+    const unsigned int s2 = seq.BeginRead();
+    CHECK_EQ(s2 % 2, 0u);
+    CHECK(s2 != s1);
+    CHECK(seq.EndRead(s2));
+
+    std::atomic<int> a[3];
+    const int v[3] = {1, 2, 3};
+    int w[3] = {0, 0, 0};
+    seq.BeginWrite();
+    SeqLock::Store(a, v, 3);
+    seq.EndWrite();
+    SeqLock::Load(a, w, 3);
+    CHECK(w[0] == 1 && w[1] == 2 && w[2] == 3);
+}
+
+// Readers never see a half written record while one writer keeps updating it
+static void TestConcurrentReaders()
+{
+    const int N = 4;
+    const int nWrites = 200000;
+    SeqLock seq;
+    std::atomic<long> record[N];
+    for (int k = 0; k < N; k++)
+        record[k] = 0;
+    std::atomic<bool> bDone(false);
+    std::atomic<int> nTorn(0);
+
+    std::vector<std::thread> vReaders;
+    for (int r = 0; r < 3; r++) {
+        vReaders.push_back(std::thread([&]() {
+            long last = 0;
+            while (!bDone.load()) {
+                long v[N];
+                unsigned int s;
+                do {
+                    s = seq.BeginRead();
+                    SeqLock::Load(record, v, N);
+                } while (!seq.EndRead(s));
+
+                for (int k = 1; k < N; k++)
+                    if (v[k] != v[0] * (k + 1))
+                        nTorn++;
+                if (v[0] < last)
+                    nTorn++;
+                last = v[0];
+            }
+        }));
+    }
+
+    for (long i = 1; i <= nWrites; i++) {
+        long v[N];
+        for (int k = 0; k < N; k++)
+            v[k] = i * (k + 1);
+        seq.BeginWrite();
+        SeqLock::Store(record, v, N);
+        seq.EndWrite();
+    }
+    bDone = true;
+    for (size_t r = 0; r < vReaders.size(); r++)
+        vReaders[r].join();
+
+    CHECK_EQ(nTorn.load(), 0);
+    CHECK_EQ(record[0].load(), (long)nWrites);
+}
+
+int main()
+{
+    TestSequence();
+    TestConcurrentReaders();
+    return test::TestResult();
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#include "SmallVector.h"
+#include "TestCheck.h"
+
+#include <utility>
+#include <vector>
+
+using namespace ORB_SLAM2;
+
+typedef SmallVector<int, 4> Vector4;
+
+static bool Equal(const Vector4& v, const std::vector<int>& ref)
+{
+    if (v.size() != ref.size())
+        return false;
+    for (size_t i = 0; i < ref.size(); i++)
+        if (v[i] != ref[i])
+            return false;
+    return true;
+}
+
+// Growing past the inline capacity keeps the elements and their order
+static void TestPushBack()
+{
+    Vector4 v;
+    std::vector<int> ref;
+    CHECK(v.empty());
+    for (int i = 0; i < 20; i++) {
+        v.push_back(i * i);
+        ref.push_back(i * i);
+        CHECK(Equal(v, ref));
+    }
+
+    // the pushed element lives in the buffer that is being reallocated
+    Vector4 w;
+    for (int i = 0; i < 4; i++)
+        w.push_back(i + 10);
+    w.push_back(w[0]);
+    CHECK_EQ(w.size(), 5u);
+    CHECK_EQ(w[4], 10);
+}
+
+// Erase keeps the order of the remaining elements, clear empties
+static void TestEraseClear()
+{
+    Vector4 v;
+    std::vector<int> ref;
+    for (int i = 0; i < 9; i++) {
+        v.push_back(i);
+        ref.push_back(i);
+    }
+
+    Vector4::iterator it = v.erase(v.begin() + 3);
+    ref.erase(ref.begin() + 3);
+    CHECK_EQ(*it, 4);
+    CHECK(Equal(v, ref));
+
+    v.erase(v.end() - 1);
+    ref.pop_back();
+    v.erase(v.begin());
+    ref.erase(ref.begin());
+    CHECK(Equal(v, ref));
+
+    v.clear();
+    CHECK(v.empty());
+    CHECK(v.begin() == v.end());
+    v.push_back(7);
+    CHECK_EQ(v.size(), 1u);
+    CHECK_EQ(v[0], 7);
+}
+
+// Copies are deep, inline and on the heap, and survive the source
+static void TestCopy()
+{
+    for (int n = 0; n < 10; n++) {
+        Vector4* pSrc = new Vector4();
+        std::vector<int> ref;
+        for (int i = 0; i < n; i++) {
+            pSrc->push_back(i + 100);
+            ref.push_back(i + 100);
+        }
+
+        Vector4 copy(*pSrc);
+        Vector4 assigned;
+        assigned.push_back(-1);
+        assigned = *pSrc;
+        assigned = assigned;
+        delete pSrc;
+
+        CHECK(Equal(copy, ref));
+        CHECK(Equal(assigned, ref));
+        if (n > 0) {
+            copy[0] = -5;
+            CHECK_EQ(assigned[0], 100);
+        }
+    }
+
+    SmallVector<std::pair<int, size_t>, 2> obs;
+    obs.push_back(std::make_pair(1, 10));
+    obs.push_back(std::make_pair(2, 20));
+    obs.push_back(std::make_pair(3, 30));
+    SmallVector<std::pair<int, size_t>, 2> obsCopy = obs;
+    CHECK_EQ(obsCopy.size(), 3u);
+    CHECK(obsCopy[2].first == 3 && obsCopy[2].second == 30);
+}
+
+int main()
+{
+    TestPushBack();
+    TestEraseClear();
+    TestCopy();
+    return test::TestResult();
+}
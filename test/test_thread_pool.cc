@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#include "ThreadPool.h"
+#include "TestCheck.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace ORB_SLAM2;
+
+// Every index runs exactly once, whatever the number of threads asked for
+static void TestCoverage()
+{
+    const int vn[] = {0, 1, 2, 7, 100, 1000};
+    const int vThreads[] = {0, 1, 2, 3, 8, 64};
+    for (size_t a = 0; a < sizeof(vn) / sizeof(vn[0]); a++) {
+        for (size_t b = 0; b < sizeof(vThreads) / sizeof(vThreads[0]); b++) {
+            const int n = vn[a];
+            std::vector<std::atomic<int> > vCount(n);
+            for (int i = 0; i < n; i++)
+                vCount[i] = 0;
+            ThreadPool::ParallelFor(n, vThreads[b], [&](int i) { vCount[i]++; });
+            for (int i = 0; i < n; i++)
+                CHECK_EQ(vCount[i].load(), 1);
+        }
+    }
+}
+
+// One thread runs serially, in index order, on the calling thread
+static void TestSerial()
+{
+    std::vector<int> vOrder;
+    const std::thread::id caller = std::this_thread::get_id();
+    bool bSameThread = true;
+    ThreadPool::ParallelFor(10, 1, [&](int i) {
+        vOrder.push_back(i);
+        bSameThread = bSameThread && std::this_thread::get_id() == caller;
+    });
+    CHECK_EQ(vOrder.size(), 10u);
+    for (size_t i = 0; i < vOrder.size(); i++)
+        CHECK_EQ(vOrder[i], (int)i);
+    CHECK(bSameThread);
+}
+
+// ParallelFor inside a task and from several threads at once must not deadlock
+static void TestNestedAndConcurrent()
+{
+    const int nOuter = 16, nInner = 64;
+    std::atomic<int> nSum(0);
+    ThreadPool::ParallelFor(nOuter, ThreadPool::NumThreads(), [&](int) {
+        ThreadPool::ParallelFor(nInner, ThreadPool::NumThreads(), [&](int j) { nSum += j; });
+    });
+    CHECK_EQ(nSum.load(), nOuter * nInner * (nInner - 1) / 2);
+
+    const int nCallers = 4, n = 500;
+    std::vector<long> vSums(nCallers, 0);
+    std::vector<std::thread> vCallers;
+    for (int c = 0; c < nCallers; c++) {
+        vCallers.push_back(std::thread([&, c]() {
+            std::vector<int> vResult(n, 0);
+            ThreadPool::ParallelFor(n, 8, [&](int i) { vResult[i] = i * (c + 1); });
+            for (int i = 0; i < n; i++)
+                vSums[c] += vResult[i];
+        }));
+    }
+    for (size_t c = 0; c < vCallers.size(); c++)
+        vCallers[c].join();
+    for (int c = 0; c < nCallers; c++)
+        CHECK_EQ(vSums[c], (long)(c + 1) * n * (n - 1) / 2);
+}
+
+int main()
+{
+    CHECK(ThreadPool::NumThreads() >= 1);
+    TestCoverage();
+    TestSerial();
+    TestNestedAndConcurrent();
+    return test::TestResult();
+}
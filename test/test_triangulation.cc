@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+#include "Triangulation.h"
+#include "TestCheck.h"
+
+#include <math.h>
+
+#include <Eigen/Geometry>
+
+using namespace ORB_SLAM2;
+
+static const float fx = 520.9f, fy = 521.0f, cx = 325.1f, cy = 249.7f;
+
+static Triangulation::Matrix34f Projection(const Eigen::Matrix3f& K, const Eigen::Matrix3f& R, const Eigen::Vector3f& t)
+{
+    Triangulation::Matrix34f P;
+    P.leftCols<3>() = R;
+    P.col(3) = t;
+    return K * P;
+}
+
+static void Project(const Triangulation::Matrix34f& P, const Eigen::Vector3f& x3D, float& u, float& v)
+{
+    const Eigen::Vector3f p = P * x3D.homogeneous();
+    u = p(0) / p(2);
+    v = p(1) / p(2);
+}
+
+// DLT recovers points seen by two cameras, in pixels and in normalized coordinates
+static void TestDLT()
+{
+    Eigen::Matrix3f K;
+    K << fx, 0, cx, 0, fy, cy, 0, 0, 1;
+
+    const Eigen::Matrix3f R1 = Eigen::Matrix3f::Identity();
+    const Eigen::Vector3f t1 = Eigen::Vector3f::Zero();
+    const Eigen::Matrix3f R2 = Eigen::AngleAxisf(0.1f, Eigen::Vector3f(0.2f, 1.0f, 0.1f).normalized()).toRotationMatrix();
+    const Eigen::Vector3f t2(-0.3f, 0.05f, 0.02f);
+
+    const Triangulation::Matrix34f P1 = Projection(K, R1, t1);
+    const Triangulation::Matrix34f P2 = Projection(K, R2, t2);
+    const Triangulation::Matrix34f P1n = Projection(Eigen::Matrix3f::Identity(), R1, t1);
+    const Triangulation::Matrix34f P2n = Projection(Eigen::Matrix3f::Identity(), R2, t2);
+
+    const Eigen::Vector3f vPoints[] = {Eigen::Vector3f(0.0f, 0.0f, 2.0f), Eigen::Vector3f(0.5f, -0.3f, 3.0f),
+                                       Eigen::Vector3f(-1.0f, 0.4f, 5.0f), Eigen::Vector3f(0.2f, 0.8f, 1.5f)};
+    for (size_t i = 0; i < sizeof(vPoints) / sizeof(vPoints[0]); i++) {
+        const Eigen::Vector3f& X = vPoints[i];
+        float u1, v1, u2, v2;
+        Project(P1, X, u1, v1);
+        Project(P2, X, u2, v2);
+
+        Eigen::Vector3f x3D;
+        CHECK(Triangulation::DLT(P1, u1, v1, P2, u2, v2, x3D));
+        CHECK((x3D - X).norm() < 1e-3f * X.norm());
+
+        // reprojection error in both views is ~0 at the recovered point
+        CHECK(Triangulation::ReprojectionError2(R1 * x3D + t1, fx, fy, cx, cy, u1, v1) < 1e-2f);
+        CHECK(Triangulation::ReprojectionError2(R2 * x3D + t2, fx, fy, cx, cy, u2, v2) < 1e-2f);
+
+        const float xn1 = (u1 - cx) / fx, yn1 = (v1 - cy) / fy;
+        const float xn2 = (u2 - cx) / fx, yn2 = (v2 - cy) / fy;
+        Eigen::Vector3f x3Dn;
+        CHECK(Triangulation::DLT(P1n, xn1, yn1, P2n, xn2, yn2, x3Dn));
+        CHECK((x3Dn - X).norm() < 1e-3f * X.norm());
+    }
+}
+
+// A pixel offset of d gives ReprojectionError2 == d^2
+static void TestReprojectionError()
+{
+    const Eigen::Vector3f x3Dc(0.4f, -0.2f, 2.5f);
+    const float u = fx * x3Dc(0) / x3Dc(2) + cx;
+    const float v = fy * x3Dc(1) / x3Dc(2) + cy;
+    CHECK(Triangulation::ReprojectionError2(x3Dc, fx, fy, cx, cy, u, v) < 1e-6f);
+    CHECK(fabsf(Triangulation::ReprojectionError2(x3Dc, fx, fy, cx, cy, u + 3.0f, v - 4.0f) - 25.0f) < 1e-3f);
+}
+
+int main()
+{
+    TestDLT();
+    TestReprojectionError();
+    return test::TestResult();
+}
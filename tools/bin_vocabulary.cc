@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2021, Yubao Liu, AISL, TOYOHASHI UNIVERSITY of TECHNOLOGY
+ * Email: yubao.liu.ra@tut.jp
+ */
+
+// Converts the text vocabulary into the binary format read by
+// ORBVocabulary::loadFromBinaryFile:
+//   ./tools/bin_vocabulary Vocabulary/ORBvoc.txt Vocabulary/ORBvoc.bin
+
+#include <chrono>
+#include <iostream>
+
+#include "ORBVocabulary.h"
+
+using namespace std;
+
+int main(int argc, char** argv)
+{
+    if (argc != 3) {
+        cerr << endl << "Usage: ./bin_vocabulary path_to_ORBvoc.txt path_to_ORBvoc.bin" << endl;
+        return 1;
+    }
+
+    ORB_SLAM2::ORBVocabulary voc;
+
+    cout << "Loading text vocabulary " << argv[1] << " ..." << endl;
+    if (!voc.loadFromTextFile(argv[1])) {
+        cerr << "Failed to open " << argv[1] << endl;
+        return 1;
+    }
+
+    if (!voc.saveToBinaryFile(argv[2])) {
+        cerr << "Failed to write " << argv[2] << endl;
+        return 1;
+    }
+
+    // check the result can be read back
+    ORB_SLAM2::ORBVocabulary vocBin;
+    chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+    if (!vocBin.loadFromBinaryFile(argv[2]) || vocBin.size() != voc.size()) {
+        cerr << "Verification of " << argv[2] << " failed" << endl;
+        return 1;
+    }
+    chrono::steady_clock::time_point t2 = chrono::steady_clock::now();
+
+    cout << "Saved " << voc.size() << " words to " << argv[2] << ", loading it takes "
+         << chrono::duration_cast<chrono::duration<double, milli> >(t2 - t1).count() << " ms" << endl;
+    return 0;
+}